@@ -0,0 +1,403 @@
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "BinauralConvolver.h"
+#include "DecodeChain.h"
+#include "FormatDefaults.h"
+#include "RealtimeWorkerPool.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+ #include <intrin.h>
+ #define M1_BENCHMARK_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+ #include <x86intrin.h>
+ #define M1_BENCHMARK_TSC 1
+#else
+ #define M1_BENCHMARK_TSC 0
+#endif
+
+// Measures the per-block work of MainComponent's audio strategies on synthetic input, without
+// an audio device, media or OpenGL. Every strategy runs the player's own DecodeChain bodies for
+// one listener, so the numbers include the settled-coeffs skip and the parallel mix. Results are
+// written as JSON for comparing builds.
+//
+// Usage: M1-Player-DecodeBenchmark [--output=results.json] [--channels=1-64] [--blocks=16-4096]
+//                                  [--seconds=1] [--sample-rate=48000] [--generic-mix] [--decode-table]
+//                                  [--parallel]
+//
+// --generic-mix runs every stereo mix through DecodeKernels::mixToStereo instead of the kernel
+// the player picks for the channel count, to compare against the unrolled ones.
+// --decode-table interpolates the decode coeffs from a DecodeCoeffTable instead of calling
+// Mach1Decode, like the player's "Interpolated Decode Coefficients" option.
+// --parallel shares the transcode and mix of 16 or more channels out to worker threads, like the
+// player's "Parallel Transcode" option.
+
+namespace
+{
+    constexpr int MAX_DECODE_CHANNELS = DecodeChain::MAX_DECODE_CHANNELS;
+    constexpr int MAX_TRANSCODE_WORKERS = 3;     // MainComponent::MAX_TRANSCODE_WORKERS
+    constexpr int HRTF_FILTER_SAMPLES = 512; // typical HRIR length for the convolution strategy
+    constexpr double DECODE_RAMP_SECONDS = 0.01; // MIN_DECODE_RAMP_SECONDS, a fast tracker
+    constexpr float YAW_STEP_DEGREES = 0.5f;     // head movement per block, keeps the ramps busy
+    constexpr float MASTER_GAIN = 0.8f;          // media volume below unity
+
+    bool useGenericMix = false; // --generic-mix
+    bool useDecodeCoeffTable = false; // --decode-table
+    RealtimeWorkerPool transcodeWorkers; // running with --parallel
+
+    inline juce::uint64 readCycleCounter() noexcept
+    {
+       #if M1_BENCHMARK_TSC
+        return (juce::uint64) __rdtsc();
+       #else
+        return 0;
+       #endif
+    }
+
+    // Cached like MainComponent::getDecodeCoeffTable, so only the first case of a mode builds it
+    std::shared_ptr<const DecodeCoeffTable> getDecodeCoeffTable(int formatChannelCount)
+    {
+        static std::map<int, std::shared_ptr<const DecodeCoeffTable>> tables;
+        auto& table = tables[formatChannelCount];
+        if (table == nullptr)
+            table = DecodeChain::createDecodeCoeffTable(formatChannelCount);
+        return table;
+    }
+
+    //==============================================================================
+    // One AudioDecodeConfig with a single listener, plus the callback's buffers
+    struct StrategyState
+    {
+        StrategyState(int numInputChannels, int blockSize, double sampleRate)
+            : readBuffer(numInputChannels, blockSize),
+              intermediaryBuffer(MAX_DECODE_CHANNELS, blockSize),
+              outputBuffer(2, blockSize),
+              partialSums((MAX_TRANSCODE_WORKERS + 1) * 2, blockSize)
+        {
+            juce::Random random(1234);
+            for (int channel = 0; channel < numInputChannels; ++channel)
+                for (int i = 0; i < blockSize; ++i)
+                    readBuffer.setSample(channel, i, random.nextFloat() * 2.0f - 1.0f);
+            intermediaryBuffer.clear();
+
+            chain.numInputChannels = numInputChannels;
+            chain.sampleRate = sampleRate;
+            DecodeChain::initialiseDecode(chain.decode);
+            if (transcodeWorkers.getNumWorkers() > 0 && numInputChannels >= DecodeChain::PARALLEL_MIN_CHANNELS)
+                chain.parallelTasks = transcodeWorkers.getNumWorkers() + 1;
+        }
+
+        // The end of MainComponent::buildAudioConfig, once the decode mode and transcode are set
+        void prepareListener(bool decodes, int mixChannelCount)
+        {
+            chain.setMixChannelCount(mixChannelCount);
+            if (useGenericMix)
+                chain.mixToStereo = &DecodeKernels::mixToStereo;
+            if (useDecodeCoeffTable && decodes)
+                chain.decodeCoeffTable = getDecodeCoeffTable(chain.decode.getFormatChannelCount());
+
+            chain.prepareListener(listener, 0, decodes);
+            listener.decodeCoeffRamp.setRampLengthSeconds(DECODE_RAMP_SECONDS);
+        }
+
+        DecodeChain::Orientation nextOrientation()
+        {
+            yaw = std::fmod(yaw + YAW_STEP_DEGREES, 360.0f);
+            return { yaw, 0.0f, 0.0f };
+        }
+
+        // MainComponent::getDecodeOutput, with the output cleared the way the callback does
+        DecodeChain::Output getOutput(int numSamples)
+        {
+            outputBuffer.clear(0, numSamples);
+            DecodeChain::Output output;
+            output.left = outputBuffer.getWritePointer(0);
+            output.right = outputBuffer.getWritePointer(1);
+            output.numSamples = numSamples;
+            output.gain = MASTER_GAIN;
+            output.workers = &transcodeWorkers;
+            output.partialSums = &partialSums;
+            return output;
+        }
+
+        juce::AudioBuffer<float> readBuffer, intermediaryBuffer, outputBuffer, partialSums;
+        DecodeChain chain;
+        DecodeChain::Listener listener;
+        float yaw = 0.0f;
+    };
+
+    //==============================================================================
+    struct Measurement
+    {
+        std::string strategy, format;
+        int channels = 0, blockSize = 0;
+        double nsPerSample = 0.0, cyclesPerSample = 0.0;
+    };
+
+    struct Options
+    {
+        juce::Range<int> channels { 1, 64 };
+        juce::Range<int> blocks { 16, 4096 };
+        double seconds = 1.0;
+        double sampleRate = 48000.0;
+        double cpuMHz = 0.0; // converts ns to cycles when there is no cycle counter
+    };
+
+    Measurement measure(const Options& options, const std::string& strategy, const std::string& format,
+                   int channels, int blockSize, std::function<void(int)> processBlock)
+    {
+        const int numBlocks = juce::jmax(16, (int) (options.seconds * options.sampleRate / blockSize));
+
+        // warm up caches, branch predictors and the decode filter
+        for (int block = 0; block < 16; ++block)
+            processBlock(blockSize);
+
+        const auto startCycles = readCycleCounter();
+        const auto startTicks = juce::Time::getHighResolutionTicks();
+        for (int block = 0; block < numBlocks; ++block)
+            processBlock(blockSize);
+        const auto elapsedTicks = juce::Time::getHighResolutionTicks() - startTicks;
+        const auto elapsedCycles = readCycleCounter() - startCycles;
+
+        const double samples = (double) numBlocks * blockSize;
+        Measurement result { strategy, format, channels, blockSize };
+        result.nsPerSample = juce::Time::highResolutionTicksToSeconds(elapsedTicks) * 1.0e9 / samples;
+        result.cyclesPerSample = M1_BENCHMARK_TSC ? (double) elapsedCycles / samples
+                                                  : result.nsPerSample * options.cpuMHz / 1000.0;
+        return result;
+    }
+
+    //==============================================================================
+    void benchmarkChannelCount(const Options& options, int channels, int blockSize, std::vector<Measurement>& results)
+    {
+        const double sampleRate = options.sampleRate;
+
+        if (channels == 1)
+        {
+            StrategyState state(channels, blockSize, sampleRate);
+            state.prepareListener(false, 1);
+            results.push_back(measure(options, "monoDecodeStrategy", "", channels, blockSize, [&](int n) {
+                state.chain.mixWithSmoothedCoeffs(state.listener, state.readBuffer.getArrayOfReadPointers(), 1,
+                                                  DecodeChain::MONO_COEFFS, state.getOutput(n));
+            }));
+            return;
+        }
+
+        if (channels == 2)
+        {
+            StrategyState state(channels, blockSize, sampleRate);
+            state.prepareListener(false, 2);
+            results.push_back(measure(options, "stereoDecodeStrategy", "", channels, blockSize, [&](int n) {
+                state.chain.mixWithSmoothedCoeffs(state.listener, state.readBuffer.getArrayOfReadPointers(), 2,
+                                                  DecodeChain::STEREO_COEFFS, state.getOutput(n));
+            }));
+            return;
+        }
+
+        for (const auto& format : FormatDefaults::getMatchingFormatNames(channels))
+        {
+            // Mach1Spatial input: decoded straight from the read buffer
+            {
+                StrategyState state(channels, blockSize, sampleRate);
+                Mach1DecodeMode mode = M1DecodeSpatial_14;
+                if (DecodeChain::getDecodeMode(format, mode))
+                {
+                    state.chain.decode.setDecodeMode(mode);
+
+                    // decaying noise as the filter set of the convolution strategy
+                    juce::AudioBuffer<float> impulses(channels * 2, HRTF_FILTER_SAMPLES);
+                    juce::Random random(5678);
+                    for (int lane = 0; lane < impulses.getNumChannels(); ++lane)
+                        for (int i = 0; i < HRTF_FILTER_SAMPLES; ++i)
+                            impulses.setSample(lane, i, (random.nextFloat() * 2.0f - 1.0f) * std::exp(-8.0f * (float) i / HRTF_FILTER_SAMPLES));
+                    state.chain.hrtfFilters = BinauralConvolver::createFilters(impulses, sampleRate, "noise");
+                    state.prepareListener(true, channels);
+
+                    const float* const* input = state.readBuffer.getArrayOfReadPointers();
+                    results.push_back(measure(options, "readBufferDecodeStrategy", format, channels, blockSize, [&](int n) {
+                        state.chain.decodeToStereo(state.listener, input, channels, state.nextOrientation(), state.getOutput(n));
+                    }));
+                    results.push_back(measure(options, "readBufferConvolutionStrategy", format, channels, blockSize, [&](int n) {
+                        state.chain.convolveToStereo(state.listener, input, channels, state.nextOrientation(), state.getOutput(n));
+                    }));
+                    continue;
+                }
+            }
+
+            const std::string outputFormat = FormatDefaults::getPreferredOutputFormat(format);
+
+            // transcode to the preferred Mach1Spatial format, then decode that
+            {
+                StrategyState state(channels, blockSize, sampleRate);
+                auto& chain = state.chain;
+                Mach1DecodeMode mode = M1DecodeSpatial_14;
+                DecodeChain::getDecodeMode(outputFormat, mode);
+                chain.decode.setDecodeMode(mode);
+                if (!chain.setTranscodeFormats(format, outputFormat))
+                    continue;
+
+                // the player keeps the matrix for the fused decode and the parallel transcode
+                const bool singleMatrix = chain.storeConversionMatrix(MAX_DECODE_CHANNELS);
+                const int out = chain.transcode.getOutputNumChannels();
+                state.intermediaryBuffer.setSize(out, blockSize, false, false, true);
+                const int decodeChannels = juce::jmin(chain.decode.getFormatChannelCount(), out);
+                state.prepareListener(true, decodeChannels);
+
+                const float* const* input = state.readBuffer.getArrayOfReadPointers();
+                results.push_back(measure(options, "intermediaryBufferTranscodeStrategy", format, channels, blockSize, [&](int n) {
+                    if (!chain.transcodeBlock(input, state.intermediaryBuffer.getArrayOfWritePointers(), out, n, &transcodeWorkers))
+                        state.intermediaryBuffer.clear();
+                }));
+
+                results.push_back(measure(options, "intermediaryBufferDecodeStrategy", format, channels, blockSize, [&](int n) {
+                    chain.decodeToStereo(state.listener, state.intermediaryBuffer.getArrayOfReadPointers(), decodeChannels,
+                                         state.nextOrientation(), state.getOutput(n));
+                }));
+
+                // single matrix conversions are folded into the decode by the player instead
+                if (singleMatrix && chain.conversionOutputChannels == chain.decode.getFormatChannelCount())
+                {
+                    state.prepareListener(true, channels);
+                    results.push_back(measure(options, "fusedTranscodeDecodeStrategy", format, channels, blockSize, [&](int n) {
+                        chain.fusedTranscodeDecode(state.listener, input, state.nextOrientation(), state.getOutput(n));
+                    }));
+
+                    // full-order ambisonics rotated in the SH domain ahead of the same fold taken
+                    // facing front; compare with fusedTranscodeDecodeStrategy for each order
+                    const int order = AmbisonicRotation::getOrderForFormat(format, channels);
+                    if (order > 0)
+                    {
+                        chain.prepareAmbisonicDecode(order);
+                        chain.decodeCoeffTable = nullptr; // the player never interpolates for this one
+                        state.prepareListener(true, channels);
+                        results.push_back(measure(options, "ambisonicRotationDecodeStrategy", format, channels, blockSize, [&](int n) {
+                            chain.ambisonicRotationDecode(state.listener, input, state.nextOrientation(), state.getOutput(n));
+                        }));
+                    }
+                }
+            }
+        }
+    }
+
+    juce::Range<int> parseRange(const juce::String& text, juce::Range<int> fallback)
+    {
+        if (text.isEmpty())
+            return fallback;
+        if (!text.containsChar('-'))
+            return { text.getIntValue(), text.getIntValue() };
+        return { text.upToFirstOccurrenceOf("-", false, false).getIntValue(),
+                 text.fromFirstOccurrenceOf("-", false, false).getIntValue() };
+    }
+
+    const char* getKernelName()
+    {
+       #if M1_DECODE_KERNEL_X86 && defined(__AVX__)
+        return "avx";
+       #elif M1_DECODE_KERNEL_X86
+        return "sse";
+       #elif M1_DECODE_KERNEL_NEON
+        return "neon";
+       #else
+        return "scalar";
+       #endif
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ArgumentList args(argc, argv);
+
+    Options options;
+    options.channels = parseRange(args.getValueForOption("--channels"), options.channels);
+    options.blocks = parseRange(args.getValueForOption("--blocks"), options.blocks);
+    if (args.containsOption("--seconds"))
+        options.seconds = juce::jmax(0.01, args.getValueForOption("--seconds").getDoubleValue());
+    if (args.containsOption("--sample-rate"))
+        options.sampleRate = juce::jmax(8000.0, args.getValueForOption("--sample-rate").getDoubleValue());
+    options.cpuMHz = juce::SystemStats::getCpuSpeedInMegahertz();
+    useGenericMix = args.containsOption("--generic-mix");
+    useDecodeCoeffTable = args.containsOption("--decode-table");
+    const bool useParallel = args.containsOption("--parallel");
+
+    std::vector<Measurement> results;
+    for (int channels = juce::jmax(1, options.channels.getStart()); channels <= juce::jmin(64, options.channels.getEnd()); ++channels)
+    {
+        for (int blockSize = 16; blockSize <= 4096; blockSize *= 2)
+        {
+            if (blockSize < options.blocks.getStart() || blockSize > options.blocks.getEnd())
+                continue;
+
+            // as MainComponent::setParallelTranscode, the idle workers spin for one block period
+            if (useParallel)
+                transcodeWorkers.start(juce::jlimit(0, MAX_TRANSCODE_WORKERS, juce::SystemStats::getNumPhysicalCpus() - 1),
+                                       blockSize / options.sampleRate);
+
+            const auto first = results.size();
+            benchmarkChannelCount(options, channels, blockSize, results);
+            for (auto i = first; i < results.size(); ++i)
+                std::fprintf(stderr, "%2d ch %5d %-36s %-22s %9.2f ns/sample %9.1f cycles/sample\n",
+                             channels, blockSize, results[i].strategy.c_str(), results[i].format.c_str(),
+                             results[i].nsPerSample, results[i].cyclesPerSample);
+        }
+    }
+    const int numWorkers = transcodeWorkers.getNumWorkers();
+    transcodeWorkers.stop();
+
+    //==============================================================================
+    auto* machine = new juce::DynamicObject();
+    machine->setProperty("cpu", juce::SystemStats::getCpuModel());
+    machine->setProperty("cpuMHz", options.cpuMHz);
+    machine->setProperty("os", juce::SystemStats::getOperatingSystemName());
+    machine->setProperty("kernel", getKernelName());
+    machine->setProperty("cycleCounter", M1_BENCHMARK_TSC ? "tsc" : "estimated");
+    machine->setProperty("mixKernels", useGenericMix ? "generic" : "fixed");
+    machine->setProperty("decodeCoeffs", useDecodeCoeffTable ? "table" : "mach1decode");
+    machine->setProperty("transcodeWorkers", numWorkers);
+
+    juce::Array<juce::var> entries;
+    for (const auto& result : results)
+    {
+        auto* entry = new juce::DynamicObject();
+        entry->setProperty("strategy", juce::String(result.strategy));
+        entry->setProperty("format", juce::String(result.format));
+        entry->setProperty("channels", result.channels);
+        entry->setProperty("blockSize", result.blockSize);
+        entry->setProperty("nsPerSample", result.nsPerSample);
+        entry->setProperty("cyclesPerSample", result.cyclesPerSample);
+        entries.add(juce::var(entry));
+    }
+
+    auto* root = new juce::DynamicObject();
+    root->setProperty("benchmark", "decode-strategies");
+    root->setProperty("version", juce::String(ProjectInfo::versionString));
+    root->setProperty("timestamp", juce::Time::getCurrentTime().toISO8601(true));
+    root->setProperty("sampleRate", options.sampleRate);
+    root->setProperty("secondsPerCase", options.seconds);
+    root->setProperty("machine", juce::var(machine));
+    root->setProperty("results", entries);
+
+    const auto json = juce::JSON::toString(juce::var(root));
+    if (args.containsOption("--output"))
+    {
+        const auto file = juce::File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--output"));
+        if (!file.replaceWithText(json))
+        {
+            std::fprintf(stderr, "Cannot write %s\n", file.getFullPathName().toRawUTF8());
+            return 1;
+        }
+    }
+    else
+    {
+        std::printf("%s\n", json.toRawUTF8());
+    }
+
+    return 0;
+}
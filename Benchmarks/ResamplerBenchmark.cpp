@@ -0,0 +1,64 @@
+#include <JuceHeader.h>
+
+#include <cstdio>
+#include <vector>
+
+#include "PolyphaseResampler.h"
+
+// Measures PolyphaseResampler cost per channel for the rate pairs we see between media files
+// and audio devices. Usage: M1-Player-ResamplerBenchmark [channels] [blockSize]
+int main(int argc, char* argv[])
+{
+    const int numChannels = argc > 1 ? juce::jmax(1, std::atoi(argv[1])) : 14;
+    const int blockSize = argc > 2 ? juce::jmax(16, std::atoi(argv[2])) : 256;
+    const double secondsOfAudio = 10.0;
+
+    const double ratePairs[][2] = {
+        { 44100.0, 48000.0 }, { 48000.0, 44100.0 },
+        { 48000.0, 96000.0 }, { 96000.0, 48000.0 },
+        { 44100.0, 96000.0 }, { 96000.0, 44100.0 },
+    };
+    const char* qualityNames[] = { "draft", "standard", "high" };
+
+    std::printf("channels: %d, block: %d, %.0fs of output per run\n\n", numChannels, blockSize, secondsOfAudio);
+    std::printf("%-18s %-9s %14s %16s\n", "rates", "quality", "ns/sample/ch", "realtime factor");
+
+    for (const auto& rates : ratePairs)
+    {
+        for (int quality = PolyphaseResampler::QualityDraft; quality <= PolyphaseResampler::QualityHigh; ++quality)
+        {
+            PolyphaseResampler resampler;
+            resampler.prepare(numChannels, blockSize, rates[0], rates[1], (PolyphaseResampler::Quality) quality);
+
+            juce::AudioBuffer<float> input(numChannels, resampler.getMaxInputFrames());
+            juce::AudioBuffer<float> output(numChannels, blockSize);
+            juce::Random random(1234);
+            for (int channel = 0; channel < numChannels; ++channel)
+                for (int i = 0; i < input.getNumSamples(); ++i)
+                    input.setSample(channel, i, random.nextFloat() * 2.0f - 1.0f);
+
+            const int numBlocks = (int) (secondsOfAudio * rates[1] / blockSize);
+
+            // warm up caches and branch predictors
+            for (int block = 0; block < 64; ++block)
+                resampler.process(input.getArrayOfReadPointers(), resampler.getInputFramesNeeded(blockSize),
+                                  output.getArrayOfWritePointers(), numChannels, blockSize);
+
+            const auto start = juce::Time::getHighResolutionTicks();
+            for (int block = 0; block < numBlocks; ++block)
+                resampler.process(input.getArrayOfReadPointers(), resampler.getInputFramesNeeded(blockSize),
+                                  output.getArrayOfWritePointers(), numChannels, blockSize);
+            const double elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+
+            const double outputSamples = (double) numBlocks * blockSize;
+            const double nsPerSampleChannel = elapsed * 1.0e9 / (outputSamples * numChannels);
+            const double realtimeFactor = (outputSamples / rates[1]) / elapsed;
+
+            const juce::String ratesLabel = juce::String((int) rates[0]) + " -> " + juce::String((int) rates[1]);
+            std::printf("%-18s %-9s %14.2f %15.0fx\n", ratesLabel.toRawUTF8(), qualityNames[quality],
+                        nsPerSampleChannel, realtimeFactor);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "OfflineBounce.h"
+
+static void printUsage()
+{
+    std::cout << "Usage: M1-Player-Bounce --input=<file> --output=<file.wav> [options]\n"
+                 "\n"
+                 "  --format=<name>       Mach1Transcode input format, defaults by channel count\n"
+                 "  --keyframes=<file>    orientation keyframes, one \"time yaw pitch roll\" per line\n"
+                 "  --ypr=<y,p,r>         fixed orientation in degrees when no keyframes are given\n"
+                 "  --block=<frames>      processing block size (default 256)\n"
+                 "  --bits=<16|24|32>     output WAV bit depth (default 24)\n";
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h") || !args.containsOption("--input") || !args.containsOption("--output"))
+    {
+        printUsage();
+        return args.containsOption("--help|-h") ? 0 : 1;
+    }
+
+    // ArgumentList's file getters throw ConsoleAppFailureCode, which only ConsoleApplication
+    // catches, so paths are resolved and checked here instead
+    const auto workingDirectory = juce::File::getCurrentWorkingDirectory();
+
+    OfflineBounce::Settings settings;
+    settings.inputFile = workingDirectory.getChildFile(args.getValueForOption("--input"));
+    settings.outputFile = workingDirectory.getChildFile(args.getValueForOption("--output"));
+    if (!settings.inputFile.existsAsFile())
+    {
+        std::cerr << "Input file not found: " << settings.inputFile.getFullPathName() << std::endl;
+        return 1;
+    }
+    settings.inputFormat = args.getValueForOption("--format").toStdString();
+    if (args.containsOption("--block"))
+        settings.blockSize = args.getValueForOption("--block").getIntValue();
+    if (args.containsOption("--bits"))
+        settings.bitDepth = args.getValueForOption("--bits").getIntValue();
+
+    if (args.containsOption("--keyframes"))
+    {
+        // reports a missing file itself
+        auto result = OfflineBounce::loadKeyframes(workingDirectory.getChildFile(args.getValueForOption("--keyframes")),
+                                                   settings.keyframes);
+        if (result.failed())
+        {
+            std::cerr << result.getErrorMessage() << std::endl;
+            return 1;
+        }
+    }
+    else if (args.containsOption("--ypr"))
+    {
+        juce::StringArray ypr;
+        ypr.addTokens(args.getValueForOption("--ypr"), ",", "");
+        if (ypr.size() != 3)
+        {
+            std::cerr << "--ypr expects three comma separated values" << std::endl;
+            return 1;
+        }
+        settings.keyframes.push_back({ 0.0, ypr[0].getFloatValue(), ypr[1].getFloatValue(), ypr[2].getFloatValue() });
+    }
+
+    int lastPercent = -1;
+    const double startTime = juce::Time::getMillisecondCounterHiRes();
+
+    OfflineBounce bounce;
+    auto result = bounce.render(settings, [&lastPercent](double progress) {
+        const int percent = (int) (progress * 100.0);
+        if (percent != lastPercent)
+        {
+            lastPercent = percent;
+            std::cout << "\r" << percent << "%" << std::flush;
+        }
+    });
+    std::cout << std::endl;
+
+    if (result.failed())
+    {
+        std::cerr << result.getErrorMessage() << std::endl;
+        return 1;
+    }
+
+    const double elapsedSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+    double durationSeconds = 0.0;
+    {
+        juce::AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+        if (std::unique_ptr<juce::AudioFormatReader> reader { formatManager.createReaderFor(settings.outputFile) })
+            durationSeconds = reader->lengthInSamples / reader->sampleRate;
+    }
+
+    std::cout << "Wrote " << settings.outputFile.getFullPathName() << " in " << elapsedSeconds << " s";
+    if (elapsedSeconds > 0.0)
+        std::cout << " (" << durationSeconds / elapsedSeconds << "x realtime)";
+    std::cout << std::endl;
+    return 0;
+}
@@ -0,0 +1,214 @@
+#include "OfflineBounce.h"
+
+#include "DecodeChain.h"
+#include "FormatDefaults.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // to - from wrapped into [-180, 180), the shorter turn between two angles
+    float getShortestTurn(float from, float to)
+    {
+        const float difference = std::fmod(to - from + 180.0f, 360.0f);
+        return (difference < 0.0f ? difference + 360.0f : difference) - 180.0f;
+    }
+
+    // The MainComponent decode strategy each kind of input ends up with
+    enum class DecodePath
+    {
+        Mono,         // monoDecodeStrategy
+        Stereo,       // stereoDecodeStrategy
+        ReadBuffer,   // readBufferDecodeStrategy, the input is already Mach1Spatial
+        Intermediary, // intermediaryBufferTranscodeStrategy + intermediaryBufferDecodeStrategy
+        Fused         // fusedTranscodeDecodeStrategy
+    };
+}
+
+//==============================================================================
+juce::Result OfflineBounce::loadKeyframes(const juce::File& file, std::vector<Keyframe>& keyframes)
+{
+    if (!file.existsAsFile())
+        return juce::Result::fail("Keyframe file not found: " + file.getFullPathName());
+
+    juce::StringArray lines;
+    file.readLines(lines);
+
+    keyframes.clear();
+    for (int i = 0; i < lines.size(); ++i)
+    {
+        const auto line = lines[i].upToFirstOccurrenceOf("#", false, false).trim();
+        if (line.isEmpty())
+            continue;
+
+        juce::StringArray tokens;
+        tokens.addTokens(line.replaceCharacter(',', ' '), " \t", "");
+        tokens.removeEmptyStrings();
+        if (tokens.size() != 4)
+            return juce::Result::fail("Line " + juce::String(i + 1) + ": expected \"time yaw pitch roll\"");
+
+        keyframes.push_back({ tokens[0].getDoubleValue(), tokens[1].getFloatValue(),
+                              tokens[2].getFloatValue(), tokens[3].getFloatValue() });
+    }
+
+    std::stable_sort(keyframes.begin(), keyframes.end(), [](const Keyframe& a, const Keyframe& b) {
+        return a.time < b.time;
+    });
+    return juce::Result::ok();
+}
+
+OfflineBounce::Keyframe OfflineBounce::getOrientationAt(const std::vector<Keyframe>& keyframes, double time)
+{
+    if (keyframes.empty())
+        return { time, 0.0f, 0.0f, 0.0f };
+    if (time <= keyframes.front().time)
+        return keyframes.front();
+    if (time >= keyframes.back().time)
+        return keyframes.back();
+
+    auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time,
+                                 [](double t, const Keyframe& k) { return t < k.time; });
+    auto previous = next - 1;
+
+    const double span = next->time - previous->time;
+    const float alpha = span > 0.0 ? (float) ((time - previous->time) / span) : 1.0f;
+    return { time,
+             previous->yaw + alpha * getShortestTurn(previous->yaw, next->yaw),
+             previous->pitch + alpha * (next->pitch - previous->pitch),
+             previous->roll + alpha * getShortestTurn(previous->roll, next->roll) };
+}
+
+//==============================================================================
+juce::Result OfflineBounce::render(const Settings& settings, std::function<void(double progress)> progress)
+{
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(settings.inputFile));
+    if (reader == nullptr)
+        return juce::Result::fail("Cannot read " + settings.inputFile.getFullPathName());
+
+    const int numInputChannels = (int) reader->numChannels;
+    const double sampleRate = reader->sampleRate;
+    const int blockSize = juce::jmax(16, settings.blockSize);
+
+    //==============================================================================
+    // Same format decisions as MainComponent::reconfigureAudioTranscode/reconfigureAudioDecode
+    DecodeChain chain;
+    chain.numInputChannels = numInputChannels;
+    chain.sampleRate = sampleRate;
+    DecodeChain::initialiseDecode(chain.decode);
+
+    DecodePath path = numInputChannels == 1 ? DecodePath::Mono : DecodePath::Stereo;
+    int decodeChannels = numInputChannels;
+
+    if (numInputChannels > 2)
+    {
+        const std::string inputFormat = settings.inputFormat.empty()
+                                      ? FormatDefaults::getDefaultFormatForChannelCount(numInputChannels)
+                                      : settings.inputFormat;
+        if (inputFormat.empty())
+            return juce::Result::fail("No default format for " + juce::String(numInputChannels) + " channels, pass --format");
+
+        Mach1DecodeMode mode = M1DecodeSpatial_14;
+        const bool spatialInput = DecodeChain::getDecodeMode(inputFormat, mode);
+        if (spatialInput)
+            chain.decode.setDecodeMode(mode);
+
+        if (spatialInput && chain.decode.getFormatChannelCount() == numInputChannels)
+        {
+            path = DecodePath::ReadBuffer; // already Mach1Spatial, decode directly
+        }
+        else
+        {
+            const std::string outputFormat = FormatDefaults::getPreferredOutputFormat(inputFormat);
+            if (!chain.setTranscodeFormats(inputFormat, outputFormat))
+                return juce::Result::fail("No conversion path from " + juce::String(inputFormat) + " to " + juce::String(outputFormat));
+
+            mode = M1DecodeSpatial_14;
+            DecodeChain::getDecodeMode(outputFormat, mode);
+            chain.decode.setDecodeMode(mode);
+            decodeChannels = chain.decode.getFormatChannelCount();
+
+            // a single matrix conversion is folded into the decode, as the player does by default
+            path = chain.storeConversionMatrix(DecodeChain::MAX_DECODE_CHANNELS) && chain.conversionOutputChannels == decodeChannels
+                 ? DecodePath::Fused
+                 : DecodePath::Intermediary;
+        }
+    }
+    chain.setMixChannelCount(path == DecodePath::Intermediary ? decodeChannels : numInputChannels);
+
+    DecodeChain::Listener listener;
+    chain.prepareListener(listener, 0, numInputChannels > 2);
+
+    // gains glide across each block so orientation changes never step
+    listener.decodeCoeffRamp.setRampLengthSeconds(blockSize / sampleRate);
+
+    //==============================================================================
+    settings.outputFile.deleteFile();
+    std::unique_ptr<juce::OutputStream> stream(settings.outputFile.createOutputStream());
+    if (stream == nullptr)
+        return juce::Result::fail("Cannot write " + settings.outputFile.getFullPathName());
+
+    juce::WavAudioFormat wav;
+    std::unique_ptr<juce::AudioFormatWriter> writer(wav.createWriterFor(stream.get(), sampleRate, 2,
+                                                                        settings.bitDepth, {}, 0));
+    if (writer == nullptr)
+        return juce::Result::fail("Cannot create a " + juce::String(settings.bitDepth) + " bit WAV writer");
+    stream.release(); // owned by the writer now
+
+    juce::AudioBuffer<float> readBuffer(numInputChannels, blockSize);
+    juce::AudioBuffer<float> intermediaryBuffer(juce::jmax(1, decodeChannels), blockSize);
+    juce::AudioBuffer<float> outputBuffer(2, blockSize);
+    bool firstBlock = true;
+
+    const juce::int64 totalSamples = reader->lengthInSamples;
+    for (juce::int64 position = 0; position < totalSamples; position += blockSize)
+    {
+        const int numSamples = (int) juce::jmin((juce::int64) blockSize, totalSamples - position);
+        reader->read(&readBuffer, 0, numSamples, position, true, true);
+        outputBuffer.clear();
+
+        DecodeChain::Output output;
+        output.left = outputBuffer.getWritePointer(0);
+        output.right = outputBuffer.getWritePointer(1);
+        output.numSamples = numSamples;
+        output.startSettled = firstBlock;
+        firstBlock = false;
+
+        const auto keyframe = getOrientationAt(settings.keyframes, position / sampleRate);
+        const DecodeChain::Orientation orientation { keyframe.yaw, keyframe.pitch, keyframe.roll };
+        const float* const* input = readBuffer.getArrayOfReadPointers();
+
+        switch (path)
+        {
+            case DecodePath::Mono:
+                chain.mixWithSmoothedCoeffs(listener, input, 1, DecodeChain::MONO_COEFFS, output);
+                break;
+            case DecodePath::Stereo:
+                chain.mixWithSmoothedCoeffs(listener, input, 2, DecodeChain::STEREO_COEFFS, output);
+                break;
+            case DecodePath::ReadBuffer:
+                chain.decodeToStereo(listener, input, numInputChannels, orientation, output);
+                break;
+            case DecodePath::Intermediary:
+                intermediaryBuffer.setSize(decodeChannels, numSamples, false, false, true);
+                if (!chain.transcodeBlock(input, intermediaryBuffer.getArrayOfWritePointers(), decodeChannels, numSamples, nullptr))
+                    return juce::Result::fail("Transcode failed at sample " + juce::String(position));
+                chain.decodeToStereo(listener, intermediaryBuffer.getArrayOfReadPointers(), decodeChannels, orientation, output);
+                break;
+            case DecodePath::Fused:
+                chain.fusedTranscodeDecode(listener, input, orientation, output);
+                break;
+        }
+
+        if (!writer->writeFromAudioSampleBuffer(outputBuffer, 0, numSamples))
+            return juce::Result::fail("Write failed at sample " + juce::String(position));
+
+        if (progress != nullptr)
+            progress((double) (position + numSamples) / (double) totalSamples);
+    }
+
+    return juce::Result::ok();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Renders a multichannel file to binaural stereo WAV without an audio device.
+ *
+ * Runs the player's DecodeChain: Mach1Transcode to the preferred Mach1Spatial format (folded
+ * into the decode when the conversion is a single matrix), Mach1Decode coefficients at the
+ * listener orientation, and the ramped stereo mix. Blocks are processed back to back as fast
+ * as the CPU allows.
+ */
+class OfflineBounce
+{
+public:
+    struct Keyframe
+    {
+        double time = 0.0; // seconds
+        float yaw = 0.0f, pitch = 0.0f, roll = 0.0f; // degrees
+    };
+
+    struct Settings
+    {
+        juce::File inputFile;
+        juce::File outputFile;
+        std::string inputFormat;          // empty picks the default for the file's channel count
+        std::vector<Keyframe> keyframes;  // empty renders facing forward
+        int blockSize = 256;
+        int bitDepth = 24;
+    };
+
+    /**
+     * Reads "time yaw pitch roll" lines (seconds and degrees, separated by spaces or commas,
+     * '#' starts a comment). Keyframes are sorted by time.
+     */
+    static juce::Result loadKeyframes(const juce::File& file, std::vector<Keyframe>& keyframes);
+
+    // Linear interpolation between keyframes, holding the first/last outside their range. Yaw and
+    // roll take the shorter way round, so 350 -> 10 turns 20 degrees through 0, not 340 back.
+    static Keyframe getOrientationAt(const std::vector<Keyframe>& keyframes, double time);
+
+    // progress is called with values from 0 to 1
+    juce::Result render(const Settings& settings, std::function<void(double progress)> progress = nullptr);
+};
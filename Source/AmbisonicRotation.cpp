@@ -0,0 +1,199 @@
+#include "AmbisonicRotation.h"
+
+#include <algorithm>
+#include <cmath>
+
+int AmbisonicRotation::getOrderForFormat(const std::string& format, int numChannels)
+{
+    if (format.rfind("ACN", 0) != 0)
+        return 0;
+
+    for (int l = 1; l <= MAX_ORDER; ++l)
+    {
+        if (numChannels == (l + 1) * (l + 1))
+            return l;
+    }
+    return 0;
+}
+
+//==============================================================================
+void AmbisonicRotation::prepare(int newOrder)
+{
+    order = juce::jlimit(0, MAX_ORDER, newOrder);
+
+    blockOffsets.resize((size_t) order + 1);
+    size_t size = 0;
+    for (int l = 0; l <= order; ++l)
+    {
+        blockOffsets[(size_t) l] = size;
+        size += (size_t) ((2 * l + 1) * (2 * l + 1));
+    }
+    blocks.assign(size, 0.0f);
+    terms.clear();
+    termStarts.assign(size + 1, 0);
+
+    // Ivanic & Ruedenberg, "Rotation Matrices for Real Spherical Harmonics" (1996, with the
+    // 1998 corrections). Every element of order l >= 2 is a fixed weighted sum of products of
+    // an order 1 element and an order l - 1 element, so the recurrence is expanded into those
+    // products once here and setOrientation() only runs the multiply-adds.
+    for (int l = 2; l <= order; ++l)
+    {
+        const int previousSize = 2 * l - 1;
+
+        // P(i, a, b) of the paper, scaled; i, a and b are centred on 0
+        auto addP = [&] (float scale, int i, int a, int b)
+        {
+            auto add = [&] (float weight, int j, int column)
+            {
+                terms.push_back({ scale * weight, (uint16_t) ((i + 1) * 3 + j + 1),
+                                  (uint16_t) ((a + l - 1) * previousSize + column + l - 1) });
+            };
+
+            if (b == l)
+            {
+                add(1.0f, 1, l - 1);
+                add(-1.0f, -1, -l + 1);
+            }
+            else if (b == -l)
+            {
+                add(1.0f, 1, -l + 1);
+                add(1.0f, -1, l - 1);
+            }
+            else
+            {
+                add(1.0f, 0, b);
+            }
+        };
+
+        for (int m = -l; m <= l; ++m)
+        {
+            for (int n = -l; n <= l; ++n)
+            {
+                const double d = m == 0 ? 1.0 : 0.0;
+                const double absM = std::abs(m);
+                const double denom = std::abs(n) == l ? (2.0 * l) * (2.0 * l - 1.0) : (double) (l + n) * (l - n);
+                const auto u = (float) std::sqrt((l + m) * (l - m) / denom);
+                const auto v = (float) (0.5 * std::sqrt((1.0 + d) * (l + absM - 1.0) * (l + absM) / denom) * (1.0 - 2.0 * d));
+                const auto w = (float) (-0.5 * std::sqrt((l - absM - 1.0) * (l - absM) / denom) * (1.0 - d));
+
+                if (u != 0.0f)
+                    addP(u, 0, m, n);
+
+                if (v != 0.0f)
+                {
+                    if (m == 0)
+                    {
+                        addP(v, 1, 1, n);
+                        addP(v, -1, -1, n);
+                    }
+                    else if (m == 1)
+                    {
+                        addP(v * juce::MathConstants<float>::sqrt2, 1, 0, n);
+                    }
+                    else if (m == -1)
+                    {
+                        addP(v * juce::MathConstants<float>::sqrt2, -1, 0, n);
+                    }
+                    else if (m > 0)
+                    {
+                        addP(v, 1, m - 1, n);
+                        addP(-v, -1, -m + 1, n);
+                    }
+                    else
+                    {
+                        addP(v, 1, m + 1, n);
+                        addP(v, -1, -m - 1, n);
+                    }
+                }
+
+                if (w != 0.0f)
+                {
+                    if (m > 0)
+                    {
+                        addP(w, 1, m + 1, n);
+                        addP(w, -1, -m - 1, n);
+                    }
+                    else
+                    {
+                        addP(w, 1, m - 1, n);
+                        addP(-w, -1, -m + 1, n);
+                    }
+                }
+
+                termStarts[blockOffsets[(size_t) l] + (size_t) ((m + l) * (2 * l + 1) + n + l) + 1] = (uint32_t) terms.size();
+            }
+        }
+    }
+
+    // elements of orders 0 and 1 have no terms
+    for (size_t element = 1; element < termStarts.size(); ++element)
+        termStarts[element] = std::max(termStarts[element], termStarts[element - 1]);
+
+    setOrientation(0.0f, 0.0f, 0.0f);
+}
+
+//==============================================================================
+void AmbisonicRotation::setOrientation(float yawDegrees, float pitchDegrees, float rollDegrees) noexcept
+{
+    if (blocks.empty())
+        return;
+
+    // Sound field rotation Rx(-roll) * Ry(pitch) * Rz(yaw), with x to the front, y to the left
+    // and z up, i.e. the inverse of the head's yaw-pitch-roll rotation
+    const float cy = std::cos(juce::degreesToRadians(yawDegrees)), sy = std::sin(juce::degreesToRadians(yawDegrees));
+    const float cp = std::cos(juce::degreesToRadians(pitchDegrees)), sp = std::sin(juce::degreesToRadians(pitchDegrees));
+    const float cr = std::cos(juce::degreesToRadians(rollDegrees)), sr = -std::sin(juce::degreesToRadians(rollDegrees));
+
+    const float r[3][3] = {
+        { cp * cy,                  -cp * sy,                 sp },
+        { sr * sp * cy + cr * sy,   -sr * sp * sy + cr * cy,  -sr * cp },
+        { -cr * sp * cy + sr * sy,  cr * sp * sy + sr * cy,   cr * cp }
+    };
+
+    blocks[0] = 1.0f;
+    if (order < 1)
+        return;
+
+    // order 1 is the rotation itself, in ACN channel order (y, z, x)
+    static constexpr int axis[3] = { 1, 2, 0 };
+    float* block1 = blocks.data() + blockOffsets[1];
+    for (int m = 0; m < 3; ++m)
+        for (int n = 0; n < 3; ++n)
+            block1[m * 3 + n] = r[axis[m]][axis[n]];
+
+    for (int l = 2; l <= order; ++l)
+    {
+        const float* previous = blocks.data() + blockOffsets[(size_t) l - 1];
+        const size_t end = blockOffsets[(size_t) l] + (size_t) ((2 * l + 1) * (2 * l + 1));
+
+        for (size_t element = blockOffsets[(size_t) l]; element < end; ++element)
+        {
+            float sum = 0.0f;
+            for (uint32_t t = termStarts[element]; t < termStarts[element + 1]; ++t)
+                sum += terms[t].weight * block1[terms[t].order1Index] * previous[terms[t].previousIndex];
+            blocks[element] = sum;
+        }
+    }
+}
+
+void AmbisonicRotation::rotateDecodeWeights(const float* weights, float* rotated) const noexcept
+{
+    for (int l = 0; l <= order; ++l)
+    {
+        const int size = 2 * l + 1;
+        const int first = l * l; // ACN index of the order's first channel
+        const float* block = getBlock(l);
+
+        for (int n = 0; n < size; ++n)
+        {
+            float left = 0.0f, right = 0.0f;
+            for (int m = 0; m < size; ++m)
+            {
+                left += weights[(first + m) * 2 + 0] * block[m * size + n];
+                right += weights[(first + m) * 2 + 1] * block[m * size + n];
+            }
+            rotated[(first + n) * 2 + 0] = left;
+            rotated[(first + n) * 2 + 1] = right;
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Sound field rotation of full-order ACN ambisonics in the spherical harmonic domain.
+ *
+ * A rotation only mixes the 2l+1 channels of each order l among themselves, so it is a block
+ * diagonal matrix with one (2l+1)x(2l+1) block per order. The blocks are built from the 3x3
+ * rotation with the Ivanic-Ruedenberg recurrence, each order from the one below it. The
+ * per-order normalisation (SN3D, N3D, maxRE weights) is constant within an order, so the same
+ * blocks rotate any of them.
+ *
+ * The player only ever rotates ahead of a fixed linear decode, so rather than rotating the
+ * signals every sample it rotates the decode weights whenever the orientation changes:
+ * weights^T * R * x == (R^T * weights)^T * x.
+ */
+class AmbisonicRotation
+{
+public:
+    static constexpr int MAX_ORDER = 6;
+    static constexpr int MAX_CHANNELS = (MAX_ORDER + 1) * (MAX_ORDER + 1);
+
+    // Order of a full-sphere ACN format with numChannels channels, or 0 when it is not one
+    static int getOrderForFormat(const std::string& format, int numChannels);
+
+    //==============================================================================
+    // Allocates the blocks and the recurrence coefficients; not for the audio thread
+    void prepare(int newOrder);
+
+    int getOrder() const noexcept { return order; }
+    int getNumChannels() const noexcept { return (order + 1) * (order + 1); }
+
+    /**
+     * Rebuilds every order's block for a listener orientation in degrees, in the Mach1Decode
+     * convention (yaw turns to the right, pitch looks up, roll tilts the right ear down). The
+     * sound field turns the opposite way to the head.
+     */
+    void setOrientation(float yawDegrees, float pitchDegrees, float rollDegrees) noexcept;
+
+    /**
+     * Decode weights for the rotated field: for each ACN channel n,
+     * rotated[n * 2 + side] = sum over m of weights[m * 2 + side] * R[m][n], with m and n
+     * running over the channels of n's order. weights and rotated must not overlap.
+     */
+    void rotateDecodeWeights(const float* weights, float* rotated) const noexcept;
+
+    // Block of order l, row major ([m * (2l + 1) + n], ACN order within the block)
+    const float* getBlock(int l) const noexcept { return blocks.data() + blockOffsets[(size_t) l]; }
+
+private:
+    // weight * order 1 element * order l - 1 element, one product of the expanded recurrence
+    struct Term
+    {
+        float weight = 0.0f;
+        uint16_t order1Index = 0;
+        uint16_t previousIndex = 0;
+    };
+
+    int order = 0;
+    std::vector<size_t> blockOffsets;  // per order, into blocks
+    std::vector<float> blocks;         // every order's block, order 0 first
+    std::vector<Term> terms;           // from prepare(), in element order
+    std::vector<uint32_t> termStarts;  // per element of blocks, plus the end
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <cmath>
+
+#include "RealtimeSnapshot.h"
+
+/**
+ * Audio thread side of switching between configs published through a RealtimeSnapshot.
+ *
+ * Each block pickUp() is given the snapshot's latest config. A config for the same input
+ * channel count as the one playing is crossfaded in: the outgoing one keeps rendering for the
+ * fade length and is mixed out with an equal-power fade, then let go of. Anything else switches
+ * at once. The config playing is retained in snapshot slot 0 and the outgoing one in slot 1, so
+ * both stay alive after the block's ScopedAccess has released the latest.
+ *
+ * Config needs an int numInputChannels and a bool startRampsSettled, which is set on a config
+ * that is crossfaded in so it starts from its own coeffs rather than ramping up to them.
+ */
+template <typename Config>
+class AudioConfigHandover
+{
+public:
+    explicit AudioConfigHandover(RealtimeSnapshot<Config>& s) : snapshot(s) {}
+
+    // Equal-power gains of one block of the fade, interpolated linearly across numSamples
+    struct FadeSegment
+    {
+        int numSamples = 0;
+        float incomingStart = 1.0f, incomingEnd = 1.0f;
+        float outgoingStart = 0.0f, outgoingEnd = 0.0f;
+    };
+
+    // Call while the device is stopped, any fade in progress is dropped
+    void prepare(double sampleRate, double crossfadeSeconds)
+    {
+        endFade();
+        fadeLength = juce::jmax(1, juce::roundToInt(crossfadeSeconds * sampleRate));
+    }
+
+    //==============================================================================
+    // Audio thread
+
+    // Switches to latest if it differs from the config playing, with mediaChannels the input
+    // channel count of the media now. Returns true when the rendered config changed.
+    bool pickUp(Config* latest, int mediaChannels) noexcept
+    {
+        if (fading != nullptr)
+        {
+            if (rendered->numInputChannels == mediaChannels)
+                return false; // finish the fade in progress before moving on to a newer config
+            endFade(); // the media changed under the fade
+        }
+        if (latest == rendered)
+            return false;
+
+        // The outgoing config goes to slot 1 before slot 0 is overwritten, see RealtimeSnapshot::retain()
+        if (rendered != nullptr && latest != nullptr && rendered->numInputChannels == mediaChannels
+            && latest->numInputChannels == mediaChannels)
+        {
+            fading = rendered;
+            snapshot.retain(1, fading);
+            fadePosition = 0;
+            latest->startRampsSettled = true;
+        }
+        rendered = latest;
+        snapshot.retain(0, rendered);
+        return true;
+    }
+
+    Config* getRenderedConfig() const noexcept { return rendered; }
+    Config* getFadingConfig() const noexcept   { return fading; } // nullptr unless a fade is in progress
+
+    // Moves the fade on by a block of numSamples and lets go of the outgoing config once it is
+    // over. The rest of a block longer than the segment is the incoming config alone.
+    FadeSegment advanceFade(int numSamples) noexcept
+    {
+        FadeSegment segment;
+        if (fading == nullptr)
+            return segment;
+
+        segment.numSamples = juce::jmin(numSamples, fadeLength - fadePosition);
+        const float start = juce::MathConstants<float>::halfPi * (float) fadePosition / (float) fadeLength;
+        const float end = juce::MathConstants<float>::halfPi * (float) (fadePosition + segment.numSamples) / (float) fadeLength;
+        segment.incomingStart = std::sin(start);
+        segment.incomingEnd = std::sin(end);
+        segment.outgoingStart = std::cos(start);
+        segment.outgoingEnd = std::cos(end);
+
+        fadePosition += segment.numSamples;
+        if (fadePosition >= fadeLength)
+            endFade();
+        return segment;
+    }
+
+    void endFade() noexcept
+    {
+        fading = nullptr;
+        snapshot.retain(1, nullptr);
+    }
+
+private:
+    RealtimeSnapshot<Config>& snapshot;
+    Config* rendered = nullptr; // retained in slot 0
+    Config* fading = nullptr;   // retained in slot 1 while it fades out
+    int fadePosition = 0;
+    int fadeLength = 1;
+
+    JUCE_DECLARE_NON_COPYABLE(AudioConfigHandover)
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <atomic>
+
+/**
+ * Fixed-capacity queue of plain events from the audio thread to the message thread.
+ *
+ * The audio thread reports errors and notable conditions by posting small POD events, the UI
+ * drains them once per frame and decides how to present them. Posting is wait-free and never
+ * allocates or touches a string, so it is safe anywhere in the device callback. When the UI
+ * falls behind and the queue is full, the event is dropped and counted instead of blocking.
+ */
+class AudioEventQueue
+{
+public:
+    static constexpr int CAPACITY = 64;
+
+    enum Type
+    {
+        ErrorOutput = 0, // no decode or layout for the device outputs
+        ErrorTranscode,  // Mach1Transcode threw during processConversion()
+        FormatChange,    // a new config started rendering; value is its input and detail its output channel count
+        DeadlineMiss,    // the callback overran its period; value is its load in percent
+        Underrun         // the media ran dry; value is the total underrun count
+    };
+
+    struct Event
+    {
+        Type type = ErrorOutput;
+        int value = 0;
+        int detail = 0;
+        double time = 0.0; // Time::getMillisecondCounterHiRes() when posted
+    };
+
+    //==============================================================================
+    // Producer side, the audio thread
+    bool post(Type type, int value = 0, int detail = 0) noexcept
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(1, start1, size1, start2, size2);
+        if (size1 == 0)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        events[start1] = { type, value, detail, juce::Time::getMillisecondCounterHiRes() };
+        fifo.finishedWrite(1);
+        return true;
+    }
+
+    //==============================================================================
+    // Consumer side, the message thread. Calls handler(const Event&) for every queued event in
+    // posting order and returns how many there were.
+    template <typename Handler>
+    int drain(Handler&& handler)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+
+        for (int i = 0; i < size1; ++i)
+            handler(events[start1 + i]);
+        for (int i = 0; i < size2; ++i)
+            handler(events[start2 + i]);
+
+        fifo.finishedRead(size1 + size2);
+        return size1 + size2;
+    }
+
+    // Any thread: events lost to a full queue since the start
+    juce::uint32 getNumDropped() const noexcept { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    juce::AbstractFifo fifo { CAPACITY + 1 }; // AbstractFifo keeps one slot free
+    Event events[CAPACITY + 1];
+    std::atomic<juce::uint32> dropped { 0 };
+};
@@ -0,0 +1,362 @@
+#include "BinauralConvolver.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "PolyphaseResampler.h"
+
+namespace
+{
+    // acc += x * h for interleaved complex spectra; numFloats is a multiple of 4
+    void complexMultiplyAccumulate(const float* x, const float* h, float* acc, int numFloats) noexcept
+    {
+        int i = 0;
+
+       #if M1_DECODE_KERNEL_X86 && defined(__AVX__)
+        for (; i + 8 <= numFloats; i += 8)
+        {
+            const __m256 xv = _mm256_loadu_ps(x + i);
+            const __m256 hv = _mm256_loadu_ps(h + i);
+            const __m256 hRe = _mm256_moveldup_ps(hv);
+            const __m256 hIm = _mm256_movehdup_ps(hv);
+            const __m256 xSwap = _mm256_permute_ps(xv, 0xb1);
+            // even lanes: xr * hr - xi * hi, odd lanes: xi * hr + xr * hi
+            const __m256 product = _mm256_addsub_ps(_mm256_mul_ps(xv, hRe), _mm256_mul_ps(xSwap, hIm));
+            _mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), product));
+        }
+       #endif
+
+       #if M1_DECODE_KERNEL_X86
+        {
+            const __m128 negateReal = _mm_setr_ps(-0.0f, 0.0f, -0.0f, 0.0f);
+            for (; i + 4 <= numFloats; i += 4)
+            {
+                const __m128 xv = _mm_loadu_ps(x + i);
+                const __m128 hv = _mm_loadu_ps(h + i);
+                const __m128 hRe = _mm_shuffle_ps(hv, hv, _MM_SHUFFLE(2, 2, 0, 0));
+                const __m128 hIm = _mm_shuffle_ps(hv, hv, _MM_SHUFFLE(3, 3, 1, 1));
+                const __m128 xSwap = _mm_shuffle_ps(xv, xv, _MM_SHUFFLE(2, 3, 0, 1));
+                const __m128 product = _mm_add_ps(_mm_mul_ps(xv, hRe), _mm_xor_ps(_mm_mul_ps(xSwap, hIm), negateReal));
+                _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), product));
+            }
+        }
+       #elif M1_DECODE_KERNEL_NEON
+        for (; i + 8 <= numFloats; i += 8)
+        {
+            const float32x4x2_t xv = vld2q_f32(x + i);
+            const float32x4x2_t hv = vld2q_f32(h + i);
+            float32x4x2_t sum = vld2q_f32(acc + i);
+            sum.val[0] = vmlsq_f32(vmlaq_f32(sum.val[0], xv.val[0], hv.val[0]), xv.val[1], hv.val[1]);
+            sum.val[1] = vmlaq_f32(vmlaq_f32(sum.val[1], xv.val[0], hv.val[1]), xv.val[1], hv.val[0]);
+            vst2q_f32(acc + i, sum);
+        }
+       #endif
+
+        for (; i < numFloats; i += 2)
+        {
+            const float re = x[i] * h[i] - x[i + 1] * h[i + 1];
+            const float im = x[i] * h[i + 1] + x[i + 1] * h[i];
+            acc[i] += re;
+            acc[i + 1] += im;
+        }
+    }
+}
+
+//==============================================================================
+std::shared_ptr<const BinauralConvolver::Filters> BinauralConvolver::loadFilters(const juce::File& file, double sampleRate, juce::String& error)
+{
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+    if (reader == nullptr)
+    {
+        error = "Cannot read " + file.getFileName();
+        return nullptr;
+    }
+
+    // one left/right pair per M1Spatial-4, -8 or -14 virtual speaker
+    const int numChannels = (int) reader->numChannels;
+    if (numChannels != 8 && numChannels != 16 && numChannels != 28)
+    {
+        error = file.getFileName() + " needs 8, 16 or 28 channels (left, right ear per M1Spatial speaker)";
+        return nullptr;
+    }
+    if (reader->sampleRate <= 0.0 || sampleRate <= 0.0)
+    {
+        error = "Invalid sample rate for " + file.getFileName();
+        return nullptr;
+    }
+
+    // only read what is left after truncation at the output rate
+    const double ratio = sampleRate / reader->sampleRate;
+    const int sourceLength = (int) juce::jmin(reader->lengthInSamples, (juce::int64) std::ceil(MAX_FILTER_SAMPLES / ratio));
+    if (sourceLength <= 0)
+    {
+        error = file.getFileName() + " is empty";
+        return nullptr;
+    }
+
+    juce::AudioBuffer<float> impulses(numChannels, sourceLength);
+    reader->read(&impulses, 0, sourceLength, 0, true, true);
+
+    if (std::abs(ratio - 1.0) > 1.0e-9)
+    {
+        PolyphaseResampler resampler;
+        const int outputLength = juce::jmin(MAX_FILTER_SAMPLES, (int) std::ceil(sourceLength * ratio));
+        resampler.prepare(numChannels, outputLength, reader->sampleRate, sampleRate, PolyphaseResampler::QualityHigh);
+
+        // the filter window needs a tail of silence to reach the end of the impulses
+        juce::AudioBuffer<float> padded(numChannels, juce::jmax(sourceLength, resampler.getInputFramesNeeded(outputLength)));
+        padded.clear();
+        for (int channel = 0; channel < numChannels; ++channel)
+            padded.copyFrom(channel, 0, impulses, channel, 0, sourceLength);
+
+        juce::AudioBuffer<float> resampled(numChannels, outputLength);
+        resampler.process(padded.getArrayOfReadPointers(), resampler.getInputFramesNeeded(outputLength),
+                          resampled.getArrayOfWritePointers(), numChannels, outputLength);
+        impulses = std::move(resampled);
+    }
+
+    return createFilters(impulses, sampleRate, file.getFileNameWithoutExtension());
+}
+
+std::shared_ptr<const BinauralConvolver::Filters> BinauralConvolver::createFilters(const juce::AudioBuffer<float>& impulses, double sampleRate,
+                                                                                   const juce::String& name)
+{
+    auto filters = std::make_shared<Filters>();
+    filters->name = name;
+    filters->sampleRate = sampleRate;
+    filters->numSpeakers = impulses.getNumChannels() / 2;
+
+    const int length = juce::jmin(impulses.getNumSamples(), MAX_FILTER_SAMPLES);
+    filters->numPartitions = juce::jmax(1, (length + PARTITION_SIZE - 1) / PARTITION_SIZE);
+
+    const int numLanes = filters->numSpeakers * 2;
+    filters->spectra.assign((size_t) numLanes * (size_t) filters->numPartitions * SPECTRUM_FLOATS, 0.0f);
+
+    juce::dsp::FFT transform(PARTITION_ORDER + 1);
+    std::vector<float> buffer(FFT_SIZE * 2);
+    for (int lane = 0; lane < numLanes; ++lane)
+    {
+        for (int partition = 0; partition < filters->numPartitions; ++partition)
+        {
+            // each partition is zero padded to the FFT size, as overlap-save requires
+            std::fill(buffer.begin(), buffer.end(), 0.0f);
+            const int start = partition * PARTITION_SIZE;
+            const int count = juce::jmin(PARTITION_SIZE, length - start);
+            if (count > 0)
+                std::copy(impulses.getReadPointer(lane) + start, impulses.getReadPointer(lane) + start + count, buffer.begin());
+
+            transform.performRealOnlyForwardTransform(buffer.data(), true);
+            std::copy(buffer.begin(), buffer.begin() + NUM_BINS * 2,
+                      filters->spectra.begin() + (std::ptrdiff_t) ((size_t) lane * (size_t) filters->numPartitions + (size_t) partition) * SPECTRUM_FLOATS);
+        }
+    }
+
+    return filters;
+}
+
+//==============================================================================
+BinauralConvolver::BinauralConvolver() = default;
+
+void BinauralConvolver::prepare(int maxSpeakers)
+{
+    maxLanes = maxSpeakers * 2;
+    history.assign((size_t) maxLanes * FFT_SIZE, 0.0f);
+    delayLines.assign((size_t) maxLanes * MAX_PARTITIONS * SPECTRUM_FLOATS, 0.0f);
+    scratch.assign(FFT_SIZE * 2, 0.0f);
+    earSpectra.assign(FFT_SIZE * 2 * 2, 0.0f);
+    earOutput.assign(PARTITION_SIZE * 2, 0.0f);
+    reset();
+}
+
+void BinauralConvolver::reset() noexcept
+{
+    std::fill(history.begin(), history.end(), 0.0f);
+    std::fill(delayLines.begin(), delayLines.end(), 0.0f);
+    std::fill(earOutput.begin(), earOutput.end(), 0.0f);
+    currentFilters = nullptr;
+    head = 0;
+    fill = 0;
+}
+
+void BinauralConvolver::process(const Filters& filters, const float* const* inputs, int numSpeakers,
+                                const CoeffRamp& gains, int rampSamples, float* outL, float* outR, int numSamples) noexcept
+{
+    // a new filter set starts from silence instead of convolving the old delay lines with it
+    if (&filters != currentFilters)
+    {
+        reset();
+        currentFilters = &filters;
+    }
+
+    numSpeakers = juce::jmin(numSpeakers, filters.numSpeakers, maxLanes / 2);
+    const int numLanes = numSpeakers * 2;
+
+    int done = 0;
+    while (done < numSamples)
+    {
+        const int count = juce::jmin(numSamples - done, PARTITION_SIZE - fill);
+
+        for (int lane = 0; lane < numLanes; ++lane)
+            writeWeightedInput(inputs[lane / 2] + done, getHistory(lane) + PARTITION_SIZE + fill, lane, gains, rampSamples, done, count);
+
+        // the previous partition's output, PARTITION_SIZE samples behind the input
+        juce::FloatVectorOperations::add(outL + done, earOutput.data() + fill, count);
+        if (outR != nullptr)
+            juce::FloatVectorOperations::add(outR + done, earOutput.data() + PARTITION_SIZE + fill, count);
+
+        fill += count;
+        done += count;
+        if (fill == PARTITION_SIZE)
+        {
+            processPartition(filters, numLanes);
+            fill = 0;
+        }
+    }
+}
+
+void BinauralConvolver::writeWeightedInput(const float* in, float* dest, int lane, const CoeffRamp& gains,
+                                           int rampSamples, int offset, int numSamples) noexcept
+{
+    juce::FloatVectorOperations::clear(dest, numSamples);
+
+    // part of the chunk still inside the block's gain ramp
+    const int ramped = juce::jlimit(0, numSamples, rampSamples - offset);
+    if (ramped > 0)
+    {
+        const float start = gains.getRampStart()[lane];
+        const float step = (gains.getRampEnd()[lane] - start) / (float) rampSamples;
+        DecodeKernels::accumulateRamp(in, dest, start + step * (float) offset, step, ramped);
+    }
+    if (ramped < numSamples)
+        DecodeKernels::accumulateRamp(in + ramped, dest + ramped, gains.getCurrent()[lane], 0.0f, numSamples - ramped);
+}
+
+void BinauralConvolver::processPartition(const Filters& filters, int numLanes) noexcept
+{
+    // newest input spectrum of every lane into the head of its delay line
+    for (int lane = 0; lane < numLanes; ++lane)
+    {
+        float* laneHistory = getHistory(lane);
+        std::copy(laneHistory, laneHistory + FFT_SIZE, scratch.begin());
+        fft.performRealOnlyForwardTransform(scratch.data(), true);
+        std::copy(scratch.begin(), scratch.begin() + NUM_BINS * 2, getDelayLineSlot(lane, head));
+
+        // this partition becomes the overlap of the next one
+        std::copy(laneHistory + PARTITION_SIZE, laneHistory + FFT_SIZE, laneHistory);
+    }
+
+    float* left = earSpectra.data();
+    float* right = earSpectra.data() + FFT_SIZE * 2;
+    std::fill(left, left + SPECTRUM_FLOATS, 0.0f);
+    std::fill(right, right + SPECTRUM_FLOATS, 0.0f);
+
+    const int numPartitions = juce::jmin(filters.numPartitions, MAX_PARTITIONS);
+    for (int lane = 0; lane < numLanes; ++lane)
+    {
+        float* acc = (lane & 1) == 0 ? left : right;
+        int slot = head;
+        for (int partition = 0; partition < numPartitions; ++partition)
+        {
+            complexMultiplyAccumulate(getDelayLineSlot(lane, slot), filters.getSpectrum(lane, partition), acc, SPECTRUM_FLOATS);
+            slot = slot == 0 ? MAX_PARTITIONS - 1 : slot - 1;
+        }
+    }
+
+    // the last PARTITION_SIZE samples of each circular convolution are the valid output
+    for (int ear = 0; ear < 2; ++ear)
+    {
+        float* spectrum = ear == 0 ? left : right;
+        fft.performRealOnlyInverseTransform(spectrum);
+        std::copy(spectrum + PARTITION_SIZE, spectrum + FFT_SIZE, earOutput.begin() + ear * PARTITION_SIZE);
+    }
+
+    head = (head + 1) % MAX_PARTITIONS;
+}
+
+//==============================================================================
+BinauralFilterLoader::BinauralFilterLoader()
+    : juce::Thread("BinauralFilterLoader")
+{
+}
+
+BinauralFilterLoader::~BinauralFilterLoader()
+{
+    cancelPendingUpdate();
+    stopThread(10000);
+}
+
+void BinauralFilterLoader::load(const juce::File& file, double sampleRate, Callback onLoaded)
+{
+    {
+        const juce::ScopedLock sl(lock);
+        pendingFile = file;
+        pendingSampleRate = sampleRate;
+        hasPendingLoad = true;
+        callback = std::move(onLoaded);
+    }
+
+    if (!isThreadRunning())
+        startThread();
+    else
+        notify();
+}
+
+void BinauralFilterLoader::run()
+{
+    while (!threadShouldExit())
+    {
+        juce::File file;
+        double sampleRate = 0.0;
+        bool hasLoad = false;
+        {
+            const juce::ScopedLock sl(lock);
+            std::swap(hasLoad, hasPendingLoad);
+            file = pendingFile;
+            sampleRate = pendingSampleRate;
+        }
+
+        if (!hasLoad)
+        {
+            wait(-1);
+            continue;
+        }
+
+        const auto startTime = juce::Time::getMillisecondCounterHiRes();
+        juce::String error;
+        auto filters = BinauralConvolver::loadFilters(file, sampleRate, error);
+        if (filters != nullptr)
+        {
+            DBG("BinauralFilterLoader - Prepared " + filters->name + ": " + juce::String(filters->numSpeakers) + " speakers, "
+                + juce::String(filters->numPartitions) + " partitions in "
+                + juce::String(juce::Time::getMillisecondCounterHiRes() - startTime, 1) + " ms");
+        }
+
+        {
+            const juce::ScopedLock sl(lock);
+            if (hasPendingLoad)
+                continue; // superseded while loading
+            result = std::move(filters);
+            resultError = error;
+        }
+        triggerAsyncUpdate();
+    }
+}
+
+void BinauralFilterLoader::handleAsyncUpdate()
+{
+    std::shared_ptr<const BinauralConvolver::Filters> filters;
+    juce::String error;
+    Callback onLoaded;
+    {
+        const juce::ScopedLock sl(lock);
+        filters = std::move(result);
+        error = resultError;
+        onLoaded = callback;
+    }
+
+    if (onLoaded)
+        onLoaded(std::move(filters), error);
+}
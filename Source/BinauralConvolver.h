@@ -0,0 +1,149 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "CoeffRamp.h"
+#include "DecodeKernels.h" // for the M1_DECODE_KERNEL_* SIMD selection
+
+/**
+ * Binaural renderer that convolves every M1Spatial virtual speaker feed with a filter pair
+ * (HRIRs or short BRIRs), as an alternative to the amplitude-only stereo decode.
+ *
+ * The Mach1Decode gains still carry the head orientation: each speaker feed is weighted by its
+ * smoothed left and right gains exactly as DecodeKernels::mixToStereo would, and each weighted
+ * lane is then convolved with that speaker's filter for the ear. A filter set of unit impulses
+ * reproduces the plain decode.
+ *
+ * Convolution is uniformly partitioned overlap-save: filters are cut into PARTITION_SIZE blocks
+ * and transformed once when they are loaded (Filters, built off the audio thread). Per
+ * partition the audio thread runs one forward FFT per lane, multiply-accumulates the lanes'
+ * frequency-domain delay lines against the filter spectra and runs one inverse FFT per ear.
+ * Work happens on whole partitions, so the renderer adds PARTITION_SIZE samples of latency
+ * whatever the device block size is.
+ *
+ * The transforms are juce::dsp::FFT, which uses vDSP on macOS but falls back to JUCE's scalar
+ * FFT on Linux and Windows unless the build enables FFTW or IPP. Configure with
+ * -DM1_USE_SHARED_FFTW=ON to load libfftw3f at runtime when it is installed; only the
+ * spectral multiply-accumulate is vectorised otherwise.
+ */
+class BinauralConvolver
+{
+public:
+    static constexpr int PARTITION_ORDER = 6;
+    static constexpr int PARTITION_SIZE = 1 << PARTITION_ORDER;
+    static constexpr int FFT_SIZE = PARTITION_SIZE * 2;
+    static constexpr int NUM_BINS = FFT_SIZE / 2 + 1;
+
+    // 43ms at 48kHz; longer filters are truncated to keep 14 speakers within budget at 64 samples
+    static constexpr int MAX_FILTER_SAMPLES = 2048;
+    static constexpr int MAX_PARTITIONS = MAX_FILTER_SAMPLES / PARTITION_SIZE;
+
+    // Interleaved re/im for bins 0..FFT_SIZE/2, padded to a whole number of 4 float vectors
+    static constexpr int SPECTRUM_FLOATS = (NUM_BINS * 2 + 3) & ~3;
+
+    // Filter spectra for one sample rate; immutable once built
+    struct Filters
+    {
+        juce::String name;
+        double sampleRate = 0.0;
+        int numSpeakers = 0;
+        int numPartitions = 0;
+        std::vector<float> spectra; // [((speaker * 2 + ear) * numPartitions + partition) * SPECTRUM_FLOATS]
+
+        const float* getSpectrum(int lane, int partition) const noexcept
+        {
+            return spectra.data() + ((size_t) lane * (size_t) numPartitions + (size_t) partition) * SPECTRUM_FLOATS;
+        }
+    };
+
+    /**
+     * Reads a filter set: an audio file with two channels (left ear, right ear) per virtual
+     * speaker, in M1Spatial channel order. The impulses are resampled to sampleRate when the
+     * file differs. Not for the audio thread; returns null and sets error on failure.
+     */
+    static std::shared_ptr<const Filters> loadFilters(const juce::File& file, double sampleRate, juce::String& error);
+
+    // Partitions and transforms impulses that are already at sampleRate (2 channels per speaker)
+    static std::shared_ptr<const Filters> createFilters(const juce::AudioBuffer<float>& impulses, double sampleRate,
+                                                        const juce::String& name);
+
+    //==============================================================================
+    BinauralConvolver();
+
+    // Allocates the delay lines for up to maxSpeakers virtual speakers
+    void prepare(int maxSpeakers);
+    void reset() noexcept;
+
+    int getLatencySamples() const noexcept { return PARTITION_SIZE; }
+
+    /**
+     * Audio thread. Weights inputs[speaker] by the ramp's L/R gains ([speaker * 2 + ear], the
+     * first rampSamples samples ramping from getRampStart() to getRampEnd(), the rest at
+     * getCurrent()), convolves and accumulates into outL/outR. outR may be null for a mono
+     * device, in which case only the left ear is written.
+     */
+    void process(const Filters& filters, const float* const* inputs, int numSpeakers,
+                 const CoeffRamp& gains, int rampSamples, float* outL, float* outR, int numSamples) noexcept;
+
+private:
+    void writeWeightedInput(const float* in, float* dest, int lane, const CoeffRamp& gains,
+                            int rampSamples, int offset, int numSamples) noexcept;
+    void processPartition(const Filters& filters, int numLanes) noexcept;
+
+    float* getHistory(int lane) noexcept { return history.data() + (size_t) lane * FFT_SIZE; }
+    float* getDelayLineSlot(int lane, int slot) noexcept
+    {
+        return delayLines.data() + ((size_t) lane * MAX_PARTITIONS + (size_t) slot) * SPECTRUM_FLOATS;
+    }
+
+    juce::dsp::FFT fft { PARTITION_ORDER + 1 };
+
+    int maxLanes = 0;
+    std::vector<float> history;    // per lane: previous partition | partition being filled
+    std::vector<float> delayLines; // per lane: MAX_PARTITIONS past input spectra, ring indexed by head
+    std::vector<float> scratch;    // FFT work buffer, 2 * FFT_SIZE
+    std::vector<float> earSpectra; // per ear accumulator, 2 * FFT_SIZE each
+    std::vector<float> earOutput;  // per ear: last completed partition, PARTITION_SIZE each
+
+    const Filters* currentFilters = nullptr;
+    int head = 0; // delay line slot of the newest partition
+    int fill = 0; // samples of the current partition received so far
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BinauralConvolver)
+};
+
+//==============================================================================
+/**
+ * Loads and prepares BinauralConvolver filter sets on a background thread, so reading,
+ * resampling and transforming the impulses never stalls the UI or the audio thread.
+ */
+class BinauralFilterLoader : private juce::Thread,
+                             private juce::AsyncUpdater
+{
+public:
+    using Callback = std::function<void(std::shared_ptr<const BinauralConvolver::Filters> filters, const juce::String& error)>;
+
+    BinauralFilterLoader();
+    ~BinauralFilterLoader() override;
+
+    // Message thread. onLoaded is called on the message thread; a newer load replaces a pending one.
+    void load(const juce::File& file, double sampleRate, Callback onLoaded);
+
+private:
+    void run() override;
+    void handleAsyncUpdate() override;
+
+    juce::CriticalSection lock;
+    juce::File pendingFile;
+    double pendingSampleRate = 0.0;
+    bool hasPendingLoad = false;
+    std::shared_ptr<const BinauralConvolver::Filters> result;
+    juce::String resultError;
+    Callback callback;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BinauralFilterLoader)
+};
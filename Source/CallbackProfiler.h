@@ -0,0 +1,241 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <cmath>
+
+#include "TripleBuffer.h"
+
+/**
+ * Load and deadline-miss instrumentation for the audio device callback.
+ *
+ * Every callback is timed as a whole and per stage, and each time is expressed as a load: the
+ * fraction of the block's period (numSamples / sampleRate) it used. Loads are counted into
+ * lock-free histograms, blocks with a total load above 1 count as deadline misses, and once per
+ * reporting window the worst blocks of that window are published through a TripleBuffer.
+ *
+ * The audio thread only reads the tick counter and does relaxed atomic increments; any other
+ * thread can read the histograms and the latest window at any time.
+ */
+class CallbackProfiler
+{
+public:
+    enum Stage
+    {
+        StageMediaPull = 0,
+        StageTranscode,
+        StageDecode,
+        StageMeter,
+        StageTotal, // the whole callback, including work outside the stages above
+        NumStages
+    };
+
+    // Histogram buckets are 5% of the period wide, the last one collects everything above 195%
+    static constexpr int NUM_LOAD_BUCKETS = 40;
+    static constexpr float LOAD_BUCKET_WIDTH = 0.05f;
+    static constexpr int NUM_WORST_BLOCKS = 4;
+    static constexpr double WINDOW_SECONDS = 1.0;
+
+    struct BlockRecord
+    {
+        float stageLoad[NumStages] {};
+        int numSamples = 0;
+        double time = 0.0; // Time::getMillisecondCounterHiRes() when the block finished
+    };
+
+    // One reporting window of audio time
+    struct Window
+    {
+        BlockRecord worst[NUM_WORST_BLOCKS] {}; // highest total load first
+        int numWorst = 0;
+        int numBlocks = 0;
+        int deadlineMisses = 0;
+        float averageLoad = 0.0f;
+        float peakLoad = 0.0f;
+    };
+
+    struct Histogram
+    {
+        juce::uint32 counts[NUM_LOAD_BUCKETS] {};
+        juce::uint32 total = 0;
+
+        // Upper edge of the bucket holding the given fraction (0-1) of blocks
+        float getPercentileLoad(float fraction) const noexcept
+        {
+            const auto threshold = (juce::uint32) std::ceil(fraction * (float) total);
+            juce::uint32 sum = 0;
+            for (int bucket = 0; bucket < NUM_LOAD_BUCKETS; ++bucket)
+            {
+                sum += counts[bucket];
+                if (sum >= threshold && sum > 0)
+                    return (float) (bucket + 1) * LOAD_BUCKET_WIDTH;
+            }
+            return 0.0f;
+        }
+    };
+
+    static const char* getStageName(int stage) noexcept
+    {
+        static const char* names[] = { "pull", "transcode", "decode", "meter", "total" };
+        return names[juce::jlimit(0, (int) NumStages - 1, stage)];
+    }
+
+    //==============================================================================
+    // Call before the device starts calling beginBlock()/endBlock()
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        ticksPerSecond = (double) juce::Time::getHighResolutionTicksPerSecond();
+        window = {};
+        windowSamples = 0;
+        windowLoadSum = 0.0;
+    }
+
+    // Any thread: clears the histograms and counters at the start of the next block
+    void requestReset() noexcept { resetRequested = true; }
+
+    //==============================================================================
+    // Audio thread
+    void beginBlock(int numSamples) noexcept
+    {
+        if (resetRequested.exchange(false))
+        {
+            for (auto& stage : histograms)
+                for (auto& count : stage)
+                    count.store(0, std::memory_order_relaxed);
+            totalBlocks.store(0, std::memory_order_relaxed);
+            totalMisses.store(0, std::memory_order_relaxed);
+        }
+
+        blockSamples = numSamples;
+        for (auto& ticks : stageTicks)
+            ticks = 0;
+        blockStartTicks = juce::Time::getHighResolutionTicks();
+    }
+
+    // Returns the block's total load, above 1 it missed its deadline
+    float endBlock() noexcept
+    {
+        stageTicks[StageTotal] = juce::Time::getHighResolutionTicks() - blockStartTicks;
+        if (blockSamples <= 0 || sampleRate <= 0.0)
+            return 0.0f;
+
+        const double periodTicks = ticksPerSecond * blockSamples / sampleRate;
+
+        BlockRecord record;
+        record.numSamples = blockSamples;
+        record.time = juce::Time::getMillisecondCounterHiRes();
+        for (int stage = 0; stage < NumStages; ++stage)
+        {
+            record.stageLoad[stage] = (float) (stageTicks[stage] / periodTicks);
+            const int bucket = juce::jlimit(0, NUM_LOAD_BUCKETS - 1, (int) (record.stageLoad[stage] / LOAD_BUCKET_WIDTH));
+            histograms[stage][bucket].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        const float load = record.stageLoad[StageTotal];
+        const bool missed = load > 1.0f;
+        totalBlocks.fetch_add(1, std::memory_order_relaxed);
+        if (missed)
+            totalMisses.fetch_add(1, std::memory_order_relaxed);
+
+        addToWindow(record, missed);
+        return load;
+    }
+
+    // Times one stage of the current block, stages may run more than once per block
+    class ScopedStage
+    {
+    public:
+        ScopedStage(CallbackProfiler& p, Stage s) noexcept
+            : profiler(p), stage(s), startTicks(juce::Time::getHighResolutionTicks()) {}
+
+        ~ScopedStage() noexcept
+        {
+            profiler.stageTicks[stage] += juce::Time::getHighResolutionTicks() - startTicks;
+        }
+
+    private:
+        CallbackProfiler& profiler;
+        const Stage stage;
+        const juce::int64 startTicks;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedStage)
+    };
+
+    //==============================================================================
+    // Any thread
+    Histogram getHistogram(int stage) const noexcept
+    {
+        Histogram histogram;
+        for (int bucket = 0; bucket < NUM_LOAD_BUCKETS; ++bucket)
+        {
+            histogram.counts[bucket] = histograms[stage][bucket].load(std::memory_order_relaxed);
+            histogram.total += histogram.counts[bucket];
+        }
+        return histogram;
+    }
+
+    juce::uint32 getTotalBlocks() const noexcept { return totalBlocks.load(std::memory_order_relaxed); }
+    juce::uint32 getDeadlineMisses() const noexcept { return totalMisses.load(std::memory_order_relaxed); }
+
+    // Last completed window; readers are serialised since the TripleBuffer has a single reader
+    Window getLatestWindow() noexcept
+    {
+        const juce::SpinLock::ScopedLockType lock(windowReaderLock);
+        return windows.read();
+    }
+
+private:
+    void addToWindow(const BlockRecord& record, bool missed) noexcept
+    {
+        const float load = record.stageLoad[StageTotal];
+
+        // keep the window's worst blocks sorted by total load
+        int position = window.numWorst;
+        while (position > 0 && window.worst[position - 1].stageLoad[StageTotal] < load)
+            --position;
+        if (position < NUM_WORST_BLOCKS)
+        {
+            for (int i = juce::jmin(window.numWorst, NUM_WORST_BLOCKS - 1); i > position; --i)
+                window.worst[i] = window.worst[i - 1];
+            window.worst[position] = record;
+            window.numWorst = juce::jmin(window.numWorst + 1, NUM_WORST_BLOCKS);
+        }
+
+        ++window.numBlocks;
+        if (missed)
+            ++window.deadlineMisses;
+        window.peakLoad = juce::jmax(window.peakLoad, load);
+        windowLoadSum += load;
+        windowSamples += record.numSamples;
+
+        if (windowSamples >= WINDOW_SECONDS * sampleRate)
+        {
+            window.averageLoad = (float) (windowLoadSum / window.numBlocks);
+            windows.write(window);
+            window = {};
+            windowSamples = 0;
+            windowLoadSum = 0.0;
+        }
+    }
+
+    double sampleRate = 0.0;
+    double ticksPerSecond = 1.0;
+
+    // audio thread
+    juce::int64 blockStartTicks = 0;
+    juce::int64 stageTicks[NumStages] {};
+    int blockSamples = 0;
+    Window window;
+    juce::int64 windowSamples = 0;
+    double windowLoadSum = 0.0;
+
+    std::atomic<juce::uint32> histograms[NumStages][NUM_LOAD_BUCKETS] {};
+    std::atomic<juce::uint32> totalBlocks { 0 };
+    std::atomic<juce::uint32> totalMisses { 0 };
+    std::atomic<bool> resetRequested { false };
+
+    TripleBuffer<Window> windows;
+    juce::SpinLock windowReaderLock;
+};
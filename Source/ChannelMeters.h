@@ -0,0 +1,211 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <cmath>
+
+#include "DecodeKernels.h" // for the M1_DECODE_KERNEL_* SIMD selection
+#include "TripleBuffer.h"
+
+/**
+ * Peak and RMS levels of every input channel and device output, measured on the audio thread.
+ *
+ * Each measured channel costs one vectorised pass over the block (running max of |x| and sum
+ * of squares). Levels are integrated over WINDOW_SECONDS windows of audio time; at the end of a
+ * window peaks get a hold-and-fall ballistic and the whole set is published through a
+ * TripleBuffer, so the UI always reads one consistent window and never misses a peak that fell
+ * between two frames.
+ */
+class ChannelMeters
+{
+public:
+    static constexpr int MAX_INPUTS = 64;
+    static constexpr int MAX_OUTPUTS = 16;
+    static constexpr double WINDOW_SECONDS = 0.02;
+    static constexpr double PEAK_HOLD_SECONDS = 1.5;
+    static constexpr float PEAK_FALL_DB_PER_SECOND = 24.0f;
+
+    // Linear gains, 1 = 0 dBFS
+    struct Channel
+    {
+        float peak = 0.0f; // falling peak
+        float rms = 0.0f;  // over the last window
+        float hold = 0.0f; // highest peak of the last PEAK_HOLD_SECONDS
+    };
+
+    struct Levels
+    {
+        Channel inputs[MAX_INPUTS] {};
+        Channel outputs[MAX_OUTPUTS] {};
+        int numInputs = 0;
+        int numOutputs = 0;
+    };
+
+    //==============================================================================
+    // Call before the device starts calling the audio thread methods
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        windowLength = juce::jmax(1, juce::roundToInt(WINDOW_SECONDS * sampleRate));
+        const double windowsPerSecond = sampleRate / windowLength;
+        peakFall = std::pow(10.0f, -PEAK_FALL_DB_PER_SECOND / (20.0f * (float) windowsPerSecond));
+        holdWindows = juce::jmax(1, juce::roundToInt(PEAK_HOLD_SECONDS * windowsPerSecond));
+
+        levels = {};
+        clearWindow();
+    }
+
+    //==============================================================================
+    // Audio thread
+    void measureInputs(const float* const* channels, int numChannels, int numSamples) noexcept
+    {
+        numChannels = juce::jmin(numChannels, (int) MAX_INPUTS);
+        for (int channel = 0; channel < numChannels; ++channel)
+            measure(channels[channel], numSamples, inputWindow[channel]);
+        levels.numInputs = numChannels;
+    }
+
+    void measureOutputs(const float* const* channels, int numChannels, int startSample, int numSamples) noexcept
+    {
+        numChannels = juce::jmin(numChannels, (int) MAX_OUTPUTS);
+        for (int channel = 0; channel < numChannels; ++channel)
+            measure(channels[channel] + startSample, numSamples, outputWindow[channel]);
+        levels.numOutputs = numChannels;
+    }
+
+    // Call once per callback after the measure calls
+    void endBlock(int numSamples) noexcept
+    {
+        windowSamples += numSamples;
+        if (windowSamples < windowLength)
+            return;
+
+        const float invSamples = 1.0f / (float) windowSamples;
+        for (int channel = 0; channel < MAX_INPUTS; ++channel)
+            applyBallistics(inputWindow[channel], levels.inputs[channel], inputHoldCounters[channel], invSamples);
+        for (int channel = 0; channel < MAX_OUTPUTS; ++channel)
+            applyBallistics(outputWindow[channel], levels.outputs[channel], outputHoldCounters[channel], invSamples);
+
+        snapshots.write(levels);
+        clearWindow();
+    }
+
+    //==============================================================================
+    // Any thread; readers are serialised since the TripleBuffer has a single reader
+    Levels getLevels() noexcept
+    {
+        const juce::SpinLock::ScopedLockType lock(readerLock);
+        return snapshots.read();
+    }
+
+    static float gainToDecibels(float gain, float minusInfinityDb = -100.0f) noexcept
+    {
+        return gain > 0.0f ? juce::jmax(minusInfinityDb, 20.0f * std::log10(gain)) : minusInfinityDb;
+    }
+
+private:
+    struct Accumulator
+    {
+        float peak = 0.0f;
+        float sumSquares = 0.0f;
+    };
+
+    static void measure(const float* in, int numSamples, Accumulator& acc) noexcept
+    {
+        int i = 0;
+        float peak = acc.peak;
+        float sumSquares = 0.0f;
+
+       #if M1_DECODE_KERNEL_X86
+        {
+            const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+            __m128 peaks = _mm_setzero_ps();
+            __m128 sums = _mm_setzero_ps();
+            for (; i + 4 <= numSamples; i += 4)
+            {
+                const __m128 x = _mm_loadu_ps(in + i);
+                peaks = _mm_max_ps(peaks, _mm_and_ps(x, absMask));
+                sums = _mm_add_ps(sums, _mm_mul_ps(x, x));
+            }
+            float peakLanes[4], sumLanes[4];
+            _mm_storeu_ps(peakLanes, peaks);
+            _mm_storeu_ps(sumLanes, sums);
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                peak = juce::jmax(peak, peakLanes[lane]);
+                sumSquares += sumLanes[lane];
+            }
+        }
+       #elif M1_DECODE_KERNEL_NEON
+        {
+            float32x4_t peaks = vdupq_n_f32(0.0f);
+            float32x4_t sums = vdupq_n_f32(0.0f);
+            for (; i + 4 <= numSamples; i += 4)
+            {
+                const float32x4_t x = vld1q_f32(in + i);
+                peaks = vmaxq_f32(peaks, vabsq_f32(x));
+                sums = vmlaq_f32(sums, x, x);
+            }
+            float peakLanes[4], sumLanes[4];
+            vst1q_f32(peakLanes, peaks);
+            vst1q_f32(sumLanes, sums);
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                peak = juce::jmax(peak, peakLanes[lane]);
+                sumSquares += sumLanes[lane];
+            }
+        }
+       #endif
+
+        for (; i < numSamples; ++i)
+        {
+            peak = juce::jmax(peak, std::abs(in[i]));
+            sumSquares += in[i] * in[i];
+        }
+
+        acc.peak = peak;
+        acc.sumSquares += sumSquares;
+    }
+
+    void applyBallistics(const Accumulator& window, Channel& channel, int& holdCounter, float invSamples) noexcept
+    {
+        channel.rms = std::sqrt(window.sumSquares * invSamples);
+        channel.peak = juce::jmax(window.peak, channel.peak * peakFall);
+
+        if (window.peak >= channel.hold)
+        {
+            channel.hold = window.peak;
+            holdCounter = holdWindows;
+        }
+        else if (--holdCounter <= 0)
+        {
+            channel.hold = channel.peak;
+            holdCounter = 0;
+        }
+    }
+
+    void clearWindow() noexcept
+    {
+        for (auto& acc : inputWindow)
+            acc = {};
+        for (auto& acc : outputWindow)
+            acc = {};
+        windowSamples = 0;
+    }
+
+    double sampleRate = 44100.0;
+    int windowLength = 882;
+    int holdWindows = 75;
+    float peakFall = 0.95f;
+
+    // audio thread
+    Accumulator inputWindow[MAX_INPUTS] {};
+    Accumulator outputWindow[MAX_OUTPUTS] {};
+    int inputHoldCounters[MAX_INPUTS] {};
+    int outputHoldCounters[MAX_OUTPUTS] {};
+    int windowSamples = 0;
+    Levels levels;
+
+    TripleBuffer<Levels> snapshots;
+    juce::SpinLock readerLock;
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * Block-rate replacement for a vector of juce::LinearSmoothedValue.
+ *
+ * All coefficients share one ramp: whenever setTargets() receives new values every coefficient
+ * starts a linear ramp of the same length from where it currently is. advance() then moves the
+ * whole vector forward by one block in O(coefficients) instead of stepping each value per sample,
+ * and reports how many samples of the block are still ramping so the caller can apply the ramp
+ * to that part and constant gains to the rest.
+ */
+class CoeffRamp
+{
+public:
+    void prepare(int maxCoeffs, double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        current.assign(maxCoeffs, 0.0f);
+        target.assign(maxCoeffs, 0.0f);
+        step.assign(maxCoeffs, 0.0f);
+        rampStart.assign(maxCoeffs, 0.0f);
+        rampEnd.assign(maxCoeffs, 0.0f);
+        remainingSamples = 0;
+        setRampLengthSeconds(rampLengthSeconds);
+    }
+
+    // Takes effect on the next target change
+    void setRampLengthSeconds(double seconds)
+    {
+        rampLengthSeconds = seconds;
+        rampLengthSamples = juce::jmax(1, juce::roundToInt(rampLengthSeconds * sampleRate));
+    }
+
+    int getRampLengthSamples() const { return rampLengthSamples; }
+
+    void setTargets(const float* newTargets, int count)
+    {
+        jassert(count <= (int) target.size());
+        if (count == activeCount && std::equal(newTargets, newTargets + count, target.begin()))
+            return;
+
+        std::copy(newTargets, newTargets + count, target.begin());
+        remainingSamples = rampLengthSamples;
+        const float invLength = 1.0f / (float) rampLengthSamples;
+        for (int i = 0; i < count; ++i)
+            step[i] = (target[i] - current[i]) * invLength;
+        activeCount = count;
+    }
+
+    // Jumps straight to the given values, e.g. after a discontinuity
+    void setCurrentAndTargets(const float* values, int count)
+    {
+        std::copy(values, values + count, current.begin());
+        std::copy(values, values + count, target.begin());
+        remainingSamples = 0;
+        activeCount = count;
+    }
+
+    /**
+     * Moves the coefficients forward by numSamples. Returns how many leading samples of the
+     * block are covered by a ramp from getRampStart() to getRampEnd(); the rest of the block
+     * (if any) uses the settled values from getCurrent().
+     */
+    int advance(int numSamples)
+    {
+        const int rampSamples = juce::jmin(numSamples, remainingSamples);
+        if (rampSamples <= 0)
+            return 0;
+
+        std::copy(current.begin(), current.begin() + activeCount, rampStart.begin());
+        remainingSamples -= rampSamples;
+        if (remainingSamples == 0)
+        {
+            std::copy(target.begin(), target.begin() + activeCount, current.begin());
+        }
+        else
+        {
+            for (int i = 0; i < activeCount; ++i)
+                current[i] += step[i] * (float) rampSamples;
+        }
+        std::copy(current.begin(), current.begin() + activeCount, rampEnd.begin());
+        return rampSamples;
+    }
+
+    const float* getRampStart() const { return rampStart.data(); }
+    const float* getRampEnd() const { return rampEnd.data(); }
+    const float* getCurrent() const { return current.data(); }
+
+private:
+    double sampleRate = 44100.0;
+    double rampLengthSeconds = 0.01;
+    int rampLengthSamples = 441;
+    int remainingSamples = 0;
+    int activeCount = 0;
+
+    std::vector<float> current, target, step;
+    std::vector<float> rampStart, rampEnd;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <vector>
+
+#include "Mach1Transcode.h"
+
+/**
+ * Folding a Mach1Decode through a single-matrix transcode.
+ *
+ * When Mach1Transcode's conversion path is one matrix, the decode coefficients can be carried
+ * back through it to the input channels, so the input mixes straight to stereo and
+ * processConversion() never runs. The player, the offline bounce and the decode benchmark all
+ * go through these two functions, so they fold exactly the same way.
+ */
+namespace ConversionMatrix
+{
+    /**
+     * Copies the transcode's conversion matrix into matrix as [output * numInputChannels + input]
+     * and returns its output channel count. Returns 0 and leaves matrix alone when the conversion
+     * path is not a single matrix, or it has more than maxOutputChannels outputs.
+     */
+    inline int flatten(Mach1Transcode<float>& transcode, int numInputChannels, int maxOutputChannels,
+                       std::vector<float>& matrix)
+    {
+        const auto rows = transcode.getMatrixConversion();
+        const int numOutputChannels = transcode.getOutputNumChannels();
+        if (numOutputChannels <= 0 || numOutputChannels > maxOutputChannels || (int) rows.size() != numOutputChannels)
+            return 0;
+
+        matrix.assign((size_t) (numOutputChannels * numInputChannels), 0.0f);
+        for (int output = 0; output < numOutputChannels; ++output)
+        {
+            const auto& row = rows[(size_t) output];
+            for (int input = 0; input < juce::jmin((int) row.size(), numInputChannels); ++input)
+                matrix[(size_t) (output * numInputChannels + input)] = row[(size_t) input];
+        }
+        return numOutputChannels;
+    }
+
+    /**
+     * Carries stereo decode coefficients for the matrix outputs back to its inputs:
+     * folded[input * 2 + side] = sum over outputs of matrix[output][input] * decodeCoeffs[output * 2 + side].
+     * decodeCoeffs holds numOutputChannels pairs, folded receives numInputChannels pairs.
+     */
+    inline void foldDecodeCoeffs(const float* matrix, int numInputChannels, int numOutputChannels,
+                                 const float* decodeCoeffs, float* folded) noexcept
+    {
+        for (int input = 0; input < numInputChannels; ++input)
+        {
+            float left = 0.0f, right = 0.0f;
+            for (int output = 0; output < numOutputChannels; ++output)
+            {
+                const float gain = matrix[output * numInputChannels + input];
+                left += gain * decodeCoeffs[output * 2 + 0];
+                right += gain * decodeCoeffs[output * 2 + 1];
+            }
+            folded[input * 2 + 0] = left;
+            folded[input * 2 + 1] = right;
+        }
+    }
+}
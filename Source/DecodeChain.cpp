@@ -0,0 +1,333 @@
+#include "DecodeChain.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "ConversionMatrix.h"
+
+//==============================================================================
+bool DecodeChain::getDecodeMode(const std::string& format, Mach1DecodeMode& mode)
+{
+    if (format == "M1Spatial-4")
+        mode = M1DecodeSpatial_4;
+    else if (format == "M1Spatial-8")
+        mode = M1DecodeSpatial_8;
+    else if (format == "M1Spatial-14")
+        mode = M1DecodeSpatial_14;
+    else
+        return false;
+    return true;
+}
+
+Mach1DecodeMode DecodeChain::getDecodeModeForChannelCount(int formatChannelCount)
+{
+    return formatChannelCount == 4 ? M1DecodeSpatial_4 : formatChannelCount == 8 ? M1DecodeSpatial_8 : M1DecodeSpatial_14;
+}
+
+void DecodeChain::initialiseDecode(Mach1Decode<float>& decode)
+{
+    decode.setPlatformType(Mach1PlatformDefault);
+    decode.setFilterSpeed(0.99f);
+}
+
+std::shared_ptr<const DecodeCoeffTable> DecodeChain::createDecodeCoeffTable(int formatChannelCount)
+{
+    // unfiltered, so every grid point is the decode for exactly that orientation
+    Mach1Decode<float> decode;
+    decode.setPlatformType(Mach1PlatformDefault);
+    decode.setFilterSpeed(1.0f);
+    decode.setDecodeMode(getDecodeModeForChannelCount(formatChannelCount));
+    std::vector<float> coeffs(MAX_DECODE_CHANNELS * 2, 0.0f);
+
+    auto table = std::make_shared<DecodeCoeffTable>();
+    table->prepare(formatChannelCount * 2, [&](float yaw, float pitch, float roll, float* tableCoeffs) {
+        decode.setRotationDegrees({ yaw, pitch, roll });
+        decode.decodeCoeffs(coeffs.data());
+        std::copy(coeffs.begin(), coeffs.begin() + formatChannelCount * 2, tableCoeffs);
+    });
+    return table;
+}
+
+//==============================================================================
+bool DecodeChain::setTranscodeFormats(const std::string& inputFormat, const std::string& outputFormat)
+{
+    transcode.setInputFormat(transcode.getFormatFromString(inputFormat));
+    transcode.setOutputFormat(transcode.getFormatFromString(outputFormat));
+    return transcode.processConversionPath();
+}
+
+bool DecodeChain::storeConversionMatrix(int maxOutputChannels)
+{
+    // Only usable when the conversion path is a single matrix
+    const int out = ConversionMatrix::flatten(transcode, numInputChannels, maxOutputChannels, conversionMatrix);
+    if (out == 0)
+        return false;
+
+    conversionOutputChannels = out;
+    return true;
+}
+
+void DecodeChain::setMixChannelCount(int channelCount)
+{
+    mixChannelCount = channelCount;
+    mixToStereo = DecodeKernels::getMixToStereo(channelCount);
+}
+
+void DecodeChain::prepareAmbisonicDecode(int order)
+{
+    std::vector<float> decodeCoeffs(MAX_DECODE_CHANNELS * 2, 0.0f);
+    decode.setRotationDegrees({ 0.0f, 0.0f, 0.0f });
+    decode.decodeCoeffs(decodeCoeffs.data());
+    ambisonicDecodeCoeffs.assign((size_t) numInputChannels * 2, 0.0f);
+    foldDecodeCoeffs(decodeCoeffs.data(), ambisonicDecodeCoeffs.data());
+
+    ambisonicRotation.prepare(order);
+}
+
+void DecodeChain::prepareListener(Listener& listener, int index, bool decodes)
+{
+    listener.index = index;
+    if (decodes)
+    {
+        initialiseDecode(listener.decode);
+        listener.decode.setDecodeMode(getDecodeModeForChannelCount(decode.getFormatChannelCount()));
+    }
+    listener.decodeCoeffs.assign(MAX_DECODE_CHANNELS * 2, 0.0f);
+    listener.nextDecodeCoeffs.assign(MAX_DECODE_CHANNELS * 2, 0.0f);
+
+    // NaN forces the first fold / rotation
+    listener.foldedDecodeCoeffs.assign((size_t) numInputChannels * 2, 0.0f);
+    listener.lastFoldedDecodeCoeffs.assign(MAX_DECODE_CHANNELS * 2, std::numeric_limits<float>::quiet_NaN());
+    std::fill(std::begin(listener.lastAmbisonicOrientation), std::end(listener.lastAmbisonicOrientation),
+              std::numeric_limits<float>::quiet_NaN());
+
+    listener.decodeCoeffRamp.prepare(MAX_INPUT_CHANNELS * 2, sampleRate);
+    listener.scaledCoeffs.assign(MAX_INPUT_CHANNELS * 2, 0.0f);
+    if (hrtfFilters != nullptr)
+    {
+        listener.hrtfConvolver = std::make_unique<BinauralConvolver>();
+        listener.hrtfConvolver->prepare(MAX_DECODE_CHANNELS);
+    }
+}
+
+//==============================================================================
+void DecodeChain::foldDecodeCoeffs(const float* decodeCoeffs, float* folded) const noexcept
+{
+    ConversionMatrix::foldDecodeCoeffs(conversionMatrix.data(), numInputChannels, conversionOutputChannels,
+                                       decodeCoeffs, folded);
+}
+
+void DecodeChain::updateDecodeCoeffs(Listener& listener, Orientation orientation) const noexcept
+{
+    // keep the coeffs while the listener holds still
+    float* last = listener.lastDecodeOrientation;
+    const bool moved = orientation.yaw != last[0] || orientation.pitch != last[1] || orientation.roll != last[2];
+    if (!moved && listener.decodeCoeffsSettled)
+        return;
+
+    last[0] = orientation.yaw;
+    last[1] = orientation.pitch;
+    last[2] = orientation.roll;
+
+    if (decodeCoeffTable != nullptr)
+    {
+        decodeCoeffTable->lookup(orientation.yaw, orientation.pitch, orientation.roll, listener.decodeCoeffs.data());
+        listener.decodeCoeffsSettled = true;
+        return;
+    }
+
+    // Mach1Decode filters the orientation, so its coeffs can keep moving for a few calls after
+    // the listener stops. They count as settled once a call hands back the same coeffs again.
+    const int coeffCount = listener.decode.getFormatChannelCount() * 2;
+    auto& next = listener.nextDecodeCoeffs;
+    listener.decode.setRotationDegrees({ orientation.yaw, orientation.pitch, orientation.roll });
+    listener.decode.decodeCoeffs(next.data()); // fills the preallocated coeffs in place
+    listener.decodeCoeffsSettled = !moved && std::equal(next.begin(), next.begin() + coeffCount, listener.decodeCoeffs.begin());
+    std::copy(next.begin(), next.begin() + coeffCount, listener.decodeCoeffs.begin());
+}
+
+void DecodeChain::mixWithSmoothedCoeffs(Listener& listener, const float* const* source, int channelCount,
+                                        const float* coeffs, const Output& output) const noexcept
+{
+    const int sampleCount = output.numSamples;
+    float* outL = output.left;
+    float* outR = output.right;
+
+    // Advance the coeffs once per block: the part of the block still ramping towards the new
+    // coeffs gets a linear gain ramp, the remainder uses the settled coeffs
+    auto& ramp = listener.decodeCoeffRamp;
+    const int coeffCount = channelCount * 2;
+    juce::FloatVectorOperations::multiply(listener.scaledCoeffs.data(), coeffs, output.gain, coeffCount);
+    if (output.startSettled)
+        ramp.setCurrentAndTargets(listener.scaledCoeffs.data(), coeffCount);
+    else
+        ramp.setTargets(listener.scaledCoeffs.data(), coeffCount);
+    const int rampSamples = ramp.advance(sampleCount);
+
+    const int tasks = parallelTasks;
+    if (tasks > 1 && channelCount >= PARALLEL_MIN_CHANNELS && output.workers != nullptr && output.partialSums != nullptr)
+    {
+        // each task mixes a contiguous group of inputs, the partial sums are added afterwards
+        auto mixGroup = [&](int task) {
+            const int begin = channelCount * task / tasks;
+            const int end = channelCount * (task + 1) / tasks;
+            float* groupL = outL;
+            float* groupR = outR;
+            if (task > 0)
+            {
+                groupL = output.partialSums->getWritePointer(task * 2);
+                juce::FloatVectorOperations::clear(groupL, sampleCount);
+                if (groupR != nullptr)
+                {
+                    groupR = output.partialSums->getWritePointer(task * 2 + 1);
+                    juce::FloatVectorOperations::clear(groupR, sampleCount);
+                }
+            }
+            const float* const* inputs = source + begin;
+            DecodeKernels::mixToStereo(inputs, end - begin, ramp.getRampStart() + begin * 2, ramp.getRampEnd() + begin * 2,
+                                       groupL, groupR, 0, rampSamples);
+            DecodeKernels::mixToStereo(inputs, end - begin, ramp.getCurrent() + begin * 2, ramp.getCurrent() + begin * 2,
+                                       groupL, groupR, rampSamples, sampleCount - rampSamples);
+        };
+        output.workers->run(tasks, mixGroup);
+
+        for (int task = 1; task < tasks; ++task)
+        {
+            juce::FloatVectorOperations::add(outL, output.partialSums->getReadPointer(task * 2), sampleCount);
+            if (outR != nullptr)
+                juce::FloatVectorOperations::add(outR, output.partialSums->getReadPointer(task * 2 + 1), sampleCount);
+        }
+        return;
+    }
+
+    // kernel picked when the chain was set up, unless this block mixes some other channel count;
+    // every input channel is read once per segment
+    const auto mix = channelCount == mixChannelCount ? mixToStereo : &DecodeKernels::mixToStereo;
+    mix(source, channelCount, ramp.getRampStart(), ramp.getRampEnd(), outL, outR, 0, rampSamples);
+    mix(source, channelCount, ramp.getCurrent(), ramp.getCurrent(), outL, outR, rampSamples, sampleCount - rampSamples);
+}
+
+void DecodeChain::decodeToStereo(Listener& listener, const float* const* source, int channelCount,
+                                 Orientation orientation, const Output& output) const noexcept
+{
+    updateDecodeCoeffs(listener, orientation);
+    mixWithSmoothedCoeffs(listener, source, channelCount, listener.decodeCoeffs.data(), output);
+}
+
+void DecodeChain::convolveToStereo(Listener& listener, const float* const* source, int channelCount,
+                                   Orientation orientation, const Output& output) const noexcept
+{
+    updateDecodeCoeffs(listener, orientation);
+
+    // same smoothed L/R gains as the amplitude decode, applied before each speaker's filter pair
+    auto& ramp = listener.decodeCoeffRamp;
+    const int coeffCount = channelCount * 2;
+    juce::FloatVectorOperations::multiply(listener.scaledCoeffs.data(), listener.decodeCoeffs.data(), output.gain, coeffCount);
+    if (output.startSettled)
+        ramp.setCurrentAndTargets(listener.scaledCoeffs.data(), coeffCount);
+    else
+        ramp.setTargets(listener.scaledCoeffs.data(), coeffCount);
+    const int rampSamples = ramp.advance(output.numSamples);
+    listener.hrtfConvolver->process(*hrtfFilters, source, channelCount, ramp, rampSamples,
+                                    output.left, output.right, output.numSamples);
+}
+
+void DecodeChain::fusedTranscodeDecode(Listener& listener, const float* const* input, Orientation orientation,
+                                       const Output& output) const noexcept
+{
+    const int coeffCount = conversionOutputChannels * 2;
+
+    updateDecodeCoeffs(listener, orientation);
+
+    // Transcode and decode are both linear, so fold the decode coeffs through the conversion
+    // matrix and mix the input straight to stereo. Only redone when the decode coeffs change.
+    const auto& decodeCoeffs = listener.decodeCoeffs;
+    if (!std::equal(decodeCoeffs.begin(), decodeCoeffs.begin() + coeffCount, listener.lastFoldedDecodeCoeffs.begin()))
+    {
+        std::copy(decodeCoeffs.begin(), decodeCoeffs.begin() + coeffCount, listener.lastFoldedDecodeCoeffs.begin());
+        foldDecodeCoeffs(decodeCoeffs.data(), listener.foldedDecodeCoeffs.data());
+    }
+
+    mixWithSmoothedCoeffs(listener, input, numInputChannels, listener.foldedDecodeCoeffs.data(), output);
+}
+
+void DecodeChain::ambisonicRotationDecode(Listener& listener, const float* const* input, Orientation orientation,
+                                          const Output& output) noexcept
+{
+    // Rotate the sound field exactly in the SH domain, rather than after the transcode has
+    // reprojected it onto the M1Spatial speakers. The rotation is folded into the fixed
+    // per-channel decode, so it is only redone when the orientation changes.
+    float* last = listener.lastAmbisonicOrientation;
+    if (orientation.yaw != last[0] || orientation.pitch != last[1] || orientation.roll != last[2])
+    {
+        last[0] = orientation.yaw;
+        last[1] = orientation.pitch;
+        last[2] = orientation.roll;
+        ambisonicRotation.setOrientation(orientation.yaw, orientation.pitch, orientation.roll);
+        ambisonicRotation.rotateDecodeWeights(ambisonicDecodeCoeffs.data(), listener.foldedDecodeCoeffs.data());
+    }
+
+    mixWithSmoothedCoeffs(listener, input, numInputChannels, listener.foldedDecodeCoeffs.data(), output);
+}
+
+//==============================================================================
+bool DecodeChain::transcodeBlock(const float* const* input, float* const* outputs, int numOutputs, int numSamples,
+                                 RealtimeWorkerPool* workers)
+{
+    // the conversion is a single matrix, share its output channels out between the workers
+    if (parallelTasks > 1 && conversionOutputChannels == numOutputs)
+    {
+        applyConversionMatrix(input, outputs, numOutputs, numSamples, workers);
+        return true;
+    }
+
+    try
+    {
+        // the input won't be written to, Mach1Transcode just expects non-const float**
+        transcode.processConversion(const_cast<float**>(input), const_cast<float**>(outputs), numSamples);
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+    return true;
+}
+
+void DecodeChain::applyConversionMatrix(const float* const* input, float* const* outputs, int numOutputs, int numSamples,
+                                        RealtimeWorkerPool* workers, float startGain, float endGain, int rampSamples) const noexcept
+{
+    const int in = numInputChannels;
+    const int groups = juce::jmax(1, juce::jmin(parallelTasks, numOutputs));
+    const float gainStep = rampSamples > 0 ? (endGain - startGain) / (float) rampSamples : 0.0f;
+
+    // each group writes its own output channels, so no partial sums are needed. The overall
+    // gain ramps over the first rampSamples and holds at endGain for the rest of the block.
+    auto convertGroup = [&](int group) {
+        for (int output = numOutputs * group / groups; output < numOutputs * (group + 1) / groups; ++output)
+        {
+            float* dest = outputs[output];
+            juce::FloatVectorOperations::clear(dest, numSamples);
+            for (int inputChannel = 0; inputChannel < in; ++inputChannel)
+            {
+                const float gain = conversionMatrix[(size_t) (output * in + inputChannel)];
+                if (gain != 0.0f)
+                {
+                    const float* src = input[inputChannel];
+                    if (rampSamples > 0)
+                        DecodeKernels::accumulateRamp(src, dest, gain * startGain, gain * gainStep, rampSamples);
+                    DecodeKernels::accumulateRamp(src + rampSamples, dest + rampSamples, gain * endGain, 0.0f, numSamples - rampSamples);
+                }
+            }
+        }
+    };
+
+    if (groups > 1 && in >= PARALLEL_MIN_CHANNELS && workers != nullptr)
+    {
+        workers->run(groups, convertGroup);
+    }
+    else
+    {
+        for (int group = 0; group < groups; ++group)
+            convertGroup(group);
+    }
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Mach1Decode.h"
+#include "Mach1Transcode.h"
+
+#include "AmbisonicRotation.h"
+#include "BinauralConvolver.h"
+#include "CoeffRamp.h"
+#include "DecodeCoeffTable.h"
+#include "DecodeKernels.h"
+#include "RealtimeWorkerPool.h"
+
+/**
+ * The transcode and stereo decode of one input configuration, without an audio device.
+ *
+ * Holds what the decode strategies read on every block (the transcode and its conversion
+ * matrix, the mix kernel, the SH rotation, the coeff table, the HRTF filters) and runs their
+ * bodies for one listener into one pair of output channels. MainComponent's AudioDecodeConfig
+ * adds the device side on top; the offline bounce and the decode benchmark use it directly, so
+ * what they render and measure is the code the player runs.
+ */
+class DecodeChain
+{
+public:
+    // Largest Mach1Decode format (M1Spatial-14) used to size the decode coeffs
+    static constexpr int MAX_DECODE_CHANNELS = 14;
+    // Largest supported input (ACNSN3DO6A) used to size the mixed coeffs
+    static constexpr int MAX_INPUT_CHANNELS = 64;
+    // Fewer inputs than this are always mixed and transcoded on the calling thread
+    static constexpr int PARALLEL_MIN_CHANNELS = 16;
+
+    static constexpr float MONO_COEFFS[] = { 0.707945784f, 0.707945784f }; // -3dB pan-law gain on both sides
+    static constexpr float STEREO_COEFFS[] = { 1.0f, 0.0f, 0.0f, 1.0f };    // passthrough as a fixed L/R mix
+
+    // Mach1Decode mode of a Mach1Spatial format name, false for any other format
+    static bool getDecodeMode(const std::string& format, Mach1DecodeMode& mode);
+
+    // Mode of the Mach1Spatial format with formatChannelCount channels, M1Spatial-14 unless 4 or 8
+    static Mach1DecodeMode getDecodeModeForChannelCount(int formatChannelCount);
+
+    // Platform and orientation filter every decode of the player runs with
+    static void initialiseDecode(Mach1Decode<float>& decode);
+
+    // Unfiltered Mach1Decode coeffs over the DecodeCoeffTable grid; not for the audio thread
+    static std::shared_ptr<const DecodeCoeffTable> createDecodeCoeffTable(int formatChannelCount);
+
+    struct Orientation
+    {
+        float yaw = 0.0f, pitch = 0.0f, roll = 0.0f; // degrees, as passed to Mach1Decode::setRotationDegrees
+    };
+
+    // Everything that depends on the orientation, once per listener. The transcode runs once
+    // per block, then the decode strategy once per listener into its output pair.
+    struct Listener
+    {
+        int index = 0; // output pair and orientation source of the player's listeners
+        Mach1Decode<float> decode;
+
+        // M1Spatial L/R decode gains for the orientation, kept by updateDecodeCoeffs() while
+        // it holds still. Interpolated from decodeCoeffTable when it is set.
+        std::vector<float> decodeCoeffs;
+        std::vector<float> nextDecodeCoeffs; // Mach1Decode output, compared with decodeCoeffs
+        float lastDecodeOrientation[3] = {};
+        bool decodeCoeffsSettled = false;
+
+        std::vector<float> foldedDecodeCoeffs;     // per input channel L/R gains
+        std::vector<float> lastFoldedDecodeCoeffs; // decode coeffs the fold was computed from
+        float lastAmbisonicOrientation[3] = {};    // yaw, pitch, roll the folded coeffs were rotated to
+
+        CoeffRamp decodeCoeffRamp;       // per-block gain ramps fed to DecodeKernels::mixToStereo
+        std::vector<float> scaledCoeffs; // the coeffs with the volume folded in, the ramp targets
+        std::unique_ptr<BinauralConvolver> hrtfConvolver;
+    };
+
+    // Where and how one listener's block is rendered
+    struct Output
+    {
+        float* left = nullptr;
+        float* right = nullptr; // nullptr on a mono device
+        int numSamples = 0;
+
+        // The media volume is folded into the decode coeffs before they are ramped, so it costs
+        // no pass of its own and glides with the decode ramps
+        float gain = 1.0f;
+        bool startSettled = false; // jump to the coeffs instead of ramping, e.g. at a fade-in
+
+        // Shares the mix of parallelTasks > 1 input groups out; the groups after the first
+        // write their partial sums to channels 2 * task and 2 * task + 1 of partialSums
+        RealtimeWorkerPool* workers = nullptr;
+        juce::AudioBuffer<float>* partialSums = nullptr;
+    };
+
+    //==============================================================================
+    // Setup, not for the audio thread
+
+    // Sets the conversion and searches its path, false when there is none
+    bool setTranscodeFormats(const std::string& inputFormat, const std::string& outputFormat);
+
+    // Keeps the conversion matrix when the path is a single matrix with at most maxOutputChannels
+    bool storeConversionMatrix(int maxOutputChannels);
+
+    // Picks the stereo mix kernel once, rather than branching on the channel count per block
+    void setMixChannelCount(int channelCount);
+
+    // The fixed decode ambisonicRotationDecode() rotates: Mach1Decode facing front folded
+    // through the conversion matrix, which is what fusedTranscodeDecode() mixes with then
+    void prepareAmbisonicDecode(int order);
+
+    // Sizes a listener's state for this chain; decodes is false for mono, stereo and speaker layouts
+    void prepareListener(Listener& listener, int index, bool decodes);
+
+    //==============================================================================
+    // Audio thread
+
+    // The decode coeffs carried back through the conversion matrix, see ConversionMatrix
+    void foldDecodeCoeffs(const float* decodeCoeffs, float* folded) const noexcept;
+
+    // Coeffs for the orientation into listener.decodeCoeffs, skipped while the listener holds still
+    void updateDecodeCoeffs(Listener& listener, Orientation orientation) const noexcept;
+
+    // Ramps the listener's mix gains towards coeffs * gain and mixes channelCount source channels
+    void mixWithSmoothedCoeffs(Listener& listener, const float* const* source, int channelCount,
+                               const float* coeffs, const Output& output) const noexcept;
+
+    // Mach1Spatial speaker feeds amplitude panned to stereo
+    void decodeToStereo(Listener& listener, const float* const* source, int channelCount,
+                        Orientation orientation, const Output& output) const noexcept;
+
+    // Mach1Spatial speaker feeds through the listener's HRTF convolver
+    void convolveToStereo(Listener& listener, const float* const* source, int channelCount,
+                          Orientation orientation, const Output& output) const noexcept;
+
+    // The input mixed straight to stereo with the decode folded through the conversion matrix
+    void fusedTranscodeDecode(Listener& listener, const float* const* input, Orientation orientation,
+                              const Output& output) const noexcept;
+
+    // Full-order ambisonic input rotated in the SH domain ahead of the fixed folded decode
+    void ambisonicRotationDecode(Listener& listener, const float* const* input, Orientation orientation,
+                                 const Output& output) noexcept;
+
+    // Converts the input to numOutputs channels, with the matrix split over the workers when
+    // the path is a single matrix and parallelTasks > 1. False if Mach1Transcode threw.
+    bool transcodeBlock(const float* const* input, float* const* outputs, int numOutputs, int numSamples,
+                        RealtimeWorkerPool* workers);
+
+    // outputs = conversionMatrix * input, with the overall gain ramping from startGain to endGain
+    // over the first rampSamples; output channel groups are shared out between the workers
+    void applyConversionMatrix(const float* const* input, float* const* outputs, int numOutputs, int numSamples,
+                               RealtimeWorkerPool* workers, float startGain = 1.0f, float endGain = 1.0f,
+                               int rampSamples = 0) const noexcept;
+
+    //==============================================================================
+    int numInputChannels = 0;
+    double sampleRate = 0.0; // the ramps are prepared for it
+
+    Mach1Transcode<float> transcode;
+    Mach1Decode<float> decode; // decode mode and listener facing front, the listeners decode for their orientation
+
+    // Stereo mix kernel for mixChannelCount channels, unrolled when it is a common count
+    // (DecodeKernels::getMixToStereo)
+    DecodeKernels::MixToStereoFunction mixToStereo = &DecodeKernels::mixToStereo;
+    int mixChannelCount = 0;
+
+    // Transcode conversion matrix ([output * numInputChannels + input]) used by
+    // fusedTranscodeDecode() to fold the decode coeffs back onto the input channels
+    std::vector<float> conversionMatrix;
+    int conversionOutputChannels = 0;
+
+    // More than 1 splits the matrix transcode / input mix across the Output's workers
+    int parallelTasks = 0;
+
+    // Filter set for convolveToStereo(), kept alive by the chain that uses it
+    std::shared_ptr<const BinauralConvolver::Filters> hrtfFilters;
+
+    // Full-order ambisonic input rotated in the SH domain by ambisonicRotationDecode()
+    AmbisonicRotation ambisonicRotation;
+    std::vector<float> ambisonicDecodeCoeffs; // per ACN channel L/R gains, listener facing front
+
+    std::shared_ptr<const DecodeCoeffTable> decodeCoeffTable;
+};
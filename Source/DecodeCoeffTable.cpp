@@ -0,0 +1,86 @@
+#include "DecodeCoeffTable.h"
+
+#include <cmath>
+
+namespace
+{
+    // Grid cell of an angle on a wrapping axis: the two grid points around it and the
+    // position between them
+    struct AxisCell
+    {
+        int lower = 0, upper = 0;
+        float fraction = 0.0f;
+    };
+
+    AxisCell locate(float degrees, int pointsPerAxis, float stepDegrees) noexcept
+    {
+        float position = degrees / stepDegrees;
+        position -= std::floor(position / (float) pointsPerAxis) * (float) pointsPerAxis;
+
+        AxisCell cell;
+        cell.lower = juce::jlimit(0, pointsPerAxis - 1, (int) position);
+        cell.upper = cell.lower + 1 < pointsPerAxis ? cell.lower + 1 : 0;
+        cell.fraction = juce::jlimit(0.0f, 1.0f, position - (float) cell.lower);
+        return cell;
+    }
+}
+
+//==============================================================================
+void DecodeCoeffTable::prepare(int newNumCoeffs, const ComputeFunction& compute)
+{
+    numCoeffs = newNumCoeffs;
+    table.assign((size_t) POINTS_PER_AXIS * POINTS_PER_AXIS * POINTS_PER_AXIS * (size_t) numCoeffs, 0.0f);
+
+    float* point = table.data();
+    for (int yaw = 0; yaw < POINTS_PER_AXIS; ++yaw)
+    {
+        for (int pitch = 0; pitch < POINTS_PER_AXIS; ++pitch)
+        {
+            for (int roll = 0; roll < POINTS_PER_AXIS; ++roll)
+            {
+                // pitch and roll are sampled over -180..180 so the grid is centred on level
+                compute((float) yaw * STEP_DEGREES,
+                        (float) (pitch < POINTS_PER_AXIS / 2 ? pitch : pitch - POINTS_PER_AXIS) * STEP_DEGREES,
+                        (float) (roll < POINTS_PER_AXIS / 2 ? roll : roll - POINTS_PER_AXIS) * STEP_DEGREES,
+                        point);
+                point += numCoeffs;
+            }
+        }
+    }
+}
+
+void DecodeCoeffTable::lookup(float yawDegrees, float pitchDegrees, float rollDegrees, float* coeffs) const noexcept
+{
+    if (table.empty())
+        return;
+
+    const auto yaw = locate(yawDegrees, POINTS_PER_AXIS, STEP_DEGREES);
+    const auto pitch = locate(pitchDegrees, POINTS_PER_AXIS, STEP_DEGREES);
+    const auto roll = locate(rollDegrees, POINTS_PER_AXIS, STEP_DEGREES);
+
+    auto getPoint = [this] (int y, int p, int r)
+    {
+        return table.data() + ((size_t) (y * POINTS_PER_AXIS + p) * POINTS_PER_AXIS + (size_t) r) * (size_t) numCoeffs;
+    };
+
+    const int yaws[2] = { yaw.lower, yaw.upper };
+    const int pitches[2] = { pitch.lower, pitch.upper };
+    const int rolls[2] = { roll.lower, roll.upper };
+    const float yawWeights[2] = { 1.0f - yaw.fraction, yaw.fraction };
+    const float pitchWeights[2] = { 1.0f - pitch.fraction, pitch.fraction };
+    const float rollWeights[2] = { 1.0f - roll.fraction, roll.fraction };
+
+    juce::FloatVectorOperations::clear(coeffs, numCoeffs);
+    for (int y = 0; y < 2; ++y)
+    {
+        for (int p = 0; p < 2; ++p)
+        {
+            for (int r = 0; r < 2; ++r)
+            {
+                const float weight = yawWeights[y] * pitchWeights[p] * rollWeights[r];
+                if (weight != 0.0f)
+                    juce::FloatVectorOperations::addWithMultiply(coeffs, getPoint(yaws[y], pitches[p], rolls[r]), weight, numCoeffs);
+            }
+        }
+    }
+}
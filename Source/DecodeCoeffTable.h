@@ -0,0 +1,41 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <functional>
+#include <vector>
+
+/**
+ * Decode coefficients precomputed over a yaw/pitch/roll grid, looked up by trilinear
+ * interpolation between the eight grid points around an orientation.
+ *
+ * A lookup is eight scaled vector adds of the coefficient count, so it costs the same for any
+ * decode mode and orientation, and never calls into the decoder on the audio thread. Each axis
+ * is sampled over a full turn and wraps, so any angle the orientation sources produce is
+ * covered. The gains are smooth in the angles, so at STEP_DEGREES the interpolation error stays
+ * well below the level the decode gain ramps smooth over anyway.
+ */
+class DecodeCoeffTable
+{
+public:
+    static constexpr float STEP_DEGREES = 10.0f;
+
+    // Writes the numCoeffs coefficients for one orientation in degrees
+    using ComputeFunction = std::function<void(float yaw, float pitch, float roll, float* coeffs)>;
+
+    //==============================================================================
+    // Evaluates compute at every grid point; not for the audio thread
+    void prepare(int newNumCoeffs, const ComputeFunction& compute);
+
+    int getNumCoeffs() const noexcept { return numCoeffs; }
+    size_t getSizeInBytes() const noexcept { return table.size() * sizeof(float); }
+
+    // Interpolated coefficients for an orientation in degrees, any range
+    void lookup(float yawDegrees, float pitchDegrees, float rollDegrees, float* coeffs) const noexcept;
+
+private:
+    static constexpr int POINTS_PER_AXIS = (int) (360.0f / STEP_DEGREES);
+
+    int numCoeffs = 0;
+    std::vector<float> table; // [((yaw * POINTS_PER_AXIS + pitch) * POINTS_PER_AXIS + roll) * numCoeffs + coeff]
+};
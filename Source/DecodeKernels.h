@@ -0,0 +1,395 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <utility>
+
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <immintrin.h>
+ #define M1_DECODE_KERNEL_X86 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+ #include <arm_neon.h>
+ #define M1_DECODE_KERNEL_NEON 1
+#endif
+
+/**
+ * Channel-major mixing kernels used by the decode strategies.
+ *
+ * Each input channel is read exactly once and accumulated into the stereo output with a gain
+ * that ramps linearly from its start to its end value across the block. Gains are stored
+ * interleaved per input channel ([channel * 2 + 0] = left, [channel * 2 + 1] = right), which
+ * is the layout Mach1Decode::decodeCoeffs() produces.
+ *
+ * The vector path is picked at compile time: AVX when the build enables it, SSE2 on any other
+ * x86-64 target, NEON on arm64 and a plain scalar loop everywhere else.
+ *
+ * mixToStereo() takes any channel count and makes one pass over the outputs per input channel.
+ * mixToStereoFixed<N>() is unrolled for a channel count known at compile time and sums groups
+ * of MIX_GROUP_CHANNELS inputs in registers, so the outputs are only loaded and stored once per
+ * group. getMixToStereo() picks one of the two for a channel count, once per configuration.
+ */
+namespace DecodeKernels
+{
+    // out[i] += in[i] * (gain + i * step)
+    inline void accumulateRamp(const float* in, float* out, float gain, float step, int numSamples) noexcept
+    {
+        int i = 0;
+
+       #if M1_DECODE_KERNEL_X86 && defined(__AVX__)
+        {
+            __m256 g = _mm256_add_ps(_mm256_set1_ps(gain),
+                                     _mm256_mul_ps(_mm256_set1_ps(step), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)));
+            const __m256 gStep = _mm256_set1_ps(step * 8.0f);
+            for (; i + 8 <= numSamples; i += 8)
+            {
+                const __m256 x = _mm256_loadu_ps(in + i);
+                const __m256 y = _mm256_loadu_ps(out + i);
+               #if defined(__FMA__)
+                _mm256_storeu_ps(out + i, _mm256_fmadd_ps(x, g, y));
+               #else
+                _mm256_storeu_ps(out + i, _mm256_add_ps(y, _mm256_mul_ps(x, g)));
+               #endif
+                g = _mm256_add_ps(g, gStep);
+            }
+        }
+       #elif M1_DECODE_KERNEL_X86
+        {
+            __m128 g = _mm_add_ps(_mm_set1_ps(gain), _mm_mul_ps(_mm_set1_ps(step), _mm_setr_ps(0, 1, 2, 3)));
+            const __m128 gStep = _mm_set1_ps(step * 4.0f);
+            for (; i + 4 <= numSamples; i += 4)
+            {
+                const __m128 x = _mm_loadu_ps(in + i);
+                const __m128 y = _mm_loadu_ps(out + i);
+                _mm_storeu_ps(out + i, _mm_add_ps(y, _mm_mul_ps(x, g)));
+                g = _mm_add_ps(g, gStep);
+            }
+        }
+       #elif M1_DECODE_KERNEL_NEON
+        {
+            const float lanes[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+            float32x4_t g = vmlaq_n_f32(vdupq_n_f32(gain), vld1q_f32(lanes), step);
+            const float32x4_t gStep = vdupq_n_f32(step * 4.0f);
+            for (; i + 4 <= numSamples; i += 4)
+            {
+                const float32x4_t x = vld1q_f32(in + i);
+                const float32x4_t y = vld1q_f32(out + i);
+                vst1q_f32(out + i, vmlaq_f32(y, x, g));
+                g = vaddq_f32(g, gStep);
+            }
+        }
+       #endif
+
+        // scalar tail (or the whole block without SIMD)
+        for (; i < numSamples; ++i)
+            out[i] += in[i] * (gain + (float) i * step);
+    }
+
+    // Reads each channel once and writes it into both outputs with independent ramps
+    inline void accumulateRampStereo(const float* in, float* outL, float* outR,
+                                     float gainL, float stepL, float gainR, float stepR, int numSamples) noexcept
+    {
+        int i = 0;
+
+       #if M1_DECODE_KERNEL_X86 && defined(__AVX__)
+        {
+            const __m256 lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+            __m256 gl = _mm256_add_ps(_mm256_set1_ps(gainL), _mm256_mul_ps(_mm256_set1_ps(stepL), lanes));
+            __m256 gr = _mm256_add_ps(_mm256_set1_ps(gainR), _mm256_mul_ps(_mm256_set1_ps(stepR), lanes));
+            const __m256 glStep = _mm256_set1_ps(stepL * 8.0f);
+            const __m256 grStep = _mm256_set1_ps(stepR * 8.0f);
+            for (; i + 8 <= numSamples; i += 8)
+            {
+                const __m256 x = _mm256_loadu_ps(in + i);
+               #if defined(__FMA__)
+                _mm256_storeu_ps(outL + i, _mm256_fmadd_ps(x, gl, _mm256_loadu_ps(outL + i)));
+                _mm256_storeu_ps(outR + i, _mm256_fmadd_ps(x, gr, _mm256_loadu_ps(outR + i)));
+               #else
+                _mm256_storeu_ps(outL + i, _mm256_add_ps(_mm256_loadu_ps(outL + i), _mm256_mul_ps(x, gl)));
+                _mm256_storeu_ps(outR + i, _mm256_add_ps(_mm256_loadu_ps(outR + i), _mm256_mul_ps(x, gr)));
+               #endif
+                gl = _mm256_add_ps(gl, glStep);
+                gr = _mm256_add_ps(gr, grStep);
+            }
+        }
+       #elif M1_DECODE_KERNEL_X86
+        {
+            const __m128 lanes = _mm_setr_ps(0, 1, 2, 3);
+            __m128 gl = _mm_add_ps(_mm_set1_ps(gainL), _mm_mul_ps(_mm_set1_ps(stepL), lanes));
+            __m128 gr = _mm_add_ps(_mm_set1_ps(gainR), _mm_mul_ps(_mm_set1_ps(stepR), lanes));
+            const __m128 glStep = _mm_set1_ps(stepL * 4.0f);
+            const __m128 grStep = _mm_set1_ps(stepR * 4.0f);
+            for (; i + 4 <= numSamples; i += 4)
+            {
+                const __m128 x = _mm_loadu_ps(in + i);
+                _mm_storeu_ps(outL + i, _mm_add_ps(_mm_loadu_ps(outL + i), _mm_mul_ps(x, gl)));
+                _mm_storeu_ps(outR + i, _mm_add_ps(_mm_loadu_ps(outR + i), _mm_mul_ps(x, gr)));
+                gl = _mm_add_ps(gl, glStep);
+                gr = _mm_add_ps(gr, grStep);
+            }
+        }
+       #elif M1_DECODE_KERNEL_NEON
+        {
+            const float laneValues[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+            const float32x4_t lanes = vld1q_f32(laneValues);
+            float32x4_t gl = vmlaq_n_f32(vdupq_n_f32(gainL), lanes, stepL);
+            float32x4_t gr = vmlaq_n_f32(vdupq_n_f32(gainR), lanes, stepR);
+            const float32x4_t glStep = vdupq_n_f32(stepL * 4.0f);
+            const float32x4_t grStep = vdupq_n_f32(stepR * 4.0f);
+            for (; i + 4 <= numSamples; i += 4)
+            {
+                const float32x4_t x = vld1q_f32(in + i);
+                vst1q_f32(outL + i, vmlaq_f32(vld1q_f32(outL + i), x, gl));
+                vst1q_f32(outR + i, vmlaq_f32(vld1q_f32(outR + i), x, gr));
+                gl = vaddq_f32(gl, glStep);
+                gr = vaddq_f32(gr, grStep);
+            }
+        }
+       #endif
+
+        for (; i < numSamples; ++i)
+        {
+            const float x = in[i];
+            outL[i] += x * (gainL + (float) i * stepL);
+            outR[i] += x * (gainR + (float) i * stepR);
+        }
+    }
+
+    /**
+     * Mixes numChannels inputs down to stereo, ramping every gain from startGains to endGains
+     * across numSamples, starting startSample samples into the inputs and outputs. outR may be
+     * null for a mono output device, in which case only the left gains are applied.
+     */
+    inline void mixToStereo(const float* const* inputs, int numChannels,
+                            const float* startGains, const float* endGains,
+                            float* outL, float* outR, int startSample, int numSamples) noexcept
+    {
+        if (numSamples <= 0)
+            return;
+
+        const float invSamples = 1.0f / (float) numSamples;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const float* in = inputs[channel] + startSample;
+            const float gainL = startGains[channel * 2 + 0];
+            const float gainR = startGains[channel * 2 + 1];
+            const float stepL = (endGains[channel * 2 + 0] - gainL) * invSamples;
+            const float stepR = (endGains[channel * 2 + 1] - gainR) * invSamples;
+
+            if (outR != nullptr)
+                accumulateRampStereo(in, outL + startSample, outR + startSample, gainL, stepL, gainR, stepR, numSamples);
+            else
+                accumulateRamp(in, outL + startSample, gainL, stepL, numSamples);
+        }
+    }
+
+    //==============================================================================
+    // Inputs summed in registers per pass of the fixed channel count kernels
+    constexpr int MIX_GROUP_CHANNELS = 4;
+
+    namespace detail
+    {
+        // One SIMD register of floats for the fixed channel count kernels
+       #if M1_DECODE_KERNEL_X86 && defined(__AVX__)
+        struct Vector
+        {
+            static constexpr int size = 8;
+            __m256 v;
+
+            static Vector load(const float* p) noexcept { return { _mm256_loadu_ps(p) }; }
+            static Vector broadcast(float x) noexcept { return { _mm256_set1_ps(x) }; }
+            static Vector ramp(float start, float step) noexcept
+            {
+                return { _mm256_add_ps(_mm256_set1_ps(start), _mm256_mul_ps(_mm256_set1_ps(step), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7))) };
+            }
+            void store(float* p) const noexcept { _mm256_storeu_ps(p, v); }
+            Vector operator+ (Vector other) const noexcept { return { _mm256_add_ps(v, other.v) }; }
+            Vector multiplyAdd(Vector a, Vector b) const noexcept // this + a * b
+            {
+               #if defined(__FMA__)
+                return { _mm256_fmadd_ps(a.v, b.v, v) };
+               #else
+                return { _mm256_add_ps(v, _mm256_mul_ps(a.v, b.v)) };
+               #endif
+            }
+        };
+       #elif M1_DECODE_KERNEL_X86
+        struct Vector
+        {
+            static constexpr int size = 4;
+            __m128 v;
+
+            static Vector load(const float* p) noexcept { return { _mm_loadu_ps(p) }; }
+            static Vector broadcast(float x) noexcept { return { _mm_set1_ps(x) }; }
+            static Vector ramp(float start, float step) noexcept
+            {
+                return { _mm_add_ps(_mm_set1_ps(start), _mm_mul_ps(_mm_set1_ps(step), _mm_setr_ps(0, 1, 2, 3))) };
+            }
+            void store(float* p) const noexcept { _mm_storeu_ps(p, v); }
+            Vector operator+ (Vector other) const noexcept { return { _mm_add_ps(v, other.v) }; }
+            Vector multiplyAdd(Vector a, Vector b) const noexcept { return { _mm_add_ps(v, _mm_mul_ps(a.v, b.v)) }; }
+        };
+       #elif M1_DECODE_KERNEL_NEON
+        struct Vector
+        {
+            static constexpr int size = 4;
+            float32x4_t v;
+
+            static Vector load(const float* p) noexcept { return { vld1q_f32(p) }; }
+            static Vector broadcast(float x) noexcept { return { vdupq_n_f32(x) }; }
+            static Vector ramp(float start, float step) noexcept
+            {
+                const float lanes[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+                return { vmlaq_n_f32(vdupq_n_f32(start), vld1q_f32(lanes), step) };
+            }
+            void store(float* p) const noexcept { vst1q_f32(p, v); }
+            Vector operator+ (Vector other) const noexcept { return { vaddq_f32(v, other.v) }; }
+            Vector multiplyAdd(Vector a, Vector b) const noexcept { return { vmlaq_f32(v, a.v, b.v) }; }
+        };
+       #else
+        struct Vector
+        {
+            static constexpr int size = 1;
+            float v;
+
+            static Vector load(const float* p) noexcept { return { *p }; }
+            static Vector broadcast(float x) noexcept { return { x }; }
+            static Vector ramp(float start, float) noexcept { return { start }; }
+            void store(float* p) const noexcept { *p = v; }
+            Vector operator+ (Vector other) const noexcept { return { v + other.v }; }
+            Vector multiplyAdd(Vector a, Vector b) const noexcept { return { v + a.v * b.v }; }
+        };
+       #endif
+
+        // Mixes inputs [First, First + sizeof...(Channels)) into the outputs in one pass
+        template <int First, bool Ramping, bool Stereo, int... Channels>
+        inline void mixChannelGroup(const float* const* inputs, const float* startGains, const float* endGains,
+                                    float* outL, float* outR, int startSample, int numSamples,
+                                    std::integer_sequence<int, Channels...>) noexcept
+        {
+            const float invSamples = 1.0f / (float) numSamples;
+            const float* in[] = { (inputs[First + Channels] + startSample)... };
+            const float gainL[] = { startGains[(First + Channels) * 2 + 0]... };
+            const float gainR[] = { startGains[(First + Channels) * 2 + 1]... };
+            const float stepL[] = { (Ramping ? (endGains[(First + Channels) * 2 + 0] - gainL[Channels]) * invSamples : 0.0f)... };
+            const float stepR[] = { (Ramping ? (endGains[(First + Channels) * 2 + 1] - gainR[Channels]) * invSamples : 0.0f)... };
+
+            Vector gl[] = { Vector::ramp(gainL[Channels], stepL[Channels])... };
+            Vector gr[] = { Vector::ramp(gainR[Channels], stepR[Channels])... };
+            const Vector glStep[] = { Vector::broadcast(stepL[Channels] * (float) Vector::size)... };
+            const Vector grStep[] = { Vector::broadcast(stepR[Channels] * (float) Vector::size)... };
+
+            outL += startSample;
+            if constexpr (Stereo)
+                outR += startSample;
+
+            int i = 0;
+            for (; i + Vector::size <= numSamples; i += Vector::size)
+            {
+                Vector accL = Vector::load(outL + i);
+                Vector accR = Stereo ? Vector::load(outR + i) : accL;
+
+                auto mixChannel = [&] (auto channel)
+                {
+                    constexpr int c = decltype(channel)::value;
+                    const Vector x = Vector::load(in[c] + i);
+                    accL = accL.multiplyAdd(x, gl[c]);
+                    if constexpr (Stereo)
+                        accR = accR.multiplyAdd(x, gr[c]);
+                    if constexpr (Ramping)
+                    {
+                        gl[c] = gl[c] + glStep[c];
+                        if constexpr (Stereo)
+                            gr[c] = gr[c] + grStep[c];
+                    }
+                };
+                (mixChannel(std::integral_constant<int, Channels> {}), ...);
+
+                accL.store(outL + i);
+                if constexpr (Stereo)
+                    accR.store(outR + i);
+            }
+
+            for (; i < numSamples; ++i)
+            {
+                float left = outL[i];
+                float right = Stereo ? outR[i] : 0.0f;
+                auto mixChannel = [&] (auto channel)
+                {
+                    constexpr int c = decltype(channel)::value;
+                    const float x = in[c][i];
+                    left += x * (gainL[c] + (float) i * stepL[c]);
+                    if constexpr (Stereo)
+                        right += x * (gainR[c] + (float) i * stepR[c]);
+                };
+                (mixChannel(std::integral_constant<int, Channels> {}), ...);
+
+                outL[i] = left;
+                if constexpr (Stereo)
+                    outR[i] = right;
+            }
+        }
+
+        template <int NumChannels, bool Ramping, bool Stereo, int First = 0>
+        inline void mixChannelGroups(const float* const* inputs, const float* startGains, const float* endGains,
+                                     float* outL, float* outR, int startSample, int numSamples) noexcept
+        {
+            constexpr int groupChannels = NumChannels - First < MIX_GROUP_CHANNELS ? NumChannels - First : MIX_GROUP_CHANNELS;
+            mixChannelGroup<First, Ramping, Stereo>(inputs, startGains, endGains, outL, outR, startSample, numSamples,
+                                                    std::make_integer_sequence<int, groupChannels> {});
+            if constexpr (First + groupChannels < NumChannels)
+                mixChannelGroups<NumChannels, Ramping, Stereo, First + groupChannels>(inputs, startGains, endGains,
+                                                                                      outL, outR, startSample, numSamples);
+        }
+    }
+
+    /**
+     * mixToStereo() for exactly NumChannels inputs (numChannels is ignored). Passing the same
+     * pointer as startGains and endGains, as for the settled part of a block, skips the ramps.
+     */
+    template <int NumChannels>
+    inline void mixToStereoFixed(const float* const* inputs, int /*numChannels*/,
+                                 const float* startGains, const float* endGains,
+                                 float* outL, float* outR, int startSample, int numSamples) noexcept
+    {
+        if (numSamples <= 0)
+            return;
+
+        const bool ramping = startGains != endGains;
+        if (outR != nullptr)
+        {
+            if (ramping)
+                detail::mixChannelGroups<NumChannels, true, true>(inputs, startGains, endGains, outL, outR, startSample, numSamples);
+            else
+                detail::mixChannelGroups<NumChannels, false, true>(inputs, startGains, endGains, outL, outR, startSample, numSamples);
+        }
+        else
+        {
+            if (ramping)
+                detail::mixChannelGroups<NumChannels, true, false>(inputs, startGains, endGains, outL, outR, startSample, numSamples);
+            else
+                detail::mixChannelGroups<NumChannels, false, false>(inputs, startGains, endGains, outL, outR, startSample, numSamples);
+        }
+    }
+
+    using MixToStereoFunction = void (*)(const float* const* inputs, int numChannels,
+                                         const float* startGains, const float* endGains,
+                                         float* outL, float* outR, int startSample, int numSamples) noexcept;
+
+    // Specialised kernel for the channel counts FormatDefaults knows a format for, else mixToStereo
+    inline MixToStereoFunction getMixToStereo(int numChannels) noexcept
+    {
+        switch (numChannels)
+        {
+            case 1:  return &mixToStereoFixed<1>;
+            case 2:  return &mixToStereoFixed<2>;
+            case 4:  return &mixToStereoFixed<4>;
+            case 8:  return &mixToStereoFixed<8>;
+            case 14: return &mixToStereoFixed<14>;
+            case 16: return &mixToStereoFixed<16>;
+            case 36: return &mixToStereoFixed<36>;
+            case 64: return &mixToStereoFixed<64>;
+            default: return &mixToStereo;
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Mach1Transcode.h"
+#include "Mach1TranscodeConstants.h"
+
+/**
+ * Format choices shared by the player and the command line tools: which Mach1Spatial format
+ * an input format is transcoded to before decoding, which input format a bare channel count
+ * is assumed to be, and which formats can be played for a given channel count.
+ */
+namespace FormatDefaults
+{
+    /// INPUT PREFERRED OUTPUT OVERRIDE ASSIGNMENTS
+    inline std::string getPreferredOutputFormat(const std::string& inputFormat) {
+        if (inputFormat == "3.0_LCR" || // NOTE: switch to M1Spatial-14 for center channel
+            inputFormat == "4.0_LCRS" || // NOTE: switch to M1Spatial-14 for center channel
+            inputFormat == "M1Horizon-4_2")
+        {
+            return "M1Spatial-4";
+        }
+        else if (inputFormat == "4.0_AFormat" ||
+                 inputFormat == "Ambeo" ||
+                 inputFormat == "TetraMic" ||
+                 inputFormat == "SPS-200" ||
+                 inputFormat == "ORTF3D" ||
+                 inputFormat == "CoreSound-OctoMic" ||
+                 inputFormat == "CoreSound-OctoMic_SIM")
+        {
+            return "M1Spatial-8";
+        }
+        // TODO: Add more format overrides for higher order ambisonic to 38ch when ready
+        return "M1Spatial-14";
+    }
+
+    inline std::string getDefaultFormatForChannelCount(int numChannels) {
+        switch (numChannels) {
+            case 3:  return "3.0_LCR";
+            case 4:  return "M1Spatial-4";
+            case 5:  return "5.0_C";
+            case 6:  return "5.1_C";
+            case 7:  return "7.0_C";
+            case 8:  return "M1Spatial-8";
+            case 9:  return "ACNSN3DO2A";
+            case 10: return "7.1.2_C";
+            case 11: return "7.0.6_C";
+            case 12: return "7.1.4_C";
+            case 14: return "M1Spatial-14";
+            case 16: return "ACNSN3DO3A";
+            case 24: return "ACNSN3DO4A";
+            case 36: return "ACNSN3DO5A";
+            case 64: return "ACNSN3DO6A";
+            default: return "";
+        }
+    }
+
+    // Input formats with this channel count that have a conversion path to their preferred
+    // output format. Builds a conversion path per candidate, so callers should cache the result.
+    inline std::vector<std::string> getMatchingFormatNames(int numChannels) {
+        std::vector<std::string> matchingFormatNames;
+
+        Mach1Transcode<float> m1TranscodeTemp;
+
+        for (const auto& format : Mach1TranscodeConstants::formats) {
+            if (format.numChannels == numChannels) {
+                const std::string name(format.name);
+                m1TranscodeTemp.setInputFormat(m1TranscodeTemp.getFormatFromString(name));
+                m1TranscodeTemp.setOutputFormat(m1TranscodeTemp.getFormatFromString(getPreferredOutputFormat(name)));
+
+                if (m1TranscodeTemp.processConversionPath()) {
+                    matchingFormatNames.push_back(name);
+                }
+            }
+        }
+
+        return matchingFormatNames;
+    }
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+/**
+ * Single-producer / single-consumer FIFO of interleaved float frames.
+ *
+ * The media decoder thread writes interleaved PCM as it arrives and the audio thread reads it
+ * back deinterleaved into an AudioBuffer, without locks on either side. Storage is sized in
+ * prepare() for the largest channel count, so changing the stream's channel count later never
+ * allocates. Like a flush, a channel count change is only requested by the producer and
+ * carried out by the consumer on its own thread.
+ */
+class InterleavedAudioFifo
+{
+public:
+    void prepare(int maxChannels, int capacityFrames)
+    {
+        maxNumChannels = maxChannels;
+        fifo.setTotalSize(capacityFrames + 1); // AbstractFifo keeps one slot free
+        storage.assign((size_t) (capacityFrames + 1) * (size_t) maxChannels, 0.0f);
+        fifo.reset();
+        framesWritten = 0;
+        framesRead = 0;
+        writeNumChannels = 0;
+        numChannels = 0;
+        pendingLayout = 0;
+    }
+
+    // Producer side, e.g. from the decoder's format setup. Frames written from now on use the
+    // new layout; the consumer drops the ones queued before the change at its next read().
+    void setNumChannels(int newNumChannels) noexcept
+    {
+        jassert(newNumChannels <= maxNumChannels);
+        writeNumChannels = juce::jlimit(0, maxNumChannels, newNumChannels);
+        pendingLayout = ((juce::uint64) framesWritten << 32) | (juce::uint64) (writeNumChannels + 1);
+    }
+
+    // The channel count the consumer reads with
+    int getNumChannels() const noexcept { return numChannels.load(); }
+    int getNumReady() const noexcept { return fifo.getNumReady(); }
+    int getFreeSpace() const noexcept { return fifo.getFreeSpace(); }
+    int getCapacity() const noexcept { return fifo.getTotalSize() - 1; }
+
+    //==============================================================================
+    // Producer side. Writes as many frames as fit and returns how many that was.
+    int write(const float* interleaved, int numFrames) noexcept
+    {
+        const size_t stride = (size_t) writeNumChannels;
+        if (stride == 0)
+            return 0;
+
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(numFrames, start1, size1, start2, size2);
+
+        std::copy(interleaved, interleaved + (size_t) size1 * stride, storage.data() + (size_t) start1 * stride);
+        std::copy(interleaved + (size_t) size1 * stride, interleaved + (size_t) (size1 + size2) * stride,
+                  storage.data() + (size_t) start2 * stride);
+
+        fifo.finishedWrite(size1 + size2);
+        framesWritten += (juce::uint32) (size1 + size2);
+        return size1 + size2;
+    }
+
+    // Producer side: asks the consumer to drop everything queued so far (e.g. after a seek)
+    void requestFlush() noexcept { flushRequested = true; }
+
+    //==============================================================================
+    // Consumer side. Deinterleaves up to numFrames into dest (channels beyond the stream's
+    // are left untouched) and returns how many frames were available.
+    int read(juce::AudioBuffer<float>& dest, int destStartSample, int numFrames) noexcept
+    {
+        if (flushRequested.exchange(false))
+            discard(fifo.getNumReady());
+
+        // A layout change is checked for after the ready frames are known: the producer
+        // requests it before writing any frame in the new layout, so if none is pending here
+        // everything about to be read was written with the stride we read it with.
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(numFrames, start1, size1, start2, size2);
+        while (applyPendingLayout())
+            fifo.prepareToRead(numFrames, start1, size1, start2, size2);
+
+        const int stride = numChannels.load();
+        if (stride == 0)
+            return 0;
+
+        const int channelsToCopy = juce::jmin(stride, dest.getNumChannels());
+        for (int channel = 0; channel < channelsToCopy; ++channel)
+        {
+            float* out = dest.getWritePointer(channel, destStartSample);
+            deinterleave(storage.data() + (size_t) start1 * (size_t) stride + (size_t) channel, stride, out, size1);
+            deinterleave(storage.data() + (size_t) start2 * (size_t) stride + (size_t) channel, stride, out + size1, size2);
+        }
+
+        discard(size1 + size2);
+        return size1 + size2;
+    }
+
+    // Consumer side: drops up to numFrames of the oldest queued frames
+    void skip(int numFrames) noexcept
+    {
+        discard(juce::jmin(numFrames, fifo.getNumReady()));
+    }
+
+private:
+    void discard(int numFrames) noexcept
+    {
+        fifo.finishedRead(numFrames);
+        framesRead += (juce::uint32) numFrames;
+    }
+
+    // Consumer side: switches to a requested channel count, dropping the frames queued in the
+    // old layout. Returns false if there was no request.
+    bool applyPendingLayout() noexcept
+    {
+        const auto pending = pendingLayout.exchange(0);
+        if (pending == 0)
+            return false;
+
+        // frame counters wrap, their difference does not
+        const auto layoutStart = (juce::uint32) (pending >> 32);
+        const auto oldFrames = (juce::int32) (layoutStart - framesRead);
+        if (oldFrames > 0)
+            discard(juce::jmin((int) oldFrames, fifo.getNumReady()));
+
+        numChannels = (int) (pending & 0xffffffff) - 1;
+        return true;
+    }
+
+    static void deinterleave(const float* in, int stride, float* out, int numFrames) noexcept
+    {
+        for (int i = 0; i < numFrames; ++i)
+            out[i] = in[(size_t) i * (size_t) stride];
+    }
+
+    juce::AbstractFifo fifo { 1 };
+    std::vector<float> storage;
+    int maxNumChannels = 0;
+    int writeNumChannels = 0;       // producer only
+    juce::uint32 framesWritten = 0; // producer only
+    juce::uint32 framesRead = 0;    // consumer only
+    std::atomic<int> numChannels { 0 };
+    std::atomic<juce::uint64> pendingLayout { 0 }; // frame the new layout starts at << 32 | channels + 1, 0 if none
+    std::atomic<bool> flushRequested { false };
+};
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <atomic>
+
+#include "InterleavedAudioFifo.h"
+
+/**
+ * Adaptive jitter buffer between a bursty decoder thread and the audio device callback.
+ *
+ * The decoder writes interleaved PCM in whatever chunk sizes it produces. The audio thread
+ * only starts reading once a target fill level is reached, and that target follows the
+ * observed burst size plus a safety margin which grows after every underrun and slowly decays
+ * while playback runs clean. If the fill drifts far above the target the excess is dropped to
+ * keep latency bounded. Underruns, overruns and the current fill level are exposed for display.
+ */
+class JitterBuffer
+{
+public:
+    struct Stats
+    {
+        int fillFrames = 0;
+        int targetFrames = 0;
+        int underruns = 0;
+        int overruns = 0;
+    };
+
+    void prepare(int maxChannels, int capacityFrames)
+    {
+        fifo.prepare(maxChannels, capacityFrames);
+        maxTargetFrames = capacityFrames / 2;
+    }
+
+    // Consumer side setup, call before the device starts calling read()
+    void setBlockSize(int newBlockSize, double sampleRate)
+    {
+        blockSize = juce::jmax(1, newBlockSize);
+        cleanBlocksBeforeDecay = juce::jmax(1, juce::roundToInt(MARGIN_DECAY_SECONDS * sampleRate / blockSize));
+        margin = 0;
+        cleanBlocks = 0;
+        buffering = true;
+    }
+
+    // Any thread. Frames each read() takes when that is not the device block size, e.g. stream
+    // rate frames in front of a resampler; 0 goes back to one device block per read
+    void setFramesPerRead(int numFrames) noexcept
+    {
+        framesPerRead.store(juce::jmax(0, numFrames), std::memory_order_relaxed);
+    }
+
+    void setNumChannels(int numChannels)
+    {
+        fifo.setNumChannels(numChannels);
+        peakBurst = 0;
+    }
+
+    //==============================================================================
+    // Producer side
+    void write(const float* interleaved, int numFrames) noexcept
+    {
+        // peak burst size with a slow decay, so one large chunk keeps the target up for a while
+        const int decayed = peakBurst.load(std::memory_order_relaxed) * 63 / 64;
+        peakBurst.store(juce::jmax(numFrames, decayed), std::memory_order_relaxed);
+
+        if (fifo.write(interleaved, numFrames) < numFrames)
+            overruns.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void requestFlush() noexcept
+    {
+        flushRequested = true;
+        fifo.requestFlush();
+    }
+
+    //==============================================================================
+    // Consumer side. Fills up to numFrames of dest and returns how many frames were written;
+    // the rest of the block is left for the caller to keep silent.
+    int read(juce::AudioBuffer<float>& dest, int destStartSample, int numFrames) noexcept
+    {
+        if (flushRequested.exchange(false))
+            buffering = true;
+
+        const int perRead = getFramesPerRead();
+        const int target = getTargetFrames(perRead);
+        const int ready = fifo.getNumReady();
+        currentTarget.store(target, std::memory_order_relaxed);
+
+        if (buffering)
+        {
+            if (ready < target)
+                return 0;
+            buffering = false;
+        }
+
+        // fell far behind the decoder (e.g. after a device stall), catch up to the target
+        if (ready > 2 * target + numFrames)
+        {
+            fifo.skip(ready - target);
+            overruns.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        const int framesRead = fifo.read(dest, destStartSample, numFrames);
+        if (framesRead < numFrames)
+        {
+            underruns.fetch_add(1, std::memory_order_relaxed);
+            margin = juce::jmin(margin + perRead, maxTargetFrames);
+            cleanBlocks = 0;
+            buffering = true;
+        }
+        else if (++cleanBlocks >= cleanBlocksBeforeDecay && margin > 0)
+        {
+            margin = juce::jmax(0, margin - perRead / 2);
+            cleanBlocks = 0;
+        }
+
+        return framesRead;
+    }
+
+    //==============================================================================
+    // Any thread
+    Stats getStats() const noexcept
+    {
+        return { fifo.getNumReady(),
+                 currentTarget.load(std::memory_order_relaxed),
+                 underruns.load(std::memory_order_relaxed),
+                 overruns.load(std::memory_order_relaxed) };
+    }
+
+private:
+    // How long playback has to run without an underrun before the safety margin shrinks
+    static constexpr double MARGIN_DECAY_SECONDS = 10.0;
+
+    int getFramesPerRead() const noexcept
+    {
+        const int frames = framesPerRead.load(std::memory_order_relaxed);
+        return frames > 0 ? frames : blockSize;
+    }
+
+    // in the frames read() takes, so one read always fits in the target
+    int getTargetFrames(int perRead) const noexcept
+    {
+        return juce::jlimit(perRead, juce::jmax(perRead, maxTargetFrames),
+                            peakBurst.load(std::memory_order_relaxed) + perRead + margin);
+    }
+
+    InterleavedAudioFifo fifo;
+    int maxTargetFrames = 0;
+
+    // producer
+    std::atomic<int> peakBurst { 0 };
+
+    // consumer
+    int blockSize = 512;
+    std::atomic<int> framesPerRead { 0 };
+    int margin = 0;
+    int cleanBlocks = 0;
+    int cleanBlocksBeforeDecay = 1;
+    bool buffering = true;
+    std::atomic<bool> flushRequested { false };
+
+    // stats
+    std::atomic<int> currentTarget { 0 };
+    std::atomic<int> underruns { 0 };
+    std::atomic<int> overruns { 0 };
+};
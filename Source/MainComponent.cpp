@@ -1,11 +1,9 @@
 #include "MainComponent.h"
 
-#define MINUS_3DB_AMP (0.707945784f)
 #define MINUS_6DB_AMP (0.501187234f)
 
 //==============================================================================
-MainComponent::MainComponent() : m_decode_strategy(&MainComponent::nullStrategy),
-                                 m_transcode_strategy(&MainComponent::nullStrategy) 
+MainComponent::MainComponent()
 {
     // Make sure you set the size of the component after
     // you add any child components.
@@ -38,12 +36,31 @@ MainComponent::MainComponent() : m_decode_strategy(&MainComponent::nullStrategy)
 
     createMenuBar();
 
+    // resolve (or load the cached) transcode paths before the format picker needs them
+    transcodePathIndex.start(TranscodePathIndex::getDefaultCacheFile());
+
+    audioConfigBuilder.onBuild = [this](std::unique_ptr<AudioDecodeConfig> config) { buildAudioConfig(std::move(config)); };
+
     initializeAppProperties();
     loadRecentFileList();
+
+    // the filter set itself is prepared once the device sample rate is known, see timerCallback()
+    if (appProperties != nullptr) {
+        const auto filterPath = appProperties->getValue("hrtfFilterFile");
+        if (juce::File::isAbsolutePath(filterPath)) {
+            hrtfFilterFile = juce::File(filterPath);
+        }
+        useHrtfConvolution = appProperties->getBoolValue("hrtfConvolution", false);
+        useDecodeCoeffTable = appProperties->getBoolValue("decodeCoeffTable", false);
+        numListeners = juce::jlimit(1, (int) MAX_LISTENERS, appProperties->getIntValue("listeners", 1));
+    }
 }
 
 MainComponent::~MainComponent() 
 {
+    orientationPoller.stopTimer();
+    audioConfigBuilder.stopThread(10000); // finishes a build in progress, which uses the members below
+
     // Clean up orientation client
     m1OrientationClient.command_disconnect();
     m1OrientationClient.close();
@@ -57,6 +74,7 @@ MainComponent::~MainComponent()
     // Remove callbacks
     audioDeviceManager.removeAudioCallback(this);
     audioDeviceManager.removeChangeListener(this);
+    audioConfig.clear();
     
     // Remove menu bar
 #if JUCE_MAC
@@ -80,17 +98,35 @@ void MainComponent::audioDeviceIOCallbackWithContext(const float* const* inputCh
     juce::AudioBuffer<float> tempBuffer(const_cast<float**>(outputChannelData), numOutputChannels, numSamples);
     juce::AudioSourceChannelInfo bufferToFill(&tempBuffer, 0, numSamples);
     
+    callbackProfiler.beginBlock(numSamples);
+
     // Clear the output buffer first
     for (int i = 0; i < numOutputChannels; ++i)
         juce::FloatVectorOperations::clear(outputChannelData[i], numSamples);
     
-    getNextAudioBlock(bufferToFill);
+    {
+        // Flags allocations and lock acquisitions below when built with M1_REALTIME_SAFETY_CHECKS
+        RealtimeSafety::ScopedRealtimeSection realtimeSection;
+        getNextAudioBlock(bufferToFill);
+    }
+
+    const float load = callbackProfiler.endBlock();
+    if (load > 1.0f) {
+        audioEvents.post(AudioEventQueue::DeadlineMiss, juce::roundToInt(load * 100.0f));
+    }
 }
 
 void MainComponent::audioDeviceAboutToStart(juce::AudioIODevice* device)
 {
     prepareToPlay(device->getCurrentBufferSizeSamples(),
                  device->getCurrentSampleRate());
+
+    // a block rendered now is heard after the output latency, aim predictions at its middle
+    if (device->getCurrentSampleRate() > 0.0)
+    {
+        outputLatencySeconds = (device->getOutputLatencyInSamples() + device->getCurrentBufferSizeSamples() * 0.5)
+                               / device->getCurrentSampleRate();
+    }
 }
 
 void MainComponent::audioDeviceStopped()
@@ -126,6 +162,10 @@ void MainComponent::initialise() {
     m1OrientationClient.setStatusCallback(std::bind(&MainComponent::setStatus, this, std::placeholders::_1,
                                                     std::placeholders::_2));
 
+    // publish the listener orientation to the audio thread independently of the frame rate
+    orientationPoller.onPoll = [this]() { pollOrientation(); };
+    orientationPoller.startTimer(ORIENTATION_POLL_INTERVAL_MS);
+
     imgVideo.setOpenGLContext(m.getOpenGLContext());
     imgLogo.setOpenGLContext(m.getOpenGLContext());
     imgHideUI.setOpenGLContext(m.getOpenGLContext());
@@ -322,6 +362,14 @@ void MainComponent::initialise() {
                         to_string(gain));
                 }
             }
+        } else if (msg.getAddressPattern() == "/listener-orientation") {
+            // orientation of one of the extra listeners, see numListeners
+            if (msg.size() >= 4 && msg[0].isInt32() && msg[1].isFloat32() && msg[2].isFloat32() && msg[3].isFloat32()) {
+                const int listener = msg[0].getInt32();
+                if (listener >= 1 && listener < MAX_LISTENERS) {
+                    listenerOrientations[listener - 1].push(msg[1].getFloat32(), msg[2].getFloat32(), msg[3].getFloat32());
+                }
+            }
         } else {
             // display a captured unexpected osc message
             if (msg.size() > 0) {
@@ -357,25 +405,29 @@ void MainComponent::prepareToPlay(int samplesPerBlockExpected, double newSampleR
 	// its settings (i.e. sample rate, ablock size, etc) are changed.
 	sampleRate = newSampleRate;
 	blockSize = samplesPerBlockExpected;
+    callbackProfiler.prepare(sampleRate);
+    callbackProfiler.requestReset(); // loads from another block size are not comparable
+    channelMeters.prepare(sampleRate);
     
     currentMedia.prepareToPlay(blockSize, sampleRate);
+
+    // the device is stopped, any crossfade in progress is moot
+    configHandover.prepare(sampleRate, CONFIG_CROSSFADE_SECONDS);
     
-    // Setup for Mach1Decode
-    smoothedChannelCoeffs.resize(m1Decode.getFormatCoeffCount());
-    spatialMixerCoeffs.resize(m1Decode.getFormatCoeffCount());
-    for (int input_channel = 0; input_channel < m1Decode.getFormatChannelCount(); input_channel++) {
-        smoothedChannelCoeffs[input_channel * 2 + 0].reset(sampleRate, (double) 0.01);
-        smoothedChannelCoeffs[input_channel * 2 + 1].reset(sampleRate, (double) 0.01);
-    }
-    
-    // restructure output buffer
-    readBuffer.setSize(m1Decode.getFormatCoeffCount(), blockSize);
+    // Allocate every buffer the callback touches for the worst case (ACN O6 input),
+    // the audio thread only ever shrinks/regrows them within this allocation
+    readBuffer.setSize(MAX_INPUT_CHANNELS, blockSize);
+    intermediaryBuffer.setSize(MAX_DECODE_CHANNELS, blockSize);
+    parallelMixBuffer.setSize((MAX_TRANSCODE_WORKERS + 1) * 2, blockSize);
+    crossfadeBuffer.setSize(MAX_OUTPUT_CHANNELS, blockSize);
+    readBuffer.clear();
+    intermediaryBuffer.clear();
 }
 
 void MainComponent::fallbackDecodeStrategy(const AudioSourceChannelInfo &bufferToFill,
                                            const AudioSourceChannelInfo &info) {
     // Invalid Decode I/O; clear buffers
-    for (auto channel = detectedNumInputChannels; channel < 2; ++channel) {
+    for (auto channel = activeConfig->numInputChannels; channel < 2; ++channel) {
         if (channel < bufferToFill.buffer->getNumChannels())
         {
             bufferToFill.buffer->clear(channel, 0, bufferToFill.numSamples);
@@ -385,141 +437,163 @@ void MainComponent::fallbackDecodeStrategy(const AudioSourceChannelInfo &bufferT
 
 void MainComponent::stereoDecodeStrategy(const AudioSourceChannelInfo &bufferToFill,
                                          const AudioSourceChannelInfo &info) {
-    bufferToFill.buffer->copyFrom(0, 0, readBuffer, 0, 0, info.numSamples);
-    if (bufferToFill.buffer->getNumChannels() > 1)
-    {
-        bufferToFill.buffer->copyFrom(1, 0, readBuffer, 1, 0, info.numSamples);
-    }
+    activeConfig->mixWithSmoothedCoeffs(*activeListener, readBuffer.getArrayOfReadPointers(), 2, DecodeChain::STEREO_COEFFS,
+                                        getDecodeOutput(bufferToFill));
 }
 
 void MainComponent::monoDecodeStrategy(const AudioSourceChannelInfo &bufferToFill, const AudioSourceChannelInfo &info) {
-    bufferToFill.buffer->copyFrom(0, 0, readBuffer, 0, 0, info.numSamples);
-    if (bufferToFill.buffer->getNumChannels() > 1)
-    {
-        bufferToFill.buffer->copyFrom(1, 0, readBuffer, 0, 0, info.numSamples);
-    }
-    bufferToFill.buffer->applyGain(MINUS_3DB_AMP); // apply -3dB pan-law gain to all channels
+    activeConfig->mixWithSmoothedCoeffs(*activeListener, readBuffer.getArrayOfReadPointers(), 1, DecodeChain::MONO_COEFFS,
+                                        getDecodeOutput(bufferToFill));
 }
 
-void MainComponent::readBufferDecodeStrategy(const AudioSourceChannelInfo &bufferToFill,
-                                             const AudioSourceChannelInfo &info) {
-    auto sample_count = bufferToFill.numSamples;
-    auto channel_count = detectedNumInputChannels;
-    float *outBufferR = nullptr;
-    float *outBufferL = bufferToFill.buffer->getWritePointer(0);
+DecodeChain::Output MainComponent::getDecodeOutput(const AudioSourceChannelInfo &bufferToFill) {
+    DecodeChain::Output output;
+    output.left = bufferToFill.buffer->getWritePointer(0, bufferToFill.startSample);
     if (bufferToFill.buffer->getNumChannels() > 1)
     {
-        outBufferR = bufferToFill.buffer->getWritePointer(1);
-    }
-    auto ori_deg = currentOrientation.GetGlobalRotationAsEulerDegrees();
-    m1Decode.setRotationDegrees({ori_deg.GetYaw(), ori_deg.GetPitch(), ori_deg.GetRoll()});
-    spatialMixerCoeffs = m1Decode.decodeCoeffs();
+        output.right = bufferToFill.buffer->getWritePointer(1, bufferToFill.startSample);
+    }
+    output.numSamples = bufferToFill.numSamples;
+    output.gain = currentMedia.getGain();
+    output.startSettled = activeConfig->startRampsSettled;
+    output.workers = &transcodeWorkers;
+    output.partialSums = &parallelMixBuffer;
+    return output;
+}
 
-    // Update spatial mixer coeffs from Mach1Decode for a smoothed value
-    for (int channel = 0; channel < channel_count; ++channel) {
-        smoothedChannelCoeffs[channel * 2 + 0].setTargetValue(spatialMixerCoeffs[channel * 2 + 0]);
-        smoothedChannelCoeffs[channel * 2 + 1].setTargetValue(spatialMixerCoeffs[channel * 2 + 1]);
+DecodeChain::Orientation MainComponent::readDecodeOrientation() {
+    const int listener = activeListener->index;
+    const auto sample = listener == 0 ? orientationChannel.read() : listenerOrientations[listener - 1].read();
+    DecodeChain::Orientation orientation { sample.yaw, sample.pitch, sample.roll };
+    if (predictOrientation.load(std::memory_order_relaxed)) {
+        OrientationChannel::predict(sample, OrientationChannel::now() + outputLatencySeconds.load(),
+                                    MAX_ORIENTATION_PREDICTION_SECONDS, orientation.yaw, orientation.pitch, orientation.roll);
     }
 
-    // copy from readBuffer for doubled channels
-    for (auto channel = 0; channel < channel_count; ++channel) {
-        tempBuffer.copyFrom(channel * 2 + 0, 0, readBuffer, channel, 0, sample_count);
-        tempBuffer.copyFrom(channel * 2 + 1, 0, readBuffer, channel, 0, sample_count);
-    }
+    // stretch the gain ramps over the interval between orientation updates, so a slow
+    // tracker still glides between poses instead of stepping
+    activeListener->decodeCoeffRamp.setRampLengthSeconds(juce::jlimit(MIN_DECODE_RAMP_SECONDS, MAX_DECODE_RAMP_SECONDS, sample.updateInterval));
+    return orientation;
+}
 
-    // apply decode coeffs to output buffer
-    for (int sample = 0; sample < info.numSamples; sample++) {
-        for (int channel = 0; channel < channel_count; channel++) {
-            auto left_sample = tempBuffer.getReadPointer(channel * 2 + 0)[sample];
-            auto right_sample = tempBuffer.getReadPointer(channel * 2 + 1)[sample];
-            outBufferL[sample] += left_sample * smoothedChannelCoeffs[channel * 2 + 0].getNextValue();
-            if (bufferToFill.buffer->getNumChannels() > 1)
-            {
-                outBufferR[sample] += right_sample * smoothedChannelCoeffs[channel * 2 + 1].getNextValue();
-            }
-        }
-    }
+void MainComponent::readBufferDecodeStrategy(const AudioSourceChannelInfo &bufferToFill,
+                                             const AudioSourceChannelInfo &info) {
+    activeConfig->decodeToStereo(*activeListener, readBuffer.getArrayOfReadPointers(), activeConfig->numInputChannels,
+                                 readDecodeOrientation(), getDecodeOutput(bufferToFill));
 }
 
 void MainComponent::intermediaryBufferDecodeStrategy(const AudioSourceChannelInfo &bufferToFill,
                                                      const AudioSourceChannelInfo &info) {
-    auto sample_count = bufferToFill.numSamples;
-    auto channel_count = detectedNumInputChannels;
-    float *outBufferR = nullptr;
-    float *outBufferL = bufferToFill.buffer->getWritePointer(0);
-    if (bufferToFill.buffer->getNumChannels() > 1)
-    {
-        outBufferR = bufferToFill.buffer->getWritePointer(1);
-    }
-    auto ori_deg = currentOrientation.GetGlobalRotationAsEulerDegrees();
-    m1Decode.setRotationDegrees({ori_deg.GetYaw(), ori_deg.GetPitch(), ori_deg.GetRoll()});
-    spatialMixerCoeffs = m1Decode.decodeCoeffs();
+    // decode the transcoded M1Spatial channels, not the original input channels
+    auto channel_count = juce::jmin(activeConfig->decode.getFormatChannelCount(), intermediaryBuffer.getNumChannels());
+    activeConfig->decodeToStereo(*activeListener, intermediaryBuffer.getArrayOfReadPointers(), channel_count,
+                                 readDecodeOrientation(), getDecodeOutput(bufferToFill));
+}
 
-    // Update spatial mixer coeffs from Mach1Decode for a smoothed value
-    for (int channel = 0; channel < channel_count; ++channel) {
-        smoothedChannelCoeffs[channel * 2 + 0].setTargetValue(spatialMixerCoeffs[channel * 2 + 0]);
-        smoothedChannelCoeffs[channel * 2 + 1].setTargetValue(spatialMixerCoeffs[channel * 2 + 1]);
-    }
+void MainComponent::readBufferConvolutionStrategy(const AudioSourceChannelInfo &bufferToFill,
+                                                  const AudioSourceChannelInfo &info) {
+    activeConfig->convolveToStereo(*activeListener, readBuffer.getArrayOfReadPointers(), activeConfig->numInputChannels,
+                                   readDecodeOrientation(), getDecodeOutput(bufferToFill));
+}
 
-    // copy from intermediaryBuffer for doubled channels
-    for (auto channel = 0; channel < channel_count; ++channel) {
-        tempBuffer.copyFrom(channel * 2 + 0, 0, intermediaryBuffer, channel, 0, sample_count);
-        tempBuffer.copyFrom(channel * 2 + 1, 0, intermediaryBuffer, channel, 0, sample_count);
-    }
+void MainComponent::intermediaryBufferConvolutionStrategy(const AudioSourceChannelInfo &bufferToFill,
+                                                          const AudioSourceChannelInfo &info) {
+    auto channel_count = juce::jmin(activeConfig->decode.getFormatChannelCount(), intermediaryBuffer.getNumChannels());
+    activeConfig->convolveToStereo(*activeListener, intermediaryBuffer.getArrayOfReadPointers(), channel_count,
+                                   readDecodeOrientation(), getDecodeOutput(bufferToFill));
+}
 
-    // apply decode coeffs to output buffer
-    for (int sample = 0; sample < info.numSamples; sample++) {
-        for (int channel = 0; channel < channel_count; channel++) {
-            auto left_sample = tempBuffer.getReadPointer(channel * 2 + 0)[sample];
-            auto right_sample = tempBuffer.getReadPointer(channel * 2 + 1)[sample];
-            outBufferL[sample] += left_sample * smoothedChannelCoeffs[channel * 2 + 0].getNextValue();
-            if (bufferToFill.buffer->getNumChannels() > 1)
-            {
-                outBufferR[sample] += right_sample * smoothedChannelCoeffs[channel * 2 + 1].getNextValue();
-            }
-        }
-    }
+void MainComponent::fusedTranscodeDecodeStrategy(const AudioSourceChannelInfo &bufferToFill,
+                                                  const AudioSourceChannelInfo &info) {
+    activeConfig->fusedTranscodeDecode(*activeListener, readBuffer.getArrayOfReadPointers(),
+                                       readDecodeOrientation(), getDecodeOutput(bufferToFill));
+}
+
+void MainComponent::ambisonicRotationDecodeStrategy(const AudioSourceChannelInfo &bufferToFill,
+                                                    const AudioSourceChannelInfo &info) {
+    activeConfig->ambisonicRotationDecode(*activeListener, readBuffer.getArrayOfReadPointers(),
+                                          readDecodeOrientation(), getDecodeOutput(bufferToFill));
 }
 
 void MainComponent::intermediaryBufferTranscodeStrategy(const AudioSourceChannelInfo &bufferToFill,
                                                         const AudioSourceChannelInfo &info) {
-    auto out = m1Transcode.getOutputNumChannels();
+    auto out = activeConfig->transcode.getOutputNumChannels();
     auto sampleCount = bufferToFill.numSamples;
 
     if (out == 0) {
         return;
     }
 
-    // restructure output buffer
-    if (intermediaryBuffer.getNumSamples() != out || intermediaryBuffer.getNumSamples() != sampleCount) {
-        intermediaryBuffer.setSize(out, bufferToFill.numSamples);
+    // restructure output buffer within the allocation made in prepareToPlay()
+    if (intermediaryBuffer.getNumChannels() != out || intermediaryBuffer.getNumSamples() != sampleCount) {
+        intermediaryBuffer.setSize(out, sampleCount, false, false, true);
         intermediaryBuffer.clear();
     }
 
-    std::vector<float*> readPtrs;
-    readPtrs.resize(readBuffer.getNumChannels());
-    for(int i = 0; i < readBuffer.getNumChannels(); i++) {
-        readPtrs[i] = readBuffer.getWritePointer(i); // won't be written to. m1Transcode just expects non-const float**.
+    if (!activeConfig->transcodeBlock(readBuffer.getArrayOfReadPointers(), intermediaryBuffer.getArrayOfWritePointers(),
+                                      out, sampleCount, &transcodeWorkers)) {
+        intermediaryBuffer.clear();
+        
+        // Display error to user, draw() turns this into the popup
+        postAudioError(AudioEventQueue::ErrorTranscode);
     }
+}
 
-    std::vector<float*> intermediaryPtrs;
-    intermediaryPtrs.resize(intermediaryBuffer.getNumChannels());
-    for(int i = 0; i < intermediaryBuffer.getNumChannels(); i++) {
-        intermediaryPtrs[i] = intermediaryBuffer.getWritePointer(i);
+void MainComponent::speakerLayoutStrategy(const AudioSourceChannelInfo &bufferToFill,
+                                          const AudioSourceChannelInfo &info) {
+    auto &config = *activeConfig;
+    const int out = config.numSpeakerChannels;
+    const int device_channels = bufferToFill.buffer->getNumChannels();
+    const int sample_count = bufferToFill.numSamples;
+
+    const float gain = currentMedia.getGain();
+    auto &masterGainRamp = config.masterGainRamp;
+    if (config.startRampsSettled) {
+        masterGainRamp.setCurrentAndTargets(&gain, 1);
+    } else {
+        masterGainRamp.setTargets(&gain, 1);
+    }
+    const int gain_ramp_samples = masterGainRamp.advance(sample_count);
+    const float start_gain = gain_ramp_samples > 0 ? masterGainRamp.getRampStart()[0] : masterGainRamp.getCurrent()[0];
+    const float end_gain = gain_ramp_samples > 0 ? masterGainRamp.getRampEnd()[0] : masterGainRamp.getCurrent()[0];
+
+    if (config.conversionOutputChannels == out) {
+        // single matrix pass with the volume folded into the matrix gains, split over the
+        // transcode workers when enabled
+        float *speakerPtrs[MAX_OUTPUT_CHANNELS];
+        const int speaker_count = juce::jmin(out, device_channels);
+        for (int speaker = 0; speaker < speaker_count; ++speaker) {
+            speakerPtrs[speaker] = bufferToFill.buffer->getWritePointer(speaker, bufferToFill.startSample);
+        }
+        config.applyConversionMatrix(readBuffer.getArrayOfReadPointers(), speakerPtrs, speaker_count, sample_count,
+                                     &transcodeWorkers, start_gain, end_gain, gain_ramp_samples);
+        return;
     }
 
-    try {
-        m1Transcode.processConversion(readPtrs.data(), intermediaryPtrs.data(), sampleCount);
-    } catch (const std::exception& e) {
-        // Log error but don't crash
-        DBG("Transcode error: " << e.what());
-        intermediaryBuffer.clear();
-        
-        // Display error to user
-        showErrorPopup = true;
-        errorMessage = "TRANSCODE ERROR";
-        errorMessageInfo = "No valid transcode conversion path found.";
-        errorStartTime = std::chrono::steady_clock::now();
+    // multi-step conversion path, Mach1Transcode writes the speaker feeds itself
+    if (device_channels < out) {
+        postAudioError(AudioEventQueue::ErrorOutput); // the device lost channels since the layout was chosen
+        return;
+    }
+
+    float *speakerPtrs[MAX_OUTPUT_CHANNELS];
+    for (int speaker = 0; speaker < out; ++speaker) {
+        speakerPtrs[speaker] = bufferToFill.buffer->getWritePointer(speaker, bufferToFill.startSample);
+    }
+
+    if (!config.transcodeBlock(readBuffer.getArrayOfReadPointers(), speakerPtrs, out, sample_count, nullptr)) {
+        bufferToFill.clearActiveBufferRegion();
+        postAudioError(AudioEventQueue::ErrorTranscode);
+        return;
+    }
+
+    // Mach1Transcode owns this mix, so the volume goes on the speaker feeds afterwards
+    if (gain_ramp_samples > 0 || end_gain != 1.0f) {
+        for (int speaker = 0; speaker < out; ++speaker) {
+            bufferToFill.buffer->applyGainRamp(speaker, bufferToFill.startSample, gain_ramp_samples, start_gain, end_gain);
+            bufferToFill.buffer->applyGain(speaker, bufferToFill.startSample + gain_ramp_samples,
+                                           sample_count - gain_ramp_samples, end_gain);
+        }
     }
 }
 
@@ -529,19 +603,30 @@ void MainComponent::noTranscodeStrategy(const AudioSourceChannelInfo&, const Aud
 
 void MainComponent::nullStrategy(const AudioSourceChannelInfo &bufferToFill, const AudioSourceChannelInfo &info)
 {
-    // Display error to user
-    showErrorPopup = true;
-    errorMessage = "OUTPUT ERROR";
-    errorMessageInfo = "No valid audio strategy available.";
-    errorStartTime = std::chrono::steady_clock::now();
+    // Display error to user, draw() turns this into the popup
+    postAudioError(AudioEventQueue::ErrorOutput);
+}
+
+void MainComponent::postAudioError(AudioEventQueue::Type type) {
+    const double now = juce::Time::getMillisecondCounterHiRes();
+    if (type == lastPostedError && now - lastErrorPostTime < ERROR_REPOST_SECONDS * 1000.0) {
+        return;
+    }
+    if (audioEvents.post(type)) {
+        lastPostedError = type;
+        lastErrorPostTime = now;
+    }
 }
 
 void MainComponent::getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) {
-    const juce::ScopedLock audioLock(audioCallbackLock);
+    // Never wait for the message thread: if it is swapping the media, skip this block
+    const juce::ScopedTryLock audioLock(audioCallbackLock);
+    if (!audioLock.isLocked()) {
+        return;
+    }
 
     // If no clip has been loaded, exit this routine.
-    if (!currentMedia.clipLoaded()) {
-        setDetectedInputChannelCount(0);
+    if (!currentMedia.clipLoadedRealtime()) {
         return;
     }
     
@@ -549,49 +634,74 @@ void MainComponent::getNextAudioBlock(const juce::AudioSourceChannelInfo &buffer
     juce::AudioSourceChannelInfo info(&readBuffer, bufferToFill.startSample, bufferToFill.numSamples);
 
     // If standalone mode is active, or the loaded clip has no audio, exit this routine.
-    if (!b_standalone_mode || !currentMedia.hasAudio()) {
+    if (!b_standalone_mode || !currentMedia.hasAudioRealtime()) {
         return;
     }
 
-    // then read audio source
-    setDetectedInputChannelCount(currentMedia.getNumChannels());
+    // Pick up the latest published decode/transcode config; it stays alive until we release it
+    RealtimeSnapshot<AudioDecodeConfig>::ScopedAccess config(audioConfig);
+    pickUpAudioConfig(config.get());
+    auto *rendered_config = configHandover.getRenderedConfig();
+    if (rendered_config == nullptr || rendered_config->numInputChannels != currentMedia.getNumChannels()) {
+        // no config has been built for this media yet
+        bufferToFill.clearActiveBufferRegion();
+        return;
+    }
+    activeConfig = rendered_config;
+    const int numInputChannels = activeConfig->numInputChannels;
 
-    readBuffer.setSize(detectedNumInputChannels, bufferToFill.numSamples);
+    // Buffers are preallocated in prepareToPlay(), refuse anything that would make them grow here
+    if (numInputChannels > MAX_INPUT_CHANNELS || bufferToFill.numSamples > blockSize) {
+        bufferToFill.clearActiveBufferRegion();
+        activeConfig = nullptr;
+        return;
+    }
+
+    // then read audio source
+    readBuffer.setSize(numInputChannels, bufferToFill.numSamples, false, false, true);
     readBuffer.clear();
 
     // the AudioTransportSource takes care of start, stop and resample
-    if (currentMedia.hasAudio())
+    if (currentMedia.hasAudioRealtime())
     {
         // TODO: fix for mono audio files
-        currentMedia.getNextAudioBlock(info);
-
-        tempBuffer.setSize(detectedNumInputChannels * 2, bufferToFill.numSamples);
-        tempBuffer.clear();
+        {
+            CallbackProfiler::ScopedStage stage(callbackProfiler, CallbackProfiler::StageMediaPull);
+            currentMedia.getNextAudioBlock(info);
+        }
+        const int media_underruns = currentMedia.getAudioBufferStats().underruns;
+        if (media_underruns != lastMediaUnderruns) {
+            lastMediaUnderruns = media_underruns;
+            audioEvents.post(AudioEventQueue::Underrun, media_underruns);
+        }
+        {
+            // input meters show the media before the volume, which the decode applies
+            CallbackProfiler::ScopedStage stage(callbackProfiler, CallbackProfiler::StageMeter);
+            channelMeters.measureInputs(readBuffer.getArrayOfReadPointers(), numInputChannels, bufferToFill.numSamples);
+        }
 
-        if (detectedNumInputChannels <= 0) {
+        if (numInputChannels <= 0) {
             bufferToFill.clearActiveBufferRegion();
+            activeConfig = nullptr;
             return;
         }
 
-        // if you've got more output channels than input clears extra outputs
-        for (auto channel = detectedNumInputChannels; channel < 2 && channel < detectedNumInputChannels; ++channel) {
-            readBuffer.clear(channel, 0, bufferToFill.numSamples);
+        // Processing loop
+        renderAudioConfig(bufferToFill, info);
+        if (configHandover.getFadingConfig() != nullptr) {
+            crossfadeFromPreviousConfig(bufferToFill, info);
         }
+        rendered_config->startRampsSettled = false;
 
-        // config transcode
-        if (pendingFormatChange ||
-            m1Transcode.getFormatName(m1Transcode.getInputFormat()) != selectedInputFormat ||
-            m1Transcode.getFormatName(m1Transcode.getOutputFormat()) != selectedOutputFormat) {
-            reconfigureAudioTranscode();
-            reconfigureAudioDecode();
+        {
+            CallbackProfiler::ScopedStage stage(callbackProfiler, CallbackProfiler::StageMeter);
+            channelMeters.measureOutputs(bufferToFill.buffer->getArrayOfReadPointers(), bufferToFill.buffer->getNumChannels(),
+                                         bufferToFill.startSample, bufferToFill.numSamples);
+            channelMeters.endBlock(bufferToFill.numSamples);
         }
 
-        // Processing loop
-        (this->*m_transcode_strategy)(bufferToFill, info);
-        (this->*m_decode_strategy)(bufferToFill, info);
-
         // clear remaining input channels
-        for (auto channel = 2; channel < detectedNumInputChannels; ++channel) {
+        for (auto channel = 2; channel < numInputChannels; ++channel) {
             readBuffer.clear(channel, 0, bufferToFill.numSamples);
         }
     }
@@ -600,6 +710,63 @@ void MainComponent::getNextAudioBlock(const juce::AudioSourceChannelInfo &buffer
         // no audio, clear the buffer
         bufferToFill.clearActiveBufferRegion();
     }
+
+    activeConfig = nullptr;
+}
+
+void MainComponent::renderAudioConfig(const AudioSourceChannelInfo &bufferToFill, const AudioSourceChannelInfo &info) {
+    {
+        CallbackProfiler::ScopedStage stage(callbackProfiler, CallbackProfiler::StageTranscode);
+        (this->*(activeConfig->transcodeStrategy))(bufferToFill, info);
+    }
+    {
+        CallbackProfiler::ScopedStage stage(callbackProfiler, CallbackProfiler::StageDecode);
+        activeListener = &activeConfig->listeners[0];
+        (this->*(activeConfig->decodeStrategy))(bufferToFill, info);
+
+        // every further listener only reruns the decode, into its own output pair
+        auto *device = bufferToFill.buffer;
+        for (int index = 1; index < (int) activeConfig->listeners.size() && index * 2 + 1 < device->getNumChannels(); ++index) {
+            float *pair[2] = { device->getWritePointer(index * 2, bufferToFill.startSample),
+                               device->getWritePointer(index * 2 + 1, bufferToFill.startSample) };
+            juce::AudioBuffer<float> listenerBuffer(pair, 2, bufferToFill.numSamples); // refers to the device channels
+            const AudioSourceChannelInfo listenerInfo(&listenerBuffer, 0, bufferToFill.numSamples);
+            activeListener = &activeConfig->listeners[(size_t) index];
+            (this->*(activeConfig->decodeStrategy))(listenerInfo, info);
+        }
+        activeListener = nullptr;
+    }
+}
+
+void MainComponent::pickUpAudioConfig(AudioDecodeConfig *latest) {
+    if (!configHandover.pickUp(latest, currentMedia.getNumChannels()) || latest == nullptr) {
+        return;
+    }
+
+    const int output_channels = latest->numSpeakerChannels > 0 ? latest->numSpeakerChannels : (int) latest->listeners.size() * 2;
+    audioEvents.post(AudioEventQueue::FormatChange, latest->numInputChannels, output_channels);
+    lastPostedError = -1; // report errors of the new config straight away
+}
+
+void MainComponent::crossfadeFromPreviousConfig(const AudioSourceChannelInfo &bufferToFill, const AudioSourceChannelInfo &info) {
+    const int sample_count = bufferToFill.numSamples;
+    const int channel_count = juce::jmin(bufferToFill.buffer->getNumChannels(), (int) MAX_OUTPUT_CHANNELS);
+
+    // the outgoing config renders the same input block into its own buffer
+    crossfadeBuffer.setSize(channel_count, sample_count, false, false, true);
+    crossfadeBuffer.clear();
+    const AudioSourceChannelInfo fadeInfo(&crossfadeBuffer, 0, sample_count);
+    auto *incoming = activeConfig;
+    activeConfig = configHandover.getFadingConfig();
+    renderAudioConfig(fadeInfo, info);
+    activeConfig = incoming;
+
+    const auto fade = configHandover.advanceFade(sample_count);
+    for (int channel = 0; channel < channel_count; ++channel) {
+        bufferToFill.buffer->applyGainRamp(channel, bufferToFill.startSample, fade.numSamples, fade.incomingStart, fade.incomingEnd);
+        bufferToFill.buffer->addFromWithRamp(channel, bufferToFill.startSample, crossfadeBuffer.getReadPointer(channel),
+                                             fade.numSamples, fade.outgoingStart, fade.outgoingEnd);
+    }
 }
 
 void MainComponent::releaseResources() {
@@ -783,6 +950,8 @@ void MainComponent::syncWithDAWPlayhead()
 }
 
 void MainComponent::draw_orientation_client(murka::Murka &m, M1OrientationClient &m1OrientationClient) {
+    // the window reads the client while it draws
+    const juce::ScopedLock clientLock(orientationClientLock);
     std::vector<M1OrientationClientWindowDeviceSlot> slots;
 
     std::vector<M1OrientationDeviceInfo> devices = m1OrientationClient.getDevices();
@@ -896,6 +1065,17 @@ void MainComponent::draw()
     auto vid_rot = Mach1::Float3{ videoPlayerWidget.rotationCurrent.x, videoPlayerWidget.rotationCurrent.y, videoPlayerWidget.rotationCurrent.z }.EulerRadians();
     currentOrientation.SetRotation(vid_rot);
 
+    {
+        // hand the mouse/UI orientation to pollOrientation(), with the tracker reading already
+        // folded into it; the poller adds the tracker movement since then itself
+        auto ori_deg = currentOrientation.GetGlobalRotationAsEulerDegrees();
+        auto client_deg = previousClientOrientation.GetGlobalRotationAsEulerDegrees();
+        const OrientationBase next { ori_deg.GetYaw(), ori_deg.GetPitch(), ori_deg.GetRoll(),
+                                     client_deg.GetYaw(), client_deg.GetPitch(), client_deg.GetRoll() };
+        const juce::SpinLock::ScopedLockType lock(orientationBaseLock);
+        orientationBase = next;
+    }
+
     if (playerOSC->IsConnected() && playerOSC->IsActivePlayer()) 
     {
         // send the current orientation of player instead
@@ -913,34 +1093,38 @@ void MainComponent::draw()
         prev_mouse_offset = videoPlayerWidget.rotationOffsetMouse;
     }
 
-    if (m1OrientationClient.isConnectedToServer()) {
-        // add server orientation to player via a calculated offset
-        Mach1::Orientation oc_orientation = m1OrientationClient.getOrientation();
-        Mach1::Quaternion ori_quat = oc_orientation.GetGlobalRotationAsQuaternion();
-        Mach1::Float3 ori_vec_deg = oc_orientation.GetGlobalRotationAsEulerDegrees();
-        Mach1::Quaternion last_quat = previousClientOrientation.GetGlobalRotationAsQuaternion();
-
-        if (!ori_quat.IsApproximatelyEqual(last_quat)) {
-            Mach1::Float3 last_vec_deg = previousClientOrientation.GetGlobalRotationAsEulerDegrees();
-
-            // update the player orientation
-            DBG("OM-Client:        Y=" + std::to_string(ori_vec_deg.GetYaw()) + ", P=" + std::to_string(ori_vec_deg.
-                GetPitch()) + ", R=" + std::to_string(ori_vec_deg.GetRoll()));
-            videoPlayerWidget.rotationOffset.x += m1OrientationClient.getTrackingYawEnabled()
-                                                      ? ori_vec_deg.GetYaw() - last_vec_deg.GetYaw()
-                                                      : 0.0f;
-            videoPlayerWidget.rotationOffset.y += m1OrientationClient.getTrackingPitchEnabled()
-                                                      ? ori_vec_deg.GetPitch() - last_vec_deg.GetPitch()
-                                                      : 0.0f;
-            videoPlayerWidget.rotationOffset.z += m1OrientationClient.getTrackingRollEnabled()
-                                                      ? ori_vec_deg.GetRoll() - last_vec_deg.GetRoll()
-                                                      : 0.0f;
-            DBG("OM-Client Offset: Y=" + std::to_string(ori_vec_deg.GetYaw() - last_vec_deg.GetYaw()) + ", P=" + std::
-                to_string(ori_vec_deg.GetPitch() - last_vec_deg.GetPitch()) + ", R=" + std::to_string(ori_vec_deg.
-                    GetRoll() - last_vec_deg.GetRoll()));
-
-            // store last input value
-            previousClientOrientation = oc_orientation;
+    {
+        // the poller reads the client too
+        const juce::ScopedLock clientLock(orientationClientLock);
+        if (m1OrientationClient.isConnectedToServer()) {
+            // add server orientation to player via a calculated offset
+            Mach1::Orientation oc_orientation = m1OrientationClient.getOrientation();
+            Mach1::Quaternion ori_quat = oc_orientation.GetGlobalRotationAsQuaternion();
+            Mach1::Float3 ori_vec_deg = oc_orientation.GetGlobalRotationAsEulerDegrees();
+            Mach1::Quaternion last_quat = previousClientOrientation.GetGlobalRotationAsQuaternion();
+
+            if (!ori_quat.IsApproximatelyEqual(last_quat)) {
+                Mach1::Float3 last_vec_deg = previousClientOrientation.GetGlobalRotationAsEulerDegrees();
+
+                // update the player orientation
+                DBG("OM-Client:        Y=" + std::to_string(ori_vec_deg.GetYaw()) + ", P=" + std::to_string(ori_vec_deg.
+                    GetPitch()) + ", R=" + std::to_string(ori_vec_deg.GetRoll()));
+                videoPlayerWidget.rotationOffset.x += m1OrientationClient.getTrackingYawEnabled()
+                                                          ? ori_vec_deg.GetYaw() - last_vec_deg.GetYaw()
+                                                          : 0.0f;
+                videoPlayerWidget.rotationOffset.y += m1OrientationClient.getTrackingPitchEnabled()
+                                                          ? ori_vec_deg.GetPitch() - last_vec_deg.GetPitch()
+                                                          : 0.0f;
+                videoPlayerWidget.rotationOffset.z += m1OrientationClient.getTrackingRollEnabled()
+                                                          ? ori_vec_deg.GetRoll() - last_vec_deg.GetRoll()
+                                                          : 0.0f;
+                DBG("OM-Client Offset: Y=" + std::to_string(ori_vec_deg.GetYaw() - last_vec_deg.GetYaw()) + ", P=" + std::
+                    to_string(ori_vec_deg.GetPitch() - last_vec_deg.GetPitch()) + ", R=" + std::to_string(ori_vec_deg.
+                        GetRoll() - last_vec_deg.GetRoll()));
+
+                // store last input value
+                previousClientOrientation = oc_orientation;
+            }
         }
     }
     
@@ -980,6 +1164,16 @@ void MainComponent::draw()
         100
     };
 
+    bool trackerConnected = false;
+    float trackerYaw = 0.0f;
+    {
+        const juce::ScopedLock clientLock(orientationClientLock);
+        trackerConnected = m1OrientationClient.isConnectedToDevice();
+        if (trackerConnected) {
+            trackerYaw = m1OrientationClient.getOrientation().GetGlobalRotationAsEulerDegrees().GetYaw();
+        }
+    }
+
     auto& playerControls = m.prepare<M1PlayerControls>(playerControlShape);
     if (b_standalone_mode) { // Standalone mode
         double currentPosition = 0.0;
@@ -990,8 +1184,8 @@ void MainComponent::draw()
                         true, // showPositionReticle
                         currentPosition, // currentPosition
                         currentMedia.isPlaying(), // playing
-                        m1OrientationClient.isConnectedToDevice(), // connected to device
-                        (m1OrientationClient.isConnectedToDevice()) ? m1OrientationClient.getOrientation().GetGlobalRotationAsEulerDegrees().GetYaw() : 0.0f,
+                        trackerConnected, // connected to device
+                        trackerYaw,
                         [&]() {
                             // playButtonPress
                             if (currentMedia.isPlaying()) {
@@ -1045,8 +1239,8 @@ void MainComponent::draw()
                         false, // showPositionReticle
                         0, // currentPosition
                         currentMedia.isPlaying(), // playing
-                        m1OrientationClient.isConnectedToDevice(), // connected to device
-                        (m1OrientationClient.isConnectedToDevice()) ? m1OrientationClient.getOrientation().GetGlobalRotationAsEulerDegrees().GetYaw() : 0.0f,
+                        trackerConnected, // connected to device
+                        trackerYaw,
                         [&]() {
                             // playButtonPress
                             // blocked since control should only be from DAW side
@@ -1222,18 +1416,30 @@ void MainComponent::draw()
         bShowHelpUI = !bShowHelpUI;
     }
 
+    if (m.isKeyPressed('m')) {
+        bShowMeters = !bShowMeters;
+    }
+
+    // toggles extrapolating the head-tracked orientation to the audio output time
+    if (m.isKeyPressed('p')) {
+        predictOrientation = !predictOrientation.load();
+    }
+
     // Quick mute for Yaw orientation input from device
     if (m.isKeyPressed('j')) {
+        const juce::ScopedLock clientLock(orientationClientLock);
         m1OrientationClient.command_setTrackingYawEnabled(!m1OrientationClient.getTrackingYawEnabled());
     }
 
     // Quick mute for Pitch orientation input from device
     if (m.isKeyPressed('k')) {
+        const juce::ScopedLock clientLock(orientationClientLock);
         m1OrientationClient.command_setTrackingPitchEnabled(!m1OrientationClient.getTrackingPitchEnabled());
     }
 
     // Quick mute for Roll orientation input from device
     if (m.isKeyPressed('l')) {
+        const juce::ScopedLock clientLock(orientationClientLock);
         m1OrientationClient.command_setTrackingRollEnabled(!m1OrientationClient.getTrackingRollEnabled());
     }
 
@@ -1303,6 +1509,10 @@ void MainComponent::draw()
         m.getCurrentFont()->drawString("FOV : " + std::to_string(videoPlayerWidget.fov), 10, 10);
         m.getCurrentFont()->drawString("Frame: " + std::to_string(currentMedia.getPositionInSeconds()), 10, 30);
         m.getCurrentFont()->drawString("Standalone mode: " + std::to_string(b_standalone_mode), 10, 50);
+        auto audioBufferStats = currentMedia.getAudioBufferStats();
+        m.getCurrentFont()->drawString("Audio buffer: " + std::to_string(audioBufferStats.fillFrames) + " / " + std::to_string(audioBufferStats.targetFrames) + " frames", 10, 70);
+        m.getCurrentFont()->drawString("Underruns: " + std::to_string(audioUnderruns) + " Overruns: " + std::to_string(audioBufferStats.overruns), 10, 90);
+        m.getCurrentFont()->drawString("Deadline misses: " + std::to_string(audioDeadlineMisses) + " Channels: " + audioFormatInfo, 10, 110);
         m.getCurrentFont()->drawString("Hotkeys:", 10, 130);
         m.getCurrentFont()->drawString("[w] - FOV+", 10, 150);
         m.getCurrentFont()->drawString("[s] - FOV-", 10, 170);
@@ -1310,14 +1520,47 @@ void MainComponent::draw()
         m.getCurrentFont()->drawString("[g] - Overlay 2D Reference", 10, 210);
         m.getCurrentFont()->drawString("[o] - Overlay Reference", 10, 230);
         m.getCurrentFont()->drawString("[d] - Cycle stereoscopic modes (Off/TB/LR)", 10, 250);
+        m.getCurrentFont()->drawString(std::string("[p] - Orientation prediction: ") + (predictOrientation.load() ? "ON" : "OFF"), 10, 270);
         m.getCurrentFont()->drawString("[h] - Hide UI", 10, 290);
         m.getCurrentFont()->drawString("[Arrow Keys] - Orientation Resets", 10, 310);
+        m.getCurrentFont()->drawString("[m] - Level meters", 10, 330);
 
         auto ori_deg = currentOrientation.GetGlobalRotationAsEulerDegrees();
         m.getCurrentFont()->drawString("OverlayCoords:", 10, 350);
         m.getCurrentFont()->drawString("Y: " + std::to_string(ori_deg.GetYaw()), 10, 370);
         m.getCurrentFont()->drawString("P: " + std::to_string(ori_deg.GetPitch()), 10, 390);
         m.getCurrentFont()->drawString("R: " + std::to_string(ori_deg.GetRoll()), 10, 410);
+
+        auto percent = [](float load) { return std::to_string(juce::roundToInt(load * 100.0f)) + "%"; };
+        const auto callbackWindow = callbackProfiler.getLatestWindow();
+        const auto totalHistogram = callbackProfiler.getHistogram(CallbackProfiler::StageTotal);
+        m.getCurrentFont()->drawString("Audio callback load:", 10, 450);
+        m.getCurrentFont()->drawString("avg " + percent(callbackWindow.averageLoad) + " peak " + percent(callbackWindow.peakLoad)
+                                       + " p99 " + percent(totalHistogram.getPercentileLoad(0.99f)), 10, 470);
+        m.getCurrentFont()->drawString("Deadline misses: " + std::to_string(callbackProfiler.getDeadlineMisses()) + " / "
+                                       + std::to_string(callbackProfiler.getTotalBlocks()) + " blocks", 10, 490);
+        std::string stageLoads = "p99";
+        for (int stage = CallbackProfiler::StageMediaPull; stage < CallbackProfiler::StageTotal; ++stage) {
+            stageLoads += std::string(" ") + CallbackProfiler::getStageName(stage) + " "
+                        + percent(callbackProfiler.getHistogram(stage).getPercentileLoad(0.99f));
+        }
+        m.getCurrentFont()->drawString(stageLoads, 10, 510);
+        if (callbackWindow.numWorst > 0) {
+            const auto &worst = callbackWindow.worst[0];
+            m.getCurrentFont()->drawString("Worst block: " + percent(worst.stageLoad[CallbackProfiler::StageTotal])
+                                           + " (" + std::to_string(worst.numSamples) + " samples, decode "
+                                           + percent(worst.stageLoad[CallbackProfiler::StageDecode]) + ")", 10, 530);
+        }
+    }
+
+    if (!bHideUI && bShowMeters && currentMedia.clipLoaded() && currentMedia.hasAudio()) {
+        // one bar per input channel plus the outputs, kept readable up to 64 channels
+        const float metersWidth = std::min(520.0f, m.getWindowWidth() * 0.5f);
+        const float metersHeight = 120;
+        MurkaShape metersShape = { m.getWindowWidth() - metersWidth - 20, 50, metersWidth, metersHeight };
+        m.setColor(20, 20, 20, 200);
+        m.drawRectangle(metersShape.position.x - 8, metersShape.position.y - 8, metersWidth + 16, metersHeight + 16);
+        m.prepare<M1LevelMeters>(metersShape).withLevels(channelMeters.getLevels()).draw();
     }
 
     std::function<void()> deleteTheSettingsButton = [&]() {
@@ -1394,8 +1637,7 @@ void MainComponent::draw()
             
             if (formatSelectorMenu.changed)
             {
-                const juce::ScopedLock audioLock(audioCallbackLock);
-                
+                // publishes a new config to the audio thread, no need to hold audioCallbackLock
                 setTranscodeInputFormat(currentFormatOptions[formatSelectorMenu.selectedOption]);
             }
         }
@@ -1739,6 +1981,9 @@ void MainComponent::draw()
         }
     }
     
+    // Pick up errors and conditions raised on the audio thread
+    audioEvents.drain([this] (const AudioEventQueue::Event& event) { handleAudioEvent(event); });
+
     // Display error popup
     if (showErrorPopup) {
         // reset font size
@@ -1809,20 +2054,153 @@ std::string MainComponent::getTranscodeOutputFormat() const {
 }
 
 void MainComponent::setTranscodeInputFormat(const std::string &name) {
-    if (!name.empty() && m1Transcode.getFormatFromString(name) != -1) {
-        // Queue the format change instead of applying immediately
-        m1Transcode.setInputFormat(m1Transcode.getFormatFromString(name));
+    if (!name.empty() && m1Transcode.getFormatFromString(name) != -1 && name != selectedInputFormat) {
         selectedInputFormat = name;
-        pendingFormatChange = true;
+        rebuildAudioConfig();
+    }
+}
+
+void MainComponent::setSpeakerLayout(const std::string &name) {
+    if (name != selectedSpeakerLayout) {
+        selectedSpeakerLayout = name;
+        rebuildAudioConfig();
     }
 }
 
+void MainComponent::setParallelTranscode(bool enabled) {
+    if (enabled == useParallelTranscode) {
+        return;
+    }
+    useParallelTranscode = enabled;
+
+    if (enabled) {
+        // leave a core for the message thread and libVLC
+        const int workers = juce::jlimit(0, MAX_TRANSCODE_WORKERS, juce::SystemStats::getNumPhysicalCpus() - 1);
+        const double blockPeriod = (sampleRate > 0.0 && blockSize > 0) ? blockSize / sampleRate : 0.003;
+        transcodeWorkers.start(workers, blockPeriod);
+        rebuildAudioConfig();
+    } else {
+        rebuildAudioConfig(); // until it is picked up, the audio thread runs all the tasks of the config playing now
+        transcodeWorkers.stop();
+    }
+}
+
+void MainComponent::setHrtfConvolution(bool enabled) {
+    if (enabled != useHrtfConvolution) {
+        useHrtfConvolution = enabled;
+        saveHrtfSettings();
+        rebuildAudioConfig();
+    }
+}
+
+void MainComponent::loadHrtfFilters(const juce::File &file) {
+    hrtfFilterFile = file;
+    if (sampleRate <= 0.0) {
+        return; // prepared by timerCallback() once the device runs
+    }
+
+    hrtfFiltersLoading = true;
+    hrtfFilterLoader.load(file, sampleRate, [this](std::shared_ptr<const BinauralConvolver::Filters> filters, const juce::String &error) {
+        hrtfFiltersLoading = false;
+        if (filters == nullptr) {
+            useHrtfConvolution = false;
+            saveHrtfSettings();
+            showErrorPopup = true;
+            errorMessage = "HRTF ERROR";
+            errorMessageInfo = error.toStdString();
+            errorStartTime = std::chrono::steady_clock::now();
+            menuItemsChanged();
+            return;
+        }
+
+        hrtfFilters = std::move(filters);
+        useHrtfConvolution = true;
+        selectedSpeakerLayout.clear();
+        saveHrtfSettings();
+        rebuildAudioConfig();
+        menuItemsChanged();
+    });
+}
+
+void MainComponent::showHrtfFileChooser() {
+    file_chooser = std::make_unique<juce::FileChooser>(
+        "Select an HRTF filter set (L/R pair per M1Spatial speaker)...",
+        hrtfFilterFile.existsAsFile() ? hrtfFilterFile.getParentDirectory()
+                                      : juce::File::getSpecialLocation(juce::File::userHomeDirectory),
+        "*.wav;*.aif;*.aiff;*.flac",
+        true);
+
+    file_chooser->launchAsync(juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+                              [this](const juce::FileChooser &fc) {
+        auto file = fc.getResult();
+        if (file.existsAsFile()) {
+            loadHrtfFilters(file);
+        }
+    });
+}
+
+void MainComponent::setDecodeCoeffTable(bool enabled) {
+    if (enabled != useDecodeCoeffTable) {
+        useDecodeCoeffTable = enabled;
+        if (appProperties != nullptr) {
+            appProperties->setValue("decodeCoeffTable", useDecodeCoeffTable);
+            appProperties->save();
+        }
+        rebuildAudioConfig();
+    }
+}
+
+void MainComponent::handleAudioEvent(const AudioEventQueue::Event& event) {
+    switch (event.type) {
+        case AudioEventQueue::ErrorOutput:
+            showErrorPopup = true;
+            errorMessage = "OUTPUT ERROR";
+            errorMessageInfo = "No valid audio strategy available.";
+            errorStartTime = std::chrono::steady_clock::now();
+            break;
+        case AudioEventQueue::ErrorTranscode:
+            showErrorPopup = true;
+            errorMessage = "TRANSCODE ERROR";
+            errorMessageInfo = "No valid transcode conversion path found.";
+            errorStartTime = std::chrono::steady_clock::now();
+            break;
+        case AudioEventQueue::FormatChange:
+            audioFormatInfo = std::to_string(event.value) + " in / " + std::to_string(event.detail) + " out";
+            break;
+        case AudioEventQueue::DeadlineMiss:
+            ++audioDeadlineMisses;
+            break;
+        case AudioEventQueue::Underrun:
+            audioUnderruns = event.value;
+            break;
+    }
+}
+
+void MainComponent::setNumListeners(int count) {
+    count = juce::jlimit(1, (int) MAX_LISTENERS, count);
+    if (count != numListeners) {
+        numListeners = count;
+        if (appProperties != nullptr) {
+            appProperties->setValue("listeners", numListeners);
+            appProperties->save();
+        }
+        rebuildAudioConfig();
+    }
+}
+
+void MainComponent::saveHrtfSettings() {
+    if (appProperties == nullptr) {
+        return;
+    }
+    appProperties->setValue("hrtfFilterFile", hrtfFilterFile.getFullPathName());
+    appProperties->setValue("hrtfConvolution", useHrtfConvolution);
+    appProperties->save();
+}
+
 void MainComponent::setTranscodeOutputFormat(const std::string &name) {
-    if (!name.empty() && m1Transcode.getFormatFromString(name) != -1) {
-        // Queue the format change instead of applying immediately
-        m1Transcode.setOutputFormat(m1Transcode.getFormatFromString(name));
+    if (!name.empty() && m1Transcode.getFormatFromString(name) != -1 && name != selectedOutputFormat) {
         selectedOutputFormat = name;
-        pendingFormatChange = true;
+        rebuildAudioConfig();
     }
 }
 
@@ -1832,11 +2210,93 @@ void MainComponent::timerCallback() {
     playerOSC->update(); // test for connection
     secondsWithoutMouseMove += 1;
 
+    // filter spectra are prepared for one sample rate, redo them when the device rate changes
+    if (useHrtfConvolution && !hrtfFiltersLoading && hrtfFilterFile.existsAsFile() && sampleRate > 0.0
+        && (hrtfFilters == nullptr || hrtfFilters->sampleRate != sampleRate)) {
+        loadHrtfFilters(hrtfFilterFile);
+    }
+
+    // the config's gain ramps are prepared for the device rate it was requested at
+    if (audioConfigRequested && sampleRate > 0.0 && sampleRate != audioConfigSampleRate) {
+        rebuildAudioConfig();
+    }
+
     // Update last known position if media is loaded
     if (currentMedia.clipLoaded()) {
         lastKnownMediaPlayState = currentMedia.isPlaying();
         lastKnownMediaPosition = currentMedia.getPositionInSeconds();
+
+        // pick up channel counts that libVLC only reports once playback has started
+        if (currentMedia.hasAudio()) {
+            const juce::ScopedLock renderLock(renderCallbackLock);
+            setDetectedInputChannelCount(currentMedia.getNumChannels());
+        }
+    }
+
+    // free decode configs the audio thread has moved on from
+    audioConfig.reclaim();
+
+    sendCallbackStats();
+}
+
+void MainComponent::sendCallbackStats() {
+    if (!playerOSC->IsConnected() || !playerOSC->IsActivePlayer()) {
+        return;
+    }
+
+    const auto window = callbackProfiler.getLatestWindow();
+    const auto total = callbackProfiler.getHistogram(CallbackProfiler::StageTotal);
+
+    PlayerOSC::CallbackStats stats;
+    stats.inputFormat = selectedInputFormat;
+    stats.numInputChannels = detectedNumInputChannels;
+    stats.blockSize = blockSize;
+    stats.sampleRate = (float) sampleRate;
+    stats.averageLoad = window.averageLoad;
+    stats.peakLoad = window.peakLoad;
+    stats.p99Load = total.getPercentileLoad(0.99f);
+    stats.windowDeadlineMisses = window.deadlineMisses;
+    stats.totalDeadlineMisses = (int) callbackProfiler.getDeadlineMisses();
+    stats.totalBlocks = (int) callbackProfiler.getTotalBlocks();
+    for (int stage = CallbackProfiler::StageMediaPull; stage < CallbackProfiler::StageTotal; ++stage) {
+        stats.stageP99Load[stage] = callbackProfiler.getHistogram(stage).getPercentileLoad(0.99f);
+    }
+    playerOSC->sendCallbackStats(stats);
+}
+
+void MainComponent::pollOrientation() {
+    // stamped on arrival: the poll runs every millisecond, so a new tracker reading is pushed
+    // at most one poll after the client received it, whatever the frame rate
+    const double arrival = OrientationChannel::now();
+
+    OrientationBase base;
+    {
+        const juce::SpinLock::ScopedLockType lock(orientationBaseLock);
+        base = orientationBase;
+    }
+
+    float yaw = base.yaw, pitch = base.pitch, roll = base.roll;
+    {
+        // draw() holds this while it uses the client; catch the reading on the next poll
+        const juce::ScopedTryLock clientLock(orientationClientLock);
+        if (!clientLock.isLocked()) {
+            return;
+        }
+        if (m1OrientationClient.isConnectedToServer()) {
+            // the tracker movement since the reading draw() folded into the base
+            Mach1::Float3 client_deg = m1OrientationClient.getOrientation().GetGlobalRotationAsEulerDegrees();
+            if (m1OrientationClient.getTrackingYawEnabled()) {
+                yaw += client_deg.GetYaw() - base.clientYaw;
+            }
+            if (m1OrientationClient.getTrackingPitchEnabled()) {
+                pitch += client_deg.GetPitch() - base.clientPitch;
+            }
+            if (m1OrientationClient.getTrackingRollEnabled()) {
+                roll += client_deg.GetRoll() - base.clientRoll;
+            }
+        }
     }
+    orientationChannel.push(yaw, pitch, roll, arrival);
 }
 
 //==============================================================================
@@ -1850,92 +2310,249 @@ void MainComponent::resized()
     // This is called when the MainComponent is resized.
 }
 
-void MainComponent::reconfigureAudioDecode() {
+void MainComponent::reconfigureAudioDecode(AudioDecodeConfig& config) {
+    // only kept when one of the convolution strategies is picked below
+    auto filters = std::move(config.hrtfFilters);
+
     // Setup for Mach1Decode API
-    m1Decode.setPlatformType(Mach1PlatformDefault);
-    m1Decode.setFilterSpeed(0.99f);
+    DecodeChain::initialiseDecode(config.decode);
 
-    switch (detectedNumInputChannels) {
+    // speaker feeds come straight out of the transcode, no binaural decode
+    if (config.numSpeakerChannels > 0) {
+        config.transcodeStrategy = &MainComponent::noTranscodeStrategy;
+        config.decodeStrategy = &MainComponent::speakerLayoutStrategy;
+        return;
+    }
+
+    switch (config.numInputChannels) {
         case 0:
-            m_decode_strategy = &MainComponent::nullStrategy;
+            config.decodeStrategy = &MainComponent::nullStrategy;
             break;
         case 1:
-            m_decode_strategy = &MainComponent::monoDecodeStrategy;
+            config.decodeStrategy = &MainComponent::monoDecodeStrategy;
             break;
         case 2:
-            m_decode_strategy = &MainComponent::stereoDecodeStrategy;
+            config.decodeStrategy = &MainComponent::stereoDecodeStrategy;
             break;
         default:
             // For any multichannel input (>2), use intermediary buffer strategy
-            if (detectedNumInputChannels == 4 && selectedInputFormat == "M1Spatial-4") {
-                m1Decode.setDecodeMode(M1DecodeSpatial_4);
-                m_decode_strategy = &MainComponent::readBufferDecodeStrategy; // decode directly to buffer
-            } else if (detectedNumInputChannels == 8 && selectedInputFormat == "M1Spatial-8") {
-                m1Decode.setDecodeMode(M1DecodeSpatial_8);
-                m_decode_strategy = &MainComponent::readBufferDecodeStrategy; // decode directly to buffer
+            Mach1DecodeMode mode = M1DecodeSpatial_14;
+            const bool spatial_input = DecodeChain::getDecodeMode(config.inputFormat, mode);
+            if (spatial_input) {
+                config.decode.setDecodeMode(mode);
+            }
+            if (spatial_input && config.decode.getFormatChannelCount() == config.numInputChannels) {
+                config.decodeStrategy = &MainComponent::readBufferDecodeStrategy; // decode directly to buffer
             } else {
-                m1Decode.setDecodeMode(M1DecodeSpatial_14);
-                if (selectedInputFormat == "M1Spatial-14") {
-                    m_decode_strategy = &MainComponent::readBufferDecodeStrategy; // decode directly to buffer
+                // decode to intermediary buffer for transcoding, matching the transcode output format
+                mode = M1DecodeSpatial_14;
+                DecodeChain::getDecodeMode(config.outputFormat, mode);
+                config.decode.setDecodeMode(mode);
+                config.decodeStrategy = &MainComponent::intermediaryBufferDecodeStrategy;
+
+                // the transcode matrix is known, skip the intermediary M1Spatial buffer entirely
+                if (useFusedTranscodeDecode && config.conversionOutputChannels == config.decode.getFormatChannelCount()) {
+                    config.transcodeStrategy = &MainComponent::noTranscodeStrategy;
+                    config.decodeStrategy = &MainComponent::fusedTranscodeDecodeStrategy;
+
+                    // full-order ambisonics can be rotated before the transcode instead
+                    const int order = AmbisonicRotation::getOrderForFormat(config.inputFormat, config.numInputChannels);
+                    if (order > 0 && prepareAmbisonicRotation(config, order)) {
+                        config.decodeStrategy = &MainComponent::ambisonicRotationDecodeStrategy;
+                    }
+                }
+            }
+
+            // convolve the M1Spatial speaker feeds instead of amplitude panning them
+            if (filters != nullptr && filters->numSpeakers == config.decode.getFormatChannelCount()) {
+                config.hrtfFilters = std::move(filters);
+                if (config.decodeStrategy == &MainComponent::readBufferDecodeStrategy) {
+                    config.decodeStrategy = &MainComponent::readBufferConvolutionStrategy;
                 } else {
-                    m_decode_strategy = &MainComponent::intermediaryBufferDecodeStrategy; // decode to intermediary buffer for transcoding
+                    // the filters need the speaker feeds, so the transcode cannot be fused away
+                    if (config.decodeStrategy == &MainComponent::fusedTranscodeDecodeStrategy
+                        || config.decodeStrategy == &MainComponent::ambisonicRotationDecodeStrategy) {
+                        config.transcodeStrategy = &MainComponent::intermediaryBufferTranscodeStrategy;
+                    }
+                    config.decodeStrategy = &MainComponent::intermediaryBufferConvolutionStrategy;
                 }
             }
             break;
     }
+
+    // the blocks interpolate Mach1Decode's coeffs from the grid instead of calling it
+    if (config.useDecodeCoeffTable && config.numInputChannels > 2
+        && config.decodeStrategy != &MainComponent::ambisonicRotationDecodeStrategy) {
+        config.decodeCoeffTable = getDecodeCoeffTable(config.decode.getFormatChannelCount());
+    }
+
+    // pick the stereo mix kernel here once, rather than branching on the channel count per block
+    config.setMixChannelCount(config.decodeStrategy == &MainComponent::intermediaryBufferDecodeStrategy
+                                  ? config.decode.getFormatChannelCount()
+                                  : config.numInputChannels);
+}
+
+std::shared_ptr<const DecodeCoeffTable> MainComponent::getDecodeCoeffTable(int formatChannelCount) {
+    const int mode = formatChannelCount == 4 ? 0 : formatChannelCount == 8 ? 1 : 2;
+    if (decodeCoeffTables[mode] == nullptr) {
+        auto table = DecodeChain::createDecodeCoeffTable(formatChannelCount);
+        DBG("Decode coeff table for " + juce::String(formatChannelCount) + " channels: "
+            + juce::String((int) (table->getSizeInBytes() / 1024)) + "KB");
+        decodeCoeffTables[mode] = std::move(table);
+    }
+    return decodeCoeffTables[mode];
+}
+
+bool MainComponent::prepareAmbisonicRotation(AudioDecodeConfig& config, int order) {
+    if (ambisonicRotationChoice[order] < 0) {
+        return false;
+    }
+
+    config.prepareAmbisonicDecode(order);
+
+    if (ambisonicRotationChoice[order] == 0) {
+        // Both paths end in the same two-coefficients-per-input mix, so they only differ in the
+        // coeff update they run whenever the orientation moves. Time both once per order.
+        Mach1Decode<float> decode;
+        DecodeChain::initialiseDecode(decode);
+        decode.setDecodeMode(DecodeChain::getDecodeModeForChannelCount(config.conversionOutputChannels));
+        std::vector<float> decodeCoeffs(MAX_DECODE_CHANNELS * 2, 0.0f);
+        AmbisonicRotation rotation;
+        rotation.prepare(order);
+        std::vector<float> folded(config.numInputChannels * 2, 0.0f);
+
+        constexpr int iterations = 64;
+        const auto start = juce::Time::getHighResolutionTicks();
+        for (int i = 0; i < iterations; ++i) {
+            rotation.setOrientation((float) i * 5.0f, (float) i, (float) -i);
+            rotation.rotateDecodeWeights(config.ambisonicDecodeCoeffs.data(), folded.data());
+        }
+        const auto shTicks = juce::Time::getHighResolutionTicks() - start;
+        for (int i = 0; i < iterations; ++i) {
+            decode.setRotationDegrees({(float) i * 5.0f, (float) i, (float) -i});
+            decode.decodeCoeffs(decodeCoeffs.data());
+            config.foldDecodeCoeffs(decodeCoeffs.data(), folded.data());
+        }
+        const auto fusedTicks = juce::Time::getHighResolutionTicks() - start - shTicks;
+
+        ambisonicRotationChoice[order] = shTicks <= fusedTicks ? 1 : -1;
+        DBG("Ambisonic order " + juce::String(order) + " coeff update: SH domain "
+            + juce::String(juce::Time::highResolutionTicksToSeconds(shTicks) * 1.0e9 / iterations, 0) + "ns, M1Spatial "
+            + juce::String(juce::Time::highResolutionTicksToSeconds(fusedTicks) * 1.0e9 / iterations, 0) + "ns");
+    }
+    return ambisonicRotationChoice[order] > 0;
 }
 
 // TODO: Detect any Mach1Spatial comment metadata
-void MainComponent::reconfigureAudioTranscode() {
+void MainComponent::reconfigureAudioTranscode(AudioDecodeConfig& config) {
     // Stereo/mono files do not need format conversion before decode.
-    m_transcode_strategy = &MainComponent::noTranscodeStrategy;
+    config.transcodeStrategy = &MainComponent::noTranscodeStrategy;
 
-    if (detectedNumInputChannels <= 2) {
+    if (config.numInputChannels <= 2) {
+        config.speakerLayout.clear(); // nothing to transcode from, use the binaural decode
         return;
     }
 
+    // Loudspeaker output replaces the binaural decode with a single transcode to the layout
+    if (!config.speakerLayout.empty() && !config.inputFormat.empty()) {
+        if (config.setTranscodeFormats(config.inputFormat, config.speakerLayout)) {
+            const int out = config.transcode.getOutputNumChannels();
+            if (out > 0 && out <= MAX_OUTPUT_CHANNELS) {
+                config.numSpeakerChannels = out;
+                config.outputFormat = config.speakerLayout;
+                config.storeConversionMatrix(MAX_OUTPUT_CHANNELS);
+                return;
+            }
+        }
+        config.speakerLayout.clear(); // no conversion path to this layout, use the binaural decode
+    }
+
     // Use selected format if available, otherwise use default behavior
-    if (!selectedInputFormat.empty()) {
-        setTranscodeInputFormat(selectedInputFormat);
+    if (!config.inputFormat.empty()) {
+        config.outputFormat = getPreferredOutputFormat(config.inputFormat);
 
-        /// INPUT PREFERRED OUTPUT OVERRIDE ASSIGNMENTS
-        if (selectedInputFormat == "3.0_LCR" || // NOTE: switch to M1Spatial-14 for center channel
-            selectedInputFormat == "4.0_LCRS" || // NOTE: switch to M1Spatial-14 for center channel
-            selectedInputFormat == "M1Horizon-4_2")
-        {
-            setTranscodeOutputFormat("M1Spatial-4");
+        // the index already knows this format has no path, skip the search
+        if (transcodePathIndex.getPathState(config.inputFormat) == TranscodePathIndex::PathMissing) {
+            config.transcodeStrategy = &MainComponent::nullStrategy;
+            return;
         }
-        else if (selectedInputFormat == "4.0_AFormat" ||
-                 selectedInputFormat == "Ambeo" ||
-                 selectedInputFormat == "TetraMic" ||
-                 selectedInputFormat == "SPS-200" ||
-                 selectedInputFormat == "ORTF3D" ||
-                 selectedInputFormat == "CoreSound-OctoMic" ||
-                 selectedInputFormat == "CoreSound-OctoMic_SIM")
+
+        if (config.setTranscodeFormats(config.inputFormat, config.outputFormat))
         {
-            setTranscodeOutputFormat("M1Spatial-8");
+            config.transcodeStrategy = &MainComponent::intermediaryBufferTranscodeStrategy;
+
+            // keep the conversion matrix around so the decode can be fused into it
+            if (useFusedTranscodeDecode || config.parallelTasks > 1) {
+                config.storeConversionMatrix(MAX_DECODE_CHANNELS);
+            }
         }
         else
         {
-            setTranscodeOutputFormat("M1Spatial-14");
-        }
-        // TODO: Add more format overrides for higher order ambisonic to 38ch when ready
-        
-        if (m1Transcode.processConversionPath())
-        {
-            m_transcode_strategy = &MainComponent::intermediaryBufferTranscodeStrategy;
+            config.transcodeStrategy = &MainComponent::nullStrategy;
         }
-        else
-        {
-            m_transcode_strategy = &MainComponent::nullStrategy;
+    }
+}
+
+void MainComponent::rebuildAudioConfig() {
+    // Take a copy of the message thread settings the build depends on and hand it to the
+    // builder thread, which publishes the finished config to the audio thread.
+    auto config = std::make_unique<AudioDecodeConfig>();
+    config->numInputChannels = detectedNumInputChannels;
+    config->inputFormat = selectedInputFormat;
+    config->outputFormat = selectedOutputFormat;
+    config->speakerLayout = selectedSpeakerLayout;
+    config->sampleRate = sampleRate;
+    config->useDecodeCoeffTable = useDecodeCoeffTable;
+    config->numListeners = numListeners;
+
+    if (useParallelTranscode && config->numInputChannels >= PARALLEL_TRANSCODE_MIN_CHANNELS) {
+        config->parallelTasks = transcodeWorkers.getNumWorkers() + 1; // the audio thread takes a share too
+    }
+    if (useHrtfConvolution && hrtfFilters != nullptr && hrtfFilters->sampleRate == sampleRate) {
+        config->hrtfFilters = hrtfFilters;
+    }
 
+    audioConfigRequested = true;
+    audioConfigSampleRate = sampleRate;
+    audioConfigBuilder.request(std::move(config));
+}
+
+void MainComponent::buildAudioConfig(std::unique_ptr<AudioDecodeConfig> config) {
+    reconfigureAudioTranscode(*config);
+    reconfigureAudioDecode(*config); // should be called last
+
+    config->masterGainRamp.prepare(1, config->sampleRate);
+    config->masterGainRamp.setRampLengthSeconds(MIN_DECODE_RAMP_SECONDS);
+    prepareListeners(*config);
+
+    // The audio thread crossfades to it from the config it is playing. That one is freed by
+    // audioConfig.reclaim() once the audio thread lets go of it.
+    const auto outputFormat = config->numSpeakerChannels == 0 ? config->outputFormat : std::string();
+    audioConfig.publish(std::move(config));
+    callbackProfiler.requestReset(); // keep the load histograms per format and channel count
+
+    juce::MessageManager::callAsync([safeThis = juce::Component::SafePointer<MainComponent>(this), outputFormat]() {
+        if (safeThis != nullptr && !outputFormat.empty()) {
+            safeThis->selectedOutputFormat = outputFormat;
         }
-        pendingFormatChange = false;
+    });
+}
+
+void MainComponent::prepareListeners(AudioDecodeConfig& config) {
+    // a speaker layout uses every output itself
+    if (config.numSpeakerChannels > 0) {
+        config.numListeners = 1;
+    }
+
+    const bool decodes = config.numInputChannels > 2 && config.numSpeakerChannels == 0;
+    config.listeners = std::vector<AudioDecodeConfig::Listener>((size_t) juce::jlimit(1, (int) MAX_LISTENERS, config.numListeners));
+    for (int index = 0; index < (int) config.listeners.size(); ++index) {
+        config.prepareListener(config.listeners[(size_t) index], index, decodes);
     }
 }
 
 void MainComponent::setDetectedInputChannelCount(int numberOfInputChannels) {
-    if (detectedNumInputChannels == numberOfInputChannels) {
+    if (detectedNumInputChannels == numberOfInputChannels && audioConfigRequested) {
         return;
     }
 
@@ -1948,8 +2565,7 @@ void MainComponent::setDetectedInputChannelCount(int numberOfInputChannels) {
         selectedInputFormat = "";
     }
 
-    reconfigureAudioTranscode();
-    reconfigureAudioDecode(); // can use intermediaryBuffer and should be called last
+    rebuildAudioConfig();
 }
 
 void MainComponent::createMenuBar()
@@ -1990,6 +2606,39 @@ juce::PopupMenu MainComponent::getMenuForIndex(int topLevelMenuIndex, const juce
         menu.addSubMenu("Open Recent", recentFilesMenu, hasRecentFiles);
         menu.addSeparator();
         menu.addItem(SettingsMenuID, "Audio Device Settings", true);
+
+        // Used when the media's sample rate differs from the audio device's
+        juce::PopupMenu resamplingMenu;
+        const auto quality = currentMedia.getResamplerQuality();
+        resamplingMenu.addItem(ResamplerQualityMenuID + PolyphaseResampler::QualityDraft, "Draft", true, quality == PolyphaseResampler::QualityDraft);
+        resamplingMenu.addItem(ResamplerQualityMenuID + PolyphaseResampler::QualityStandard, "Standard", true, quality == PolyphaseResampler::QualityStandard);
+        resamplingMenu.addItem(ResamplerQualityMenuID + PolyphaseResampler::QualityHigh, "High", true, quality == PolyphaseResampler::QualityHigh);
+        menu.addSubMenu("Resampling Quality", resamplingMenu);
+        menu.addItem(ParallelTranscodeMenuID, "Parallel Transcode (16+ channels)", true, useParallelTranscode);
+        menu.addItem(DecodeCoeffTableMenuID, "Interpolated Decode Coefficients", true, useDecodeCoeffTable);
+
+        // Binaural decode for headphones, or a speaker layout using every device output
+        juce::PopupMenu outputMenu;
+        outputMenu.addItem(OutputBinauralMenuID, "Binaural (Headphones)", true, selectedSpeakerLayout.empty() && !useHrtfConvolution);
+        outputMenu.addItem(OutputHrtfMenuID,
+                           hrtfFilters != nullptr ? "Binaural (HRTF: " + hrtfFilters->name + ")" : juce::String("Binaural (HRTF Convolution)"),
+                           true, selectedSpeakerLayout.empty() && useHrtfConvolution);
+        outputMenu.addItem(LoadHrtfFilterMenuID, "Load HRTF Filter Set...", true);
+        outputMenu.addSeparator();
+        currentSpeakerLayoutOptions = getSpeakerLayoutNames(deviceOutputChannels);
+        for (int i = 0; i < (int) currentSpeakerLayoutOptions.size() && OutputSpeakerLayoutMenuID + i < ListenerCountMenuID; ++i) {
+            outputMenu.addItem(OutputSpeakerLayoutMenuID + i, currentSpeakerLayoutOptions[i], true,
+                               currentSpeakerLayoutOptions[i] == selectedSpeakerLayout);
+        }
+        menu.addSubMenu("Output", outputMenu);
+
+        // one binaural listener per output pair, listener k on device channels 2k/2k+1 (0-based)
+        juce::PopupMenu listenersMenu;
+        const int maxListeners = juce::jlimit(1, (int) MAX_LISTENERS, deviceOutputChannels / 2);
+        for (int count = 1; count <= maxListeners; ++count) {
+            listenersMenu.addItem(ListenerCountMenuID + count - 1, juce::String(count), true, count == numListeners);
+        }
+        menu.addSubMenu("Listeners", listenersMenu, selectedSpeakerLayout.empty());
     }
     // TODO: implement this
 //    else if (topLevelMenuIndex == 1) // View menu
@@ -2041,7 +2690,7 @@ void MainComponent::menuItemSelected(int menuItemID, int /*topLevelMenuIndex*/)
                     0,                     // Minimum input channels (hide input section)
                     0,                     // Maximum input channels (hide input section)
                     0,                     // Minimum output channels
-                    2,                     // Maximum output channels
+                    MAX_OUTPUT_CHANNELS,   // Maximum output channels (speaker layouts)
                     false,                 // Show MIDI input options
                     false,                 // Show MIDI output selector
                     true,                  // Show channels as stereo pairs
@@ -2071,9 +2720,55 @@ void MainComponent::menuItemSelected(int menuItemID, int /*topLevelMenuIndex*/)
             }
             break;
             
+        case OutputBinauralMenuID:
+            setHrtfConvolution(false);
+            setSpeakerLayout("");
+            menuItemsChanged();
+            break;
+
+        case OutputHrtfMenuID:
+            if (hrtfFilterFile.existsAsFile()) {
+                setHrtfConvolution(true);
+                setSpeakerLayout("");
+            } else {
+                showHrtfFileChooser();
+            }
+            menuItemsChanged();
+            break;
+
+        case LoadHrtfFilterMenuID:
+            showHrtfFileChooser();
+            break;
+
+        case ParallelTranscodeMenuID:
+            setParallelTranscode(!useParallelTranscode);
+            menuItemsChanged();
+            break;
+
+        case DecodeCoeffTableMenuID:
+            setDecodeCoeffTable(!useDecodeCoeffTable);
+            menuItemsChanged();
+            break;
+
         default:
+            if (menuItemID >= OutputSpeakerLayoutMenuID && menuItemID < ListenerCountMenuID
+                && menuItemID - OutputSpeakerLayoutMenuID < (int) currentSpeakerLayoutOptions.size())
+            {
+                setSpeakerLayout(currentSpeakerLayoutOptions[menuItemID - OutputSpeakerLayoutMenuID]);
+                menuItemsChanged();
+            }
+            else if (menuItemID >= ListenerCountMenuID && menuItemID < ListenerCountMenuID + MAX_LISTENERS)
+            {
+                setNumListeners(menuItemID - ListenerCountMenuID + 1);
+                menuItemsChanged();
+            }
+            else if (menuItemID >= ResamplerQualityMenuID && menuItemID <= ResamplerQualityMenuID + PolyphaseResampler::QualityHigh)
+            {
+                currentMedia.setResamplerQuality((PolyphaseResampler::Quality) (menuItemID - ResamplerQualityMenuID));
+                menuItemsChanged();
+            }
             // Handle recent files
-            if (menuItemID >= RecentFileMenuID && menuItemID < RecentFileMenuID + MAX_RECENT_FILES)
+            else if (menuItemID >= RecentFileMenuID && menuItemID < RecentFileMenuID + MAX_RECENT_FILES)
             {
                 int fileIndex = menuItemID - RecentFileMenuID;
                 if (fileIndex < recentFiles.size())
@@ -2149,6 +2844,14 @@ void MainComponent::audioDeviceManagerChanged()
     if (!device)
         return; // No device available
 
+    // A speaker layout only makes sense while the device has exactly its channel count
+    deviceOutputChannels = device->getActiveOutputChannels().countNumberOfSetBits();
+    if (!selectedSpeakerLayout.empty() && getFormatChannelCount(selectedSpeakerLayout) != deviceOutputChannels)
+    {
+        setSpeakerLayout("");
+    }
+    menuItemsChanged();
+
     // Update device settings
     currentMedia.prepareToPlay(
         device->getCurrentBufferSizeSamples(),
@@ -12,6 +12,22 @@
 #include "Mach1TranscodeConstants.h"
 #include "TypesForDataExchange.h"
 #include "PlayerOSC.h"
+#include "RealtimeSnapshot.h"
+#include "AudioConfigHandover.h"
+#include "RealtimeSafety.h"
+#include "DecodeKernels.h"
+#include "CoeffRamp.h"
+#include "OrientationChannel.h"
+#include "CallbackProfiler.h"
+#include "AudioEventQueue.h"
+#include "ChannelMeters.h"
+#include "TranscodePathIndex.h"
+#include "RealtimeWorkerPool.h"
+#include "BinauralConvolver.h"
+#include "AmbisonicRotation.h"
+#include "DecodeCoeffTable.h"
+#include "DecodeChain.h"
+#include "FormatDefaults.h"
 
 #include "MediaPlayer.h"
 #include "UI/M1PlayerControls.h"
@@ -22,11 +38,13 @@
 #include "UI/M1DropdownMenu.h"
 #include "UI/VideoPlayerWidget.h"
 #include "UI/RadioGroupWidget.h"
+#include "UI/M1LevelMeters.h"
 
 #include "m1_orientation_client/UI/M1Label.h"
 #include "m1_orientation_client/UI/M1OrientationWindowToggleButton.h"
 #include "m1_orientation_client/UI/M1OrientationClientWindow.h"
 
+#include <cctype>
 #include <iomanip>
 #include <sstream>
 #include <string>
@@ -199,103 +217,262 @@ private:
     // Consolidate the media and transport into a single object class
     MediaPlayer currentMedia;
 
-    bool b_standalone_mode = false;
+    std::atomic<bool> b_standalone_mode { false }; // also read by the audio callback
     bool b_wants_to_switch_to_standalone = false;
 
     double                      sampleRate = 0.0;
     int                         blockSize = 0;
     int                         ffwdSpeed = 2;
 
-    // Mach1Decode API
-    Mach1Decode<float> m1Decode;
-    std::vector<float> spatialMixerCoeffs;
-    std::vector<juce::LinearSmoothedValue<float>> smoothedChannelCoeffs;
-    juce::AudioBuffer<float> tempBuffer;
+    // Largest Mach1Decode format (M1Spatial-14) used to size the decode buffers
+    static constexpr int MAX_DECODE_CHANNELS = DecodeChain::MAX_DECODE_CHANNELS;
+    // Largest supported input (ACNSN3DO6A) used to size the read buffer
+    static constexpr int MAX_INPUT_CHANNELS = DecodeChain::MAX_INPUT_CHANNELS;
+
+    using AudioStrategy = void (MainComponent::*)(const AudioSourceChannelInfo&, const AudioSourceChannelInfo&);
+
+    // Decode/transcode state for one input configuration. Requested on the message thread by
+    // rebuildAudioConfig(), built by audioConfigBuilder and published to the audio thread
+    // through audioConfig; once published only the audio thread touches it, until it is reclaimed.
+    // The strategies run the DecodeChain bodies, this adds what the device side picks and keeps.
+    struct AudioDecodeConfig : public DecodeChain
+    {
+        std::string inputFormat;
+        std::string outputFormat;
+
+        AudioStrategy decodeStrategy = &MainComponent::nullStrategy;
+        AudioStrategy transcodeStrategy = &MainComponent::nullStrategy;
+
+        // Loudspeaker output: transcode straight to this layout on the device channels
+        std::string speakerLayout;
+        int numSpeakerChannels = 0;
+
+        // Smoothing state lives with the config, so an outgoing config keeps rendering from its
+        // own coeffs while it is crossfaded out
+        CoeffRamp masterGainRamp;
+        bool startRampsSettled = false; // set when crossfaded in, the crossfade is its fade-in
+
+        bool useDecodeCoeffTable = false;
+
+        int numListeners = 1;
+        std::vector<Listener> listeners; // from prepareListeners()
+    };
+
+    RealtimeSnapshot<AudioDecodeConfig> audioConfig;
+    AudioDecodeConfig* activeConfig = nullptr; // only valid on the audio thread during getNextAudioBlock()
+    AudioDecodeConfig::Listener* activeListener = nullptr; // the listener the decode strategy renders
+
+    // Builds requested configs on a background thread, so processConversionPath() and the
+    // ambisonic rotation timing never stall the message thread. A newer request replaces one
+    // that has not started yet.
+    struct AudioConfigBuilder : public juce::Thread
+    {
+        std::function<void(std::unique_ptr<AudioDecodeConfig>)> onBuild;
+
+        AudioConfigBuilder() : juce::Thread("AudioConfigBuilder") {}
+        ~AudioConfigBuilder() override { stopThread(10000); } // a conversion path search cannot be interrupted
+
+        void request(std::unique_ptr<AudioDecodeConfig> config)
+        {
+            {
+                const juce::ScopedLock lock(pendingLock);
+                pending = std::move(config);
+            }
+            if (!isThreadRunning())
+                startThread();
+            notify();
+        }
+
+        void run() override
+        {
+            while (!threadShouldExit())
+            {
+                std::unique_ptr<AudioDecodeConfig> config;
+                {
+                    const juce::ScopedLock lock(pendingLock);
+                    config = std::move(pending);
+                }
+                if (config != nullptr)
+                    onBuild(std::move(config));
+                else
+                    wait(-1);
+            }
+        }
+
+        juce::CriticalSection pendingLock;
+        std::unique_ptr<AudioDecodeConfig> pending;
+    };
+
+    AudioConfigBuilder audioConfigBuilder;
+    bool audioConfigRequested = false; // message thread
+    double audioConfigSampleRate = 0.0; // device rate of the latest request, message thread
+    void buildAudioConfig(std::unique_ptr<AudioDecodeConfig> config);
+    void prepareListeners(AudioDecodeConfig& config);
+
+    // A config published for the same input channel count is crossfaded in: for
+    // CONFIG_CROSSFADE_SECONDS the audio thread renders both configs and mixes them with an
+    // equal-power fade, then lets go of the old one. Anything else switches at once. Audio thread.
+    static constexpr double CONFIG_CROSSFADE_SECONDS = 0.05;
+    AudioConfigHandover<AudioDecodeConfig> configHandover { audioConfig };
+    juce::AudioBuffer<float> crossfadeBuffer; // the outgoing config's output
+    void pickUpAudioConfig(AudioDecodeConfig* latest);
+    void renderAudioConfig(const AudioSourceChannelInfo& bufferToFill, const AudioSourceChannelInfo& info);
+    void crossfadeFromPreviousConfig(const AudioSourceChannelInfo& bufferToFill, const AudioSourceChannelInfo& info);
+
+    // Where the decode strategy renders the active listener. The media volume is folded into
+    // the decode coeffs; the speaker layout output has no stereo decode, it ramps the volume
+    // through the conversion matrix gains instead.
+    DecodeChain::Output getDecodeOutput(const AudioSourceChannelInfo& bufferToFill);
+
+    // Decode gain ramp length follows the orientation update rate, 10ms at the fastest
+    static constexpr double MIN_DECODE_RAMP_SECONDS = 0.01;
+    static constexpr double MAX_DECODE_RAMP_SECONDS = 0.05;
+
+    // Listener orientation for the audio thread. The poller reads m1OrientationClient itself,
+    // under orientationClientLock, and pushes each tracker reading as it arrives. draw() only
+    // adds the mouse/UI orientation, with the tracker reading it already folded in, so the
+    // head-tracked part keeps up when frames are slow or the window is hidden.
+    struct OrientationBase
+    {
+        float yaw = 0.0f, pitch = 0.0f, roll = 0.0f;
+        float clientYaw = 0.0f, clientPitch = 0.0f, clientRoll = 0.0f; // previousClientOrientation
+    };
+
+    struct OrientationPoller : public juce::HighResolutionTimer
+    {
+        std::function<void()> onPoll;
+        ~OrientationPoller() override { stopTimer(); }
+        void hiResTimerCallback() override { if (onPoll) onPoll(); }
+    };
+
+    static constexpr int ORIENTATION_POLL_INTERVAL_MS = 1;
+    static constexpr double MAX_ORIENTATION_PREDICTION_SECONDS = 0.05;
+
+    OrientationChannel orientationChannel;
+    OrientationPoller orientationPoller;
+    OrientationBase orientationBase;
+    juce::SpinLock orientationBaseLock;
+    juce::CriticalSection orientationClientLock; // every m1OrientationClient call after init
+    std::atomic<bool> predictOrientation { false }; // extrapolate to the time the block is heard
+    std::atomic<double> outputLatencySeconds { 0.0 };
+    void pollOrientation();
+
+    // Per-callback load by stage, shown in the help overlay and sent to the helper over OSC
+    CallbackProfiler callbackProfiler;
+    void sendCallbackStats();
+
+    // Peak/RMS of every input channel and device output, toggled with [m]
+    ChannelMeters channelMeters;
+    bool bShowMeters = false;
+
     juce::AudioBuffer<float> readBuffer;
     juce::AudioBuffer<float> intermediaryBuffer;
-    int detectedNumInputChannels;
+    int detectedNumInputChannels = 0; // message thread copy, the audio thread reads activeConfig
 
     // Mach1Transcode API
-    Mach1Transcode<float> m1Transcode;
-    std::vector<float> transcodeToDecodeCoeffs;
-    std::vector< std::vector<float> > conversionMatrix;
+    Mach1Transcode<float> m1Transcode; // message thread only, used for format name lookups
+    bool useFusedTranscodeDecode = true; // go N->2 in one pass when the transcode is a plain matrix
+
+    // Per ambisonic order, whether the SH domain rotation updates its coeffs faster than the
+    // fused M1Spatial decode: 0 not measured yet, 1 SH domain, -1 M1Spatial. audioConfigBuilder thread.
+    int ambisonicRotationChoice[AmbisonicRotation::MAX_ORDER + 1] = {};
+    bool prepareAmbisonicRotation(AudioDecodeConfig& config, int order);
+
+    // Optional decode coeffs interpolated from an orientation grid per M1Spatial decode mode,
+    // instead of running Mach1Decode whenever the listener moves. The tables are built on the
+    // audioConfigBuilder thread the first time a config needs them and shared by later configs.
+    bool useDecodeCoeffTable = false;
+    std::shared_ptr<const DecodeCoeffTable> decodeCoeffTables[3]; // M1Spatial-4, -8, -14; audioConfigBuilder thread
+    std::shared_ptr<const DecodeCoeffTable> getDecodeCoeffTable(int formatChannelCount);
+    void setDecodeCoeffTable(bool enabled);
     
     std::vector<std::string> currentFormatOptions;
     std::string selectedInputFormat;
     std::string selectedOutputFormat = "M1Spatial-14"; // default
-    std::atomic<bool> pendingFormatChange{false};
 
-    juce::CriticalSection audioCallbackLock;
-    juce::CriticalSection renderCallbackLock;
-
-    std::map<int, std::vector<std::string>> matchingFormatNamesMap;
-
-    std::vector<std::string> getMatchingFormatNames(int numChannels) {
-        // Check if the numChannels already exists in the map
-        auto it = matchingFormatNamesMap.find(numChannels);
-        if (it != matchingFormatNamesMap.end()) {
-            return it->second; // Return the existing list if numChannels is found
+    // Loudspeaker output mode: instead of the binaural decode, transcode the input straight to
+    // a speaker layout matching the device's output channels. Empty selects the binaural decode.
+    static constexpr int MAX_OUTPUT_CHANNELS = 16;
+    std::string selectedSpeakerLayout;
+    int deviceOutputChannels = 2; // active outputs of the current device, message thread copy
+    std::vector<std::string> currentSpeakerLayoutOptions;
+    void setSpeakerLayout(const std::string& name);
+
+    // Several binaural listeners on one device, e.g. headphone amps on the outputs of one
+    // interface: listener k hears device channels 2k/2k+1 (0-based) and shares the media pull
+    // and transcode with the others. Listener 0 follows the UI and head tracker, the others
+    // their own orientation sent over OSC as /listener-orientation <listener> <yaw> <pitch> <roll>.
+    static constexpr int MAX_LISTENERS = MAX_OUTPUT_CHANNELS / 2;
+    int numListeners = 1; // message thread
+    OrientationChannel listenerOrientations[MAX_LISTENERS - 1]; // listeners 1 and up, written on the message thread
+    void setNumListeners(int count);
+
+    // Optional parallel transcode for high channel counts: output channel groups of the
+    // conversion matrix (or input groups of the fused stereo mix) are shared between the
+    // audio thread and a few realtime worker threads
+    static constexpr int PARALLEL_TRANSCODE_MIN_CHANNELS = DecodeChain::PARALLEL_MIN_CHANNELS;
+    static constexpr int MAX_TRANSCODE_WORKERS = 3;
+    RealtimeWorkerPool transcodeWorkers;
+    bool useParallelTranscode = false;
+    juce::AudioBuffer<float> parallelMixBuffer; // per task stereo partial sums, task 0 mixes in place
+    void setParallelTranscode(bool enabled);
+
+    // Binaural output through HRTF/BRIR convolution of the M1Spatial speaker feeds instead of
+    // amplitude panning. The filter set is read and transformed by hrtfFilterLoader for the
+    // device sample rate; the audio thread only runs the listeners' hrtfConvolver.
+    bool useHrtfConvolution = false;
+    bool hrtfFiltersLoading = false;
+    juce::File hrtfFilterFile;
+    std::shared_ptr<const BinauralConvolver::Filters> hrtfFilters; // message thread copy
+    BinauralFilterLoader hrtfFilterLoader;
+    void setHrtfConvolution(bool enabled);
+    void loadHrtfFilters(const juce::File& file);
+    void showHrtfFileChooser();
+    void saveHrtfSettings();
+
+    std::vector<std::string> getSpeakerLayoutNames(int numChannels) const {
+        // Mach1Transcode names its loudspeaker layouts by channel layout, e.g. "5.1_C", "7.1.4_C"
+        std::vector<std::string> layoutNames;
+        for (const auto& format : Mach1TranscodeConstants::formats) {
+            const std::string name = format.name;
+            if (format.numChannels == numChannels && !name.empty() && std::isdigit((unsigned char) name[0])) {
+                layoutNames.push_back(name);
+            }
         }
+        return layoutNames;
+    }
 
-        std::vector<std::string> matchingFormatNames;
-
-        Mach1Transcode<float> m1TranscodeTemp;
-
+    int getFormatChannelCount(const std::string& name) const {
         for (const auto& format : Mach1TranscodeConstants::formats) {
-            if (format.numChannels == numChannels) {
-                m1TranscodeTemp.setInputFormat(m1TranscodeTemp.getFormatFromString(format.name));
+            if (std::string(format.name) == name) {
+                return format.numChannels;
+            }
+        }
+        return 0;
+    }
 
-                /// INPUT PREFERRED OUTPUT OVERRIDE ASSIGNMENTS
-                if (format.name == "3.0_LCR" || // NOTE: switch to M1Spatial-14 for center channel
-                    format.name == "4.0_LCRS" || // NOTE: switch to M1Spatial-14 for center channel
-                    format.name == "M1Horizon-4_2")
-                {
-                    m1TranscodeTemp.setOutputFormat(m1TranscodeTemp.getFormatFromString("M1Spatial-4"));
-                }
-                else if (format.name == "4.0_AFormat" ||
-                    format.name == "Ambeo" ||
-                    format.name == "TetraMic" ||
-                    format.name == "SPS-200" ||
-                    format.name == "ORTF3D" ||
-                    format.name == "CoreSound-OctoMic" ||
-                    format.name == "CoreSound-OctoMic_SIM")
-                {
-                    m1TranscodeTemp.setOutputFormat(m1TranscodeTemp.getFormatFromString("M1Spatial-8"));
-                }
-                else
-                {
-                    m1TranscodeTemp.setOutputFormat(m1TranscodeTemp.getFormatFromString("M1Spatial-14"));
-                }
+    juce::CriticalSection audioCallbackLock; // the audio thread only ever try-locks this
+    juce::CriticalSection renderCallbackLock;
 
-                if (m1TranscodeTemp.processConversionPath()) {
-                    matchingFormatNames.push_back(format.name);
-                }
-            }
+    // Conversion paths for every input format, resolved on a background thread at startup
+    TranscodePathIndex transcodePathIndex;
+
+    std::vector<std::string> getMatchingFormatNames(int numChannels) {
+        if (transcodePathIndex.isReady()) {
+            return transcodePathIndex.getMatchingFormatNames(numChannels);
         }
 
-        matchingFormatNamesMap[numChannels] = matchingFormatNames;
-        return matchingFormatNames;
+        // still indexing, offer the format in use rather than searching for paths here
+        auto format = selectedInputFormat.empty() ? getDefaultFormatForChannelCount(numChannels) : selectedInputFormat;
+        return format.empty() ? std::vector<std::string>() : std::vector<std::string>{ format };
+    }
+
+    std::string getPreferredOutputFormat(const std::string& inputFormat) const {
+        return FormatDefaults::getPreferredOutputFormat(inputFormat);
     }
 
     std::string getDefaultFormatForChannelCount(int numChannels) {
-        switch (numChannels) {
-            case 3:  return "3.0_LCR";
-            case 4:  return "M1Spatial-4";
-            case 5:  return "5.0_C";
-            case 6:  return "5.1_C";
-            case 7:  return "7.0_C";
-            case 8:  return "M1Spatial-8";
-            case 9:  return "ACNSN3DO2A";
-            case 10: return "7.1.2_C";
-            case 11: return "7.0.6_C";
-            case 12: return "7.1.4_C";
-            case 14: return "M1Spatial-14";
-            case 16: return "ACNSN3DO3A";
-            case 24: return "ACNSN3DO4A";
-            case 36: return "ACNSN3DO5A";
-            case 64: return "ACNSN3DO6A";
-            default: return "";
-        }
+        return FormatDefaults::getDefaultFormatForChannelCount(numChannels);
     }
 
     int secondsWithoutMouseMove = 0;
@@ -309,8 +486,20 @@ private:
     void timerCallback() override;
     std::unique_ptr<PlayerOSC> playerOSC;
 
-    void (MainComponent::*m_decode_strategy)(const AudioSourceChannelInfo&, const AudioSourceChannelInfo&);
-    void (MainComponent::*m_transcode_strategy)(const AudioSourceChannelInfo&, const AudioSourceChannelInfo&);
+    // Errors and conditions raised on the audio thread, drained and displayed by draw()
+    AudioEventQueue audioEvents;
+    void postAudioError(AudioEventQueue::Type type);
+    void handleAudioEvent(const AudioEventQueue::Event& event);
+
+    // An error that persists is reposted every ERROR_REPOST_SECONDS, which keeps the popup up
+    static constexpr double ERROR_REPOST_SECONDS = 1.0;
+    int lastPostedError = -1;       // audio thread
+    double lastErrorPostTime = 0.0; // audio thread
+    int lastMediaUnderruns = 0;     // audio thread
+
+    int audioDeadlineMisses = 0;    // message thread, from the drained events
+    int audioUnderruns = 0;         // message thread
+    std::string audioFormatInfo;    // message thread, the config playing now
 
     // Error display
     bool showErrorPopup = false;
@@ -349,8 +538,19 @@ private:
         View3DMenuID = 4,
         FullScreenMenuID = 5,
         ToggleOverlayMenuID = 6,
-        // Reserve IDs 7-9 for recent files
-        RecentFileMenuID = 7
+        // Reserve IDs 7-16 for recent files
+        RecentFileMenuID = 7,
+        ParallelTranscodeMenuID = 17,
+        OutputHrtfMenuID = 18,
+        LoadHrtfFilterMenuID = 19,
+        // Reserve IDs 20-22 for the PolyphaseResampler::Quality presets
+        ResamplerQualityMenuID = 20,
+        DecodeCoeffTableMenuID = 23,
+        OutputBinauralMenuID = 30,
+        // Reserve IDs 31-99 for the speaker layouts in currentSpeakerLayoutOptions
+        OutputSpeakerLayoutMenuID = 31,
+        // Reserve IDs 100-107 for 1 to MAX_LISTENERS listeners
+        ListenerCountMenuID = 100
     };
 
     std::unique_ptr<juce::PropertiesFile> appProperties;
@@ -373,8 +573,9 @@ public:
     void paint (juce::Graphics& g) override;
     void resized() override;
 
-    void reconfigureAudioDecode();
-    void reconfigureAudioTranscode();
+    void reconfigureAudioDecode(AudioDecodeConfig& config);
+    void reconfigureAudioTranscode(AudioDecodeConfig& config);
+    void rebuildAudioConfig();
     void setDetectedInputChannelCount(int numberOfInputChannels);
 
     void openFile(juce::File filepath);
@@ -386,8 +587,14 @@ public:
     void fallbackDecodeStrategy(const AudioSourceChannelInfo& bufferToFill, const AudioSourceChannelInfo& info);
     void stereoDecodeStrategy(const AudioSourceChannelInfo& bufferToFill, const AudioSourceChannelInfo& info);
     void monoDecodeStrategy(const AudioSourceChannelInfo& bufferToFill, const AudioSourceChannelInfo& info);
+    DecodeChain::Orientation readDecodeOrientation();
     void readBufferDecodeStrategy(const AudioSourceChannelInfo& bufferToFill, const AudioSourceChannelInfo& info);
     void intermediaryBufferDecodeStrategy(const AudioSourceChannelInfo& bufferToFill, const AudioSourceChannelInfo& info);
+    void readBufferConvolutionStrategy(const AudioSourceChannelInfo& bufferToFill, const AudioSourceChannelInfo& info);
+    void intermediaryBufferConvolutionStrategy(const AudioSourceChannelInfo& bufferToFill, const AudioSourceChannelInfo& info);
+    void fusedTranscodeDecodeStrategy(const AudioSourceChannelInfo& bufferToFill, const AudioSourceChannelInfo& info);
+    void ambisonicRotationDecodeStrategy(const AudioSourceChannelInfo& bufferToFill, const AudioSourceChannelInfo& info);
+    void speakerLayoutStrategy(const AudioSourceChannelInfo& bufferToFill, const AudioSourceChannelInfo& info);
     void noTranscodeStrategy(const AudioSourceChannelInfo& bufferToFill, const AudioSourceChannelInfo& info);
     void intermediaryBufferTranscodeStrategy(const AudioSourceChannelInfo & bufferToFill, const AudioSourceChannelInfo & info);
     void nullStrategy(const AudioSourceChannelInfo& bufferToFill, const AudioSourceChannelInfo& info);
@@ -0,0 +1,435 @@
+#include "MappedPcmReader.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    bool isChunk(const char* id, const char* name) noexcept
+    {
+        return std::memcmp(id, name, 4) == 0;
+    }
+
+    // AIFF stores its sample rate as an 80-bit IEEE extended float
+    double readExtended(const uint8_t* bytes) noexcept
+    {
+        const int exponent = ((bytes[0] & 0x7f) << 8) | bytes[1];
+        juce::uint64 mantissa = 0;
+        for (int i = 2; i < 10; ++i)
+            mantissa = (mantissa << 8) | bytes[i];
+
+        if (exponent == 0 && mantissa == 0)
+            return 0.0;
+
+        const double value = std::ldexp((double) mantissa, exponent - 16383 - 63);
+        return (bytes[0] & 0x80) != 0 ? -value : value;
+    }
+
+    // Format tag, channel count, rate and sample size of a WAV or W64 fmt chunk
+    bool readWaveFormatChunk(juce::InputStream& in, juce::int64 chunkSize, MappedPcmReader::Format& format)
+    {
+        int tag = (uint16_t) in.readShort();
+        format.numChannels = (uint16_t) in.readShort();
+        format.sampleRate = (double) (uint32_t) in.readInt();
+        in.readInt(); // bytes per second
+        const int blockAlign = (uint16_t) in.readShort();
+        format.bitsPerSample = (uint16_t) in.readShort();
+
+        if (tag == 0xfffe && chunkSize >= 40)
+        {
+            in.readShort(); // extension size
+            const int validBits = (uint16_t) in.readShort();
+            in.readInt();   // speaker mask, the transcode formats define the channel order
+            tag = (uint16_t) in.readShort(); // the subformat GUID starts with the plain format tag
+            if (validBits != 0 && validBits != format.bitsPerSample)
+                return false; // e.g. 24-bit in 32-bit containers, left to the decoder
+        }
+
+        if (tag != 1 && tag != 3)
+            return false;
+
+        format.isFloat = tag == 3;
+        format.isBigEndian = false;
+        return blockAlign == format.getBytesPerFrame();
+    }
+
+    //==============================================================================
+    bool readWave(juce::InputStream& in, MappedPcmReader::Format& format)
+    {
+        char id[4] = {};
+        in.read(id, 4);
+        const bool isRF64 = isChunk(id, "RF64");
+        if (!isRF64 && !isChunk(id, "RIFF"))
+            return false;
+
+        in.readInt();
+        in.read(id, 4);
+        if (!isChunk(id, "WAVE"))
+            return false;
+
+        bool hasFormat = false;
+        juce::int64 ds64DataSize = -1;
+        while (in.getPosition() + 8 <= in.getTotalLength())
+        {
+            in.read(id, 4);
+            const juce::int64 size = (uint32_t) in.readInt();
+            const juce::int64 chunkStart = in.getPosition();
+
+            if (isChunk(id, "ds64"))
+            {
+                in.readInt64(); // RIFF size
+                ds64DataSize = in.readInt64();
+            }
+            else if (isChunk(id, "fmt "))
+            {
+                if (!readWaveFormatChunk(in, size, format))
+                    return false;
+                hasFormat = true;
+            }
+            else if (isChunk(id, "data"))
+            {
+                format.dataOffset = chunkStart;
+                juce::int64 dataSize = isRF64 && size == 0xffffffff ? ds64DataSize : size;
+                if (dataSize < 0 || chunkStart + dataSize > in.getTotalLength())
+                    dataSize = in.getTotalLength() - chunkStart; // unfinished recordings
+                format.numFrames = hasFormat ? dataSize / format.getBytesPerFrame() : 0;
+                return hasFormat;
+            }
+
+            in.setPosition(chunkStart + size + (size & 1));
+        }
+        return false;
+    }
+
+    //==============================================================================
+    // Sony Wave64: RIFF with 16-byte GUID chunk ids and 64-bit sizes that include the header.
+    // Every id starts with its RIFF fourcc, followed by one of two fixed suffixes.
+    bool readWave64(juce::InputStream& in, MappedPcmReader::Format& format)
+    {
+        static constexpr uint8_t riffSuffix[12] = { 0x2e, 0x91, 0xcf, 0x11, 0xa5, 0xd6, 0x28, 0xdb, 0x04, 0xc1, 0x00, 0x00 };
+        static constexpr uint8_t chunkSuffix[12] = { 0xf3, 0xac, 0xd3, 0x11, 0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a };
+
+        uint8_t guid[16] = {};
+        in.read(guid, 16);
+        if (!isChunk((const char*) guid, "riff") || std::memcmp(guid + 4, riffSuffix, 12) != 0)
+            return false;
+
+        in.readInt64();
+        in.read(guid, 16);
+        if (!isChunk((const char*) guid, "wave") || std::memcmp(guid + 4, chunkSuffix, 12) != 0)
+            return false;
+
+        bool hasFormat = false;
+        while (in.getPosition() + 24 <= in.getTotalLength())
+        {
+            const juce::int64 chunkHeader = in.getPosition();
+            in.read(guid, 16);
+            const juce::int64 size = in.readInt64();
+            if (size < 24)
+                return false;
+
+            const bool known = std::memcmp(guid + 4, chunkSuffix, 12) == 0;
+            if (known && isChunk((const char*) guid, "fmt "))
+            {
+                if (!readWaveFormatChunk(in, size - 24, format))
+                    return false;
+                hasFormat = true;
+            }
+            else if (known && isChunk((const char*) guid, "data"))
+            {
+                format.dataOffset = chunkHeader + 24;
+                const juce::int64 dataSize = juce::jmin(size - 24, in.getTotalLength() - format.dataOffset);
+                format.numFrames = hasFormat ? dataSize / format.getBytesPerFrame() : 0;
+                return hasFormat;
+            }
+
+            in.setPosition(chunkHeader + ((size + 7) & ~(juce::int64) 7));
+        }
+        return false;
+    }
+
+    //==============================================================================
+    bool readAiff(juce::InputStream& in, MappedPcmReader::Format& format)
+    {
+        char id[4] = {};
+        in.read(id, 4);
+        if (!isChunk(id, "FORM"))
+            return false;
+
+        in.readIntBigEndian();
+        in.read(id, 4);
+        const bool isAifc = isChunk(id, "AIFC");
+        if (!isAifc && !isChunk(id, "AIFF"))
+            return false;
+
+        bool hasFormat = false;
+        while (in.getPosition() + 8 <= in.getTotalLength())
+        {
+            in.read(id, 4);
+            const juce::int64 size = (uint32_t) in.readIntBigEndian();
+            const juce::int64 chunkStart = in.getPosition();
+
+            if (isChunk(id, "COMM"))
+            {
+                format.numChannels = (uint16_t) in.readShortBigEndian();
+                format.numFrames = (uint32_t) in.readIntBigEndian();
+                format.bitsPerSample = ((uint16_t) in.readShortBigEndian() + 7) / 8 * 8; // samples are left aligned
+                uint8_t rate[10] = {};
+                in.read(rate, 10);
+                format.sampleRate = readExtended(rate);
+                format.isFloat = false;
+                format.isBigEndian = true;
+
+                if (isAifc)
+                {
+                    char compression[4] = {};
+                    in.read(compression, 4);
+                    if (isChunk(compression, "sowt"))
+                    {
+                        format.isBigEndian = false;
+                    }
+                    else if (isChunk(compression, "fl32") || isChunk(compression, "FL32"))
+                    {
+                        format.isFloat = true;
+                        format.bitsPerSample = 32;
+                    }
+                    else if (isChunk(compression, "fl64") || isChunk(compression, "FL64"))
+                    {
+                        format.isFloat = true;
+                        format.bitsPerSample = 64;
+                    }
+                    else if (!isChunk(compression, "NONE") && !isChunk(compression, "twos"))
+                    {
+                        return false;
+                    }
+                }
+                hasFormat = true;
+            }
+            else if (isChunk(id, "SSND"))
+            {
+                const juce::int64 offset = (uint32_t) in.readIntBigEndian();
+                in.readIntBigEndian(); // block size
+                format.dataOffset = chunkStart + 8 + offset;
+
+                if (!hasFormat)
+                    return false;
+                const juce::int64 available = (in.getTotalLength() - format.dataOffset) / format.getBytesPerFrame();
+                format.numFrames = juce::jmin(format.numFrames, available);
+                return true;
+            }
+
+            in.setPosition(chunkStart + size + (size & 1));
+        }
+        return false;
+    }
+
+    //==============================================================================
+    bool readCaf(juce::InputStream& in, MappedPcmReader::Format& format)
+    {
+        char id[4] = {};
+        in.read(id, 4);
+        if (!isChunk(id, "caff"))
+            return false;
+
+        in.readInt(); // version and flags
+
+        bool hasFormat = false;
+        while (in.getPosition() + 12 <= in.getTotalLength())
+        {
+            in.read(id, 4);
+            const juce::int64 size = in.readInt64BigEndian();
+            const juce::int64 chunkStart = in.getPosition();
+
+            if (isChunk(id, "desc"))
+            {
+                format.sampleRate = in.readDoubleBigEndian();
+                char formatId[4] = {};
+                in.read(formatId, 4);
+                const auto flags = (uint32_t) in.readIntBigEndian();
+                const auto bytesPerPacket = (uint32_t) in.readIntBigEndian();
+                const auto framesPerPacket = (uint32_t) in.readIntBigEndian();
+                format.numChannels = (int) (uint32_t) in.readIntBigEndian();
+                format.bitsPerSample = (int) (uint32_t) in.readIntBigEndian();
+                format.isFloat = (flags & 1) != 0;
+                format.isBigEndian = (flags & 2) == 0;
+
+                if (!isChunk(formatId, "lpcm") || framesPerPacket != 1 || (int) bytesPerPacket != format.getBytesPerFrame())
+                    return false;
+                hasFormat = true;
+            }
+            else if (isChunk(id, "data"))
+            {
+                if (!hasFormat)
+                    return false;
+
+                format.dataOffset = chunkStart + 4; // after the edit count
+                const juce::int64 available = in.getTotalLength() - format.dataOffset;
+                const juce::int64 dataSize = size < 0 ? available : juce::jmin(size - 4, available); // -1 runs to the end
+                format.numFrames = dataSize / format.getBytesPerFrame();
+                return true;
+            }
+
+            if (size < 0)
+                return false;
+            in.setPosition(chunkStart + size);
+        }
+        return false;
+    }
+
+    //==============================================================================
+    template <typename ReadSample>
+    void deinterleave(const uint8_t* source, int bytesPerSample, int numFileChannels,
+                      float* const* dest, int numChannels, int destOffset, int numFrames, ReadSample readSample) noexcept
+    {
+        const size_t stride = (size_t) bytesPerSample * (size_t) numFileChannels;
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const uint8_t* in = source + (size_t) channel * (size_t) bytesPerSample;
+            float* out = dest[channel] + destOffset;
+            for (int i = 0; i < numFrames; ++i, in += stride)
+                out[i] = readSample(in);
+        }
+    }
+
+    float floatFromBits(uint32_t bits) noexcept
+    {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    float floatFromBits(juce::uint64 bits) noexcept
+    {
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return (float) value;
+    }
+}
+
+//==============================================================================
+bool MappedPcmReader::readFormat(const juce::File& file, Format& format)
+{
+    juce::FileInputStream in(file);
+    if (!in.openedOk())
+        return false;
+
+    // try each container from the start of the file, each one checks its own magic first
+    using Parser = bool (*)(juce::InputStream&, Format&);
+    for (Parser parse : { (Parser) readWave, (Parser) readWave64, (Parser) readAiff, (Parser) readCaf })
+    {
+        format = {};
+        in.setPosition(0);
+        if (!parse(in, format))
+            continue;
+
+        const bool validSize = format.isFloat ? (format.bitsPerSample == 32 || format.bitsPerSample == 64)
+                                              : (format.bitsPerSample == 16 || format.bitsPerSample == 24 || format.bitsPerSample == 32);
+        return validSize && format.numChannels > 0 && format.sampleRate > 0.0 && format.numFrames > 0;
+    }
+    return false;
+}
+
+bool MappedPcmReader::open(const juce::File& file)
+{
+    Format newFormat;
+    if (!readFormat(file, newFormat))
+        return false;
+
+    const auto range = juce::Range<juce::int64>(newFormat.dataOffset,
+                                                newFormat.dataOffset + newFormat.numFrames * newFormat.getBytesPerFrame());
+    auto newMapping = std::make_unique<juce::MemoryMappedFile>(file, range, juce::MemoryMappedFile::readOnly, false);
+    if (newMapping->getData() == nullptr)
+        return false;
+
+    // the mapping starts at a page boundary at or before the requested range
+    format = newFormat;
+    data = static_cast<const uint8_t*>(newMapping->getData()) + (range.getStart() - newMapping->getRange().getStart());
+    mappedFile = std::move(newMapping);
+    return true;
+}
+
+void MappedPcmReader::read(float* const* dest, int numDestChannels, juce::int64 startFrame, int numFrames) const noexcept
+{
+    const int numChannels = juce::jmin(numDestChannels, format.numChannels);
+    if (numFrames <= 0)
+        return;
+
+    // silence outside the file; a range starting past the end is all trailing silence
+    const juce::int64 first = juce::jlimit((juce::int64) 0, format.numFrames, startFrame);
+    const juce::int64 last = juce::jlimit((juce::int64) 0, format.numFrames, startFrame + numFrames);
+    const int leading = (int) juce::jlimit((juce::int64) 0, (juce::int64) numFrames, first - startFrame);
+    const int count = (int) juce::jlimit((juce::int64) 0, (juce::int64) (numFrames - leading), last - first);
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        juce::FloatVectorOperations::clear(dest[channel], leading);
+        juce::FloatVectorOperations::clear(dest[channel] + leading + count, numFrames - leading - count);
+    }
+    if (count <= 0 || data == nullptr)
+        return;
+
+    const uint8_t* source = getFrameData(first);
+    const int bytes = format.bitsPerSample / 8;
+    const int channels = format.numChannels;
+
+    if (format.isFloat)
+    {
+        if (bytes == 4)
+            deinterleave(source, bytes, channels, dest, numChannels, leading, count, [this] (const uint8_t* p)
+            {
+                return floatFromBits((uint32_t) (format.isBigEndian ? juce::ByteOrder::bigEndianInt(p) : juce::ByteOrder::littleEndianInt(p)));
+            });
+        else
+            deinterleave(source, bytes, channels, dest, numChannels, leading, count, [this] (const uint8_t* p)
+            {
+                return floatFromBits((juce::uint64) (format.isBigEndian ? juce::ByteOrder::bigEndianInt64(p) : juce::ByteOrder::littleEndianInt64(p)));
+            });
+        return;
+    }
+
+    if (bytes == 2)
+    {
+        if (format.isBigEndian)
+            deinterleave(source, bytes, channels, dest, numChannels, leading, count, [] (const uint8_t* p)
+                         { return (float) (int16_t) juce::ByteOrder::bigEndianShort(p) * (1.0f / 32768.0f); });
+        else
+            deinterleave(source, bytes, channels, dest, numChannels, leading, count, [] (const uint8_t* p)
+                         { return (float) (int16_t) juce::ByteOrder::littleEndianShort(p) * (1.0f / 32768.0f); });
+    }
+    else if (bytes == 3)
+    {
+        if (format.isBigEndian)
+            deinterleave(source, bytes, channels, dest, numChannels, leading, count, [] (const uint8_t* p)
+                         { return (float) juce::ByteOrder::bigEndian24Bit(p) * (1.0f / 8388608.0f); });
+        else
+            deinterleave(source, bytes, channels, dest, numChannels, leading, count, [] (const uint8_t* p)
+                         { return (float) juce::ByteOrder::littleEndian24Bit(p) * (1.0f / 8388608.0f); });
+    }
+    else
+    {
+        if (format.isBigEndian)
+            deinterleave(source, bytes, channels, dest, numChannels, leading, count, [] (const uint8_t* p)
+                         { return (float) (int32_t) juce::ByteOrder::bigEndianInt(p) * (1.0f / 2147483648.0f); });
+        else
+            deinterleave(source, bytes, channels, dest, numChannels, leading, count, [] (const uint8_t* p)
+                         { return (float) (int32_t) juce::ByteOrder::littleEndianInt(p) * (1.0f / 2147483648.0f); });
+    }
+}
+
+void MappedPcmReader::prefetch(juce::int64 startFrame, juce::int64 numFrames) const noexcept
+{
+    if (data == nullptr)
+        return;
+
+    static constexpr juce::int64 PAGE_BYTES = 4096;
+    const juce::int64 bytesPerFrame = format.getBytesPerFrame();
+    const juce::int64 begin = juce::jlimit((juce::int64) 0, format.numFrames, startFrame) * bytesPerFrame;
+    const juce::int64 end = juce::jlimit((juce::int64) 0, format.numFrames, startFrame + numFrames) * bytesPerFrame;
+
+    // one read per page is enough to fault it in
+    uint8_t sum = 0;
+    for (juce::int64 offset = begin; offset < end; offset += PAGE_BYTES)
+        sum = (uint8_t) (sum + static_cast<const volatile uint8_t*>(data)[offset]);
+    if (end > begin)
+        sum = (uint8_t) (sum + static_cast<const volatile uint8_t*>(data)[end - 1]);
+    juce::ignoreUnused(sum);
+}
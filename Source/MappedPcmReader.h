@@ -0,0 +1,64 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <cstdint>
+#include <memory>
+
+/**
+ * Uncompressed PCM from a memory-mapped WAV, RF64, W64, AIFF/AIFC or CAF file.
+ *
+ * open() parses just the container header and maps the sample data; nothing is decoded up
+ * front and nothing is buffered. read() converts frames straight from the mapping into the
+ * destination channels, so any frame of a file of any size can be read at any time, with the
+ * file's own channel count and sample rate.
+ *
+ * Reading touches the mapped pages, which page faults when they are not resident yet: call
+ * prefetch() from a non-realtime thread ahead of the frames the audio thread is about to read.
+ */
+class MappedPcmReader
+{
+public:
+    struct Format
+    {
+        int numChannels = 0;
+        double sampleRate = 0.0;
+        int bitsPerSample = 0; // 16, 24 or 32 for integer samples, 32 or 64 for float
+        bool isFloat = false;
+        bool isBigEndian = false;
+        juce::int64 dataOffset = 0; // file position of the first frame
+        juce::int64 numFrames = 0;
+
+        int getBytesPerFrame() const noexcept { return numChannels * bitsPerSample / 8; }
+    };
+
+    // Reads the container header; false if the file is not one of the supported PCM layouts
+    static bool readFormat(const juce::File& file, Format& format);
+
+    //==============================================================================
+    // Maps the sample data of file; false (and nothing mapped) if it cannot be read directly
+    bool open(const juce::File& file);
+
+    const Format& getFormat() const noexcept { return format; }
+    int getNumChannels() const noexcept { return format.numChannels; }
+    double getSampleRate() const noexcept { return format.sampleRate; }
+    juce::int64 getLengthInFrames() const noexcept { return format.numFrames; }
+
+    // The frame's interleaved samples in the file's own format, inside the mapping
+    const uint8_t* getFrameData(juce::int64 frame) const noexcept { return data + frame * format.getBytesPerFrame(); }
+
+    /**
+     * Converts numFrames frames from startFrame on to float, one destination channel per file
+     * channel. Frames outside the file are silent, destination channels beyond the file's are
+     * left untouched. Realtime safe apart from the page faults described above.
+     */
+    void read(float* const* dest, int numDestChannels, juce::int64 startFrame, int numFrames) const noexcept;
+
+    // Touches every page of a frame range so a later read() finds it resident
+    void prefetch(juce::int64 startFrame, juce::int64 numFrames) const noexcept;
+
+private:
+    Format format;
+    std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+    const uint8_t* data = nullptr; // first frame, within mappedFile
+};
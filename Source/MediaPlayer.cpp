@@ -1,24 +1,77 @@
 #include "MediaPlayer.h"
 
+#include <vlc/vlc.h>
+#include <cmath>
+#include <cstring>
+
 //==============================================================================
 MediaPlayer::MediaPlayer()
 {
-    // Initialize temp audio buffer
-    tempAudioBuffer.setSize(2, 4096);
+    // Allocate the PCM buffer once for the largest stream, the audio thread never resizes it
+    pcmBuffer.prepare(MAX_STREAM_CHANNELS, PCM_FIFO_FRAMES);
     
     // Configure VLC for headless video processing
     configureVLCForHeadlessVideo();
+
+    // libVLC changes its state on its own threads (parsing, end of media), keep the audio
+    // thread's copy current
+    startTimerHz(TRANSPORT_REFRESH_HZ);
 }
 
 MediaPlayer::~MediaPlayer()
 {
+    stopTimer();
+    pcmPrefetcher.stopThread(1000);
+
     // Base class destructor handles cleanup
 }
 
 //==============================================================================
 // Legacy FFmpegVCMediaObject compatibility methods
+void MediaPlayer::start()
+{
+    if (!directPcmOpen)
+    {
+        play();
+        updateTransportState();
+        return;
+    }
+
+    // playing again after the end starts over, which the audio thread takes care of so it
+    // cannot race with the block that reaches the end
+    setDirectPcmPlaying(true);
+}
+
+void MediaPlayer::pause()
+{
+    if (directPcmOpen)
+    {
+        setDirectPcmPlaying(false);
+        return;
+    }
+    VLCMediaPlayer::pause();
+    transportPlaying = false;
+}
+
+void MediaPlayer::stop()
+{
+    if (directPcmOpen)
+    {
+        setDirectPcmPlaying(false);
+        setPosition(0.0);
+        return;
+    }
+    VLCMediaPlayer::stop();
+    transportPlaying = false;
+}
+
 bool MediaPlayer::isOpen() const
 {
+    if (directPcmOpen)
+    {
+        return true;
+    }
+
     // For image files, we're always "open" if the image is valid
     if (isImageFile)
     {
@@ -35,18 +88,69 @@ bool MediaPlayer::isOpen() const
     return result;
 }
 
+void MediaPlayer::updateTransportState()
+{
+    const bool loaded = isOpen();
+    transportLoaded = loaded;
+    transportHasAudio = loaded && hasAudio();
+
+    // libVLC starts playing asynchronously and stops by itself at the end of the media
+    transportPlaying = !directPcmOpen && VLCMediaPlayer::isPlaying();
+}
+
 int MediaPlayer::getNumChannels() const
 {
-    // Default to stereo, could be enhanced to get actual channel count from VLC
-    // VLCMediaPlayer doesn't expose getAudioChannelCount directly
-    return 2;
+    // Channel count of the audio track as reported by libVLC, stereo until it is known
+    const int channels = streamNumChannels.load();
+    return channels > 0 ? channels : 2;
+}
+
+void MediaPlayer::prepareToPlay(int newSessionBlockSize, int newSessionSampleRate)
+{
+    if (newSessionSampleRate > 0)
+    {
+        sessionSampleRate = newSessionSampleRate;
+    }
+    sessionBlockSize = newSessionBlockSize;
+
+    // the jitter buffer's target fill follows the device block size
+    pcmBuffer.setBlockSize(newSessionBlockSize, sessionSampleRate.load());
+    rebuildResampleStage();
+}
+
+void MediaPlayer::setResamplerQuality(PolyphaseResampler::Quality newQuality)
+{
+    if (resamplerQuality.exchange(newQuality) != newQuality)
+    {
+        rebuildResampleStage();
+    }
 }
 
-void MediaPlayer::prepareToPlay(int sessionBlockSize, int /*sessionSampleRate*/)
+void MediaPlayer::rebuildResampleStage()
 {
-    // Resize temp buffer for audio processing
-    tempAudioBuffer.setSize(getNumChannels(), sessionBlockSize);
-    tempAudioBuffer.clear();
+    const int inputRate = streamSampleRate.load();
+    const int outputRate = sessionSampleRate.load();
+    const int blockSize = sessionBlockSize.load();
+
+    // matching rates (or an unknown stream rate) pass straight through
+    if (inputRate <= 0 || outputRate <= 0 || blockSize <= 0 || inputRate == outputRate)
+    {
+        resampleStage.clear();
+        pcmBuffer.setFramesPerRead(0);
+        return;
+    }
+
+    auto stage = std::make_unique<ResampleStage>();
+    stage->resampler.prepare(MAX_STREAM_CHANNELS, blockSize, inputRate, outputRate,
+                             (PolyphaseResampler::Quality) resamplerQuality.load());
+    stage->input.setSize(MAX_STREAM_CHANNELS, stage->resampler.getMaxInputFrames());
+    stage->maxOutputFrames = blockSize;
+
+    // each device block now pulls stream rate frames, size the jitter buffer's target in those
+    pcmBuffer.setFramesPerRead(stage->resampler.getMaxInputFrames());
+
+    DBG("MediaPlayer - Resampling " + juce::String(inputRate) + " Hz -> " + juce::String(outputRate) + " Hz");
+    resampleStage.publish(std::move(stage));
 }
 
 void MediaPlayer::getNextAudioBlock(const juce::AudioSourceChannelInfo& info)
@@ -54,21 +158,49 @@ void MediaPlayer::getNextAudioBlock(const juce::AudioSourceChannelInfo& info)
     // Clear output first
     info.clearActiveBufferRegion();
     
-    if (!isPlaying() || !hasAudio())
+    if (!isPlayingRealtime() || !hasAudioRealtime())
         return;
+
+    if (directPcmOpen)
+    {
+        RealtimeSnapshot<MappedPcmReader>::ScopedAccess reader(directPcm);
+        if (reader)
+        {
+            readDirectPcm(*reader, info);
+        }
+        return;
+    }
     
-    // For now, we rely on the base VLCMediaPlayer's audio handling
-    // This could be enhanced to provide more direct audio access
-    
-    // Apply gain if needed
-    float gain = audioGain.load();
-    if (gain != 1.0f && info.buffer != nullptr)
+    // Deinterleave what libVLC has delivered once the jitter buffer has reached its target
+    // fill; anything missing stays silent
+    RealtimeSnapshot<ResampleStage>::ScopedAccess stage(resampleStage);
+    if (stage)
     {
-        for (int channel = 0; channel < info.buffer->getNumChannels(); ++channel)
+        // a block larger than the stage was prepared for stays silent until prepareToPlay()
+        // rebuilds it, reading it unresampled would play at the stream's pitch
+        if (info.numSamples > stage->maxOutputFrames)
+            return;
+
+        auto& resampler = stage->resampler;
+        const int numChannels = juce::jmin(info.buffer->getNumChannels(), MAX_STREAM_CHANNELS);
+        const int inputFrames = resampler.getInputFramesNeeded(info.numSamples);
+
+        for (int channel = 0; channel < numChannels; ++channel)
         {
-            juce::FloatVectorOperations::multiply(info.buffer->getWritePointer(channel, info.startSample),
-                                                 gain, info.numSamples);
+            stage->input.clear(channel, 0, inputFrames);
         }
+        pcmBuffer.read(stage->input, 0, inputFrames);
+
+        float* outputs[MAX_STREAM_CHANNELS];
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            outputs[channel] = info.buffer->getWritePointer(channel, info.startSample);
+        }
+        resampler.process(stage->input.getArrayOfReadPointers(), inputFrames, outputs, numChannels, info.numSamples);
+    }
+    else
+    {
+        pcmBuffer.read(*info.buffer, info.startSample, info.numSamples);
     }
 }
 
@@ -149,6 +281,11 @@ juce::Image& MediaPlayer::getFrame()
 
 double MediaPlayer::getLengthInSeconds() const
 {
+    if (directPcmOpen)
+    {
+        return (double) directPcmReader->getLengthInFrames() / directPcmReader->getSampleRate();
+    }
+
     // For image files, return a fixed duration (e.g., 10 seconds for UI purposes)
     if (isImageFile)
     {
@@ -167,6 +304,11 @@ double MediaPlayer::getPositionInSeconds() const
         return 0.0;
     }
     
+    if (directPcmOpen)
+    {
+        return (double) getDirectPcmFrame() / directPcmReader->getSampleRate();
+    }
+
     // For video/audio files, use VLC position
     return getCurrentTime();
 }
@@ -180,6 +322,17 @@ void MediaPlayer::setPosition(double newPositionInSeconds)
         DBG("MediaPlayer::setPosition - Ignoring seek for image file");
         return;
     }
+
+    if (directPcmOpen)
+    {
+        // sample accurate: the audio thread continues from exactly this frame, whose pages are
+        // faulted in here so the first blocks after the seek do not wait on the disk
+        const auto frame = juce::jlimit((juce::int64) 0, directPcmReader->getLengthInFrames(),
+                                        (juce::int64) std::llround(newPositionInSeconds * directPcmReader->getSampleRate()));
+        directPcmReader->prefetch(frame, (juce::int64) (directPcmReader->getSampleRate() * PCM_SEEK_PREFETCH_SECONDS));
+        directPcmSeekFrame = frame;
+        return;
+    }
     
     double duration = getTotalDuration();
     if (duration > 0.0 && newPositionInSeconds >= 0.0 && newPositionInSeconds <= duration)
@@ -198,7 +351,7 @@ void MediaPlayer::setPositionNormalized(double newPositionNormalized)
 {
     DBG("MediaPlayer::setPositionNormalized - Seeking to normalized position: " + juce::String(newPositionNormalized));
     
-    double duration = getTotalDuration();
+    double duration = directPcmOpen ? getLengthInSeconds() : getTotalDuration();
     if (duration > 0.0)
     {
         double targetTimeInSeconds = newPositionNormalized * duration;
@@ -254,6 +407,11 @@ bool MediaPlayer::open(juce::URL filepath)
             DBG("MediaPlayer::open - Detected image file");
             return loadImageFile(file);
         }
+        else if (openDirectPcm(file))
+        {
+            DBG("MediaPlayer::open - Reading uncompressed PCM directly");
+            return true;
+        }
         else
         {
             // Handle as video/audio file via VLC
@@ -263,6 +421,7 @@ bool MediaPlayer::open(juce::URL filepath)
             if (result)
             {
                 DBG("MediaPlayer::open - VLC open successful");
+                registerAudioCallbacks();
                 
                 // Wait a bit for media parsing to complete
                 // VLC needs time to analyze the file and determine track information
@@ -290,6 +449,10 @@ bool MediaPlayer::open(juce::URL filepath)
                 DBG("MediaPlayer::open - Final state - hasVideo: " + juce::String(VLCMediaPlayer::hasVideo() ? "true" : "false"));
                 DBG("MediaPlayer::open - Final state - hasAudio: " + juce::String(VLCMediaPlayer::hasAudio() ? "true" : "false"));
                 DBG("MediaPlayer::open - Final state - getTotalDuration: " + juce::String(getTotalDuration()));
+
+                readStreamFormat();
+                updateTransportState();
+                DBG("MediaPlayer::open - Final state - audio channels: " + juce::String(getNumChannels()));
             }
             else
             {
@@ -303,10 +466,19 @@ bool MediaPlayer::open(juce::URL filepath)
 
 juce::Result MediaPlayer::load(const juce::File& file)
 {
+    if (openDirectPcm(file))
+    {
+        currentMediaFilePath = juce::URL(file);
+        return juce::Result::ok();
+    }
+
     juce::String error;
     if (VLCMediaPlayer::open(file, &error))
     {
         currentMediaFilePath = juce::URL(file);
+        registerAudioCallbacks();
+        readStreamFormat();
+        updateTransportState();
         
         // Notify playback started callback if set
         if (onPlaybackStarted != nullptr)
@@ -323,6 +495,14 @@ void MediaPlayer::close()
 {
     // Reset image file state
     isImageFile = false;
+
+    // Stop reading the mapped file before it is released
+    pcmPrefetcher.stopThread(1000);
+    pcmPrefetcher.reader = nullptr;
+    directPcmOpen = false;
+    setDirectPcmPlaying(false);
+    directPcm.clear();
+    directPcmReader = nullptr;
     
     // Clear the local image frame
     {
@@ -332,6 +512,10 @@ void MediaPlayer::close()
     
     // Call base class close (this also clears the VLC video frame)
     VLCMediaPlayer::close();
+
+    streamNumChannels = 0;
+    pcmBuffer.requestFlush();
+    updateTransportState();
 }
 
 void MediaPlayer::setOffsetSeconds(double seconds)
@@ -352,6 +536,222 @@ void MediaPlayer::videoEnded()
     }
 }
 
+//==============================================================================
+// Direct PCM playback
+bool MediaPlayer::openDirectPcm(const juce::File& file)
+{
+    auto reader = std::make_unique<MappedPcmReader>();
+    if (!reader->open(file) || reader->getNumChannels() > MAX_STREAM_CHANNELS)
+    {
+        return false; // compressed, unusual or too wide for the stream buffers, left to libVLC
+    }
+    close(); // whatever was open before, libVLC or mapped
+
+    DBG("MediaPlayer - Direct PCM: " + juce::String(reader->getNumChannels()) + " channels, "
+        + juce::String(reader->getSampleRate()) + " Hz, " + juce::String(reader->getLengthInFrames()) + " frames");
+
+    directPcmPosition = 0;
+    directPcmSeekFrame = -1;
+    setDirectPcmPlaying(false);
+    reader->prefetch(0, (juce::int64) (reader->getSampleRate() * PCM_SEEK_PREFETCH_SECONDS));
+
+    directPcmReader = reader.get();
+    directPcm.publish(std::move(reader));
+    streamNumChannels = directPcmReader->getNumChannels();
+    if ((int) directPcmReader->getSampleRate() != streamSampleRate.load())
+    {
+        streamSampleRate = (int) directPcmReader->getSampleRate();
+        rebuildResampleStage();
+    }
+    directPcmOpen = true;
+
+    pcmPrefetcher.reader = directPcmReader;
+    pcmPrefetcher.startThread();
+    updateTransportState();
+    return true;
+}
+
+void MediaPlayer::setDirectPcmPlaying(bool shouldPlay)
+{
+    auto transport = directPcmTransport.load();
+    for (;;)
+    {
+        // every start() bumps the count, so a stop at the end of the file that was decided
+        // before it fails its compare-exchange instead of undoing it
+        const juce::uint32 next = shouldPlay ? ((transport | 1u) + 2u) : (transport & ~1u);
+        if (directPcmTransport.compare_exchange_weak(transport, next))
+            return;
+    }
+}
+
+juce::int64 MediaPlayer::getDirectPcmFrame() const
+{
+    // a seek the audio thread has not picked up yet is already the position
+    const auto seek = directPcmSeekFrame.load();
+    return seek >= 0 ? seek : directPcmPosition.load();
+}
+
+void MediaPlayer::readDirectPcm(const MappedPcmReader& reader, const juce::AudioSourceChannelInfo& info)
+{
+    RealtimeSnapshot<ResampleStage>::ScopedAccess stage(resampleStage);
+
+    // the transport as this block found it, see setDirectPcmPlaying()
+    auto transport = directPcmTransport.load();
+    if ((transport & 1u) == 0)
+    {
+        return;
+    }
+
+    juce::int64 position = directPcmPosition.load();
+    const auto seek = directPcmSeekFrame.exchange(-1);
+    if (seek >= 0 || position >= reader.getLengthInFrames())
+    {
+        position = seek >= 0 ? seek : 0; // started again after playing to the end
+        if (stage)
+        {
+            stage->resampler.reset(); // no history from before the seek
+        }
+    }
+
+    const int numChannels = juce::jmin(info.buffer->getNumChannels(), reader.getNumChannels());
+    float* outputs[MAX_STREAM_CHANNELS];
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        outputs[channel] = info.buffer->getWritePointer(channel, info.startSample);
+    }
+
+    if (stage && info.numSamples <= stage->maxOutputFrames)
+    {
+        auto& resampler = stage->resampler;
+        const int inputFrames = resampler.getInputFramesNeeded(info.numSamples);
+        reader.read(stage->input.getArrayOfWritePointers(), numChannels, position, inputFrames);
+        resampler.process(stage->input.getArrayOfReadPointers(), inputFrames, outputs, numChannels, info.numSamples);
+        position += inputFrames;
+    }
+    else
+    {
+        reader.read(outputs, numChannels, position, info.numSamples);
+        position += info.numSamples;
+    }
+
+    directPcmPosition = position;
+    if (position >= reader.getLengthInFrames())
+    {
+        // played to the end; leaves the transport alone if start() or pause() got in first
+        directPcmTransport.compare_exchange_strong(transport, transport & ~1u);
+    }
+}
+
+void MediaPlayer::PcmPrefetcher::run()
+{
+    const auto readAhead = (juce::int64) (reader->getSampleRate() * READ_AHEAD_SECONDS);
+    while (!threadShouldExit())
+    {
+        reader->prefetch(player.getDirectPcmFrame(), readAhead);
+        wait(50);
+    }
+}
+
+//==============================================================================
+// libVLC audio output
+void MediaPlayer::registerAudioCallbacks()
+{
+    // VLCMediaPlayer owns the libvlc_media_player_t, we only route its decoded audio to us
+    // instead of libVLC's own audio output. Must happen before playback starts.
+    libvlc_media_player_t* player = getNativeMediaPlayer();
+    if (player == nullptr)
+    {
+        return;
+    }
+
+    libvlc_audio_set_callbacks(player, &MediaPlayer::vlcAudioPlay, nullptr, nullptr,
+                               &MediaPlayer::vlcAudioFlush, nullptr, this);
+    libvlc_audio_set_format_callbacks(player, &MediaPlayer::vlcAudioSetup, &MediaPlayer::vlcAudioCleanup);
+}
+
+void MediaPlayer::readStreamFormat()
+{
+    // The format callback only fires once playback starts; read the channel count and rate from
+    // the parsed track info so the decoder can be configured before the first block arrives
+    libvlc_media_player_t* player = getNativeMediaPlayer();
+    if (player == nullptr)
+    {
+        return;
+    }
+
+    libvlc_media_t* media = libvlc_media_player_get_media(player);
+    if (media == nullptr)
+    {
+        return;
+    }
+
+    unsigned channels = 0;
+    unsigned rate = 0;
+    libvlc_media_track_t** tracks = nullptr;
+    const unsigned trackCount = libvlc_media_tracks_get(media, &tracks);
+    for (unsigned i = 0; i < trackCount; ++i)
+    {
+        if (tracks[i]->i_type == libvlc_track_audio && tracks[i]->audio != nullptr)
+        {
+            channels = tracks[i]->audio->i_channels;
+            rate = tracks[i]->audio->i_rate;
+            break;
+        }
+    }
+    libvlc_media_tracks_release(tracks, trackCount);
+    libvlc_media_release(media);
+
+    if (channels > 0)
+    {
+        streamNumChannels = juce::jmin((int) channels, MAX_STREAM_CHANNELS);
+    }
+    if (rate > 0 && (int) rate != streamSampleRate.load())
+    {
+        streamSampleRate = (int) rate;
+        rebuildResampleStage();
+    }
+}
+
+int MediaPlayer::vlcAudioSetup(void** opaque, char* format, unsigned* rate, unsigned* channels)
+{
+    auto* self = static_cast<MediaPlayer*>(*opaque);
+    if (*channels == 0 || *channels > (unsigned) MAX_STREAM_CHANNELS)
+    {
+        DBG("MediaPlayer - Unsupported audio channel count: " + juce::String(*channels));
+        return -1;
+    }
+
+    // Keep the native channel count and rate and take 32-bit float, libVLC converts from the
+    // decoder's sample format; rate conversion happens in our own resample stage
+    std::memcpy(format, "FL32", 4);
+
+    self->pcmBuffer.setNumChannels((int) *channels);
+    self->streamNumChannels = (int) *channels;
+    if ((int) *rate != self->streamSampleRate.load())
+    {
+        self->streamSampleRate = (int) *rate;
+        self->rebuildResampleStage();
+    }
+    return 0;
+}
+
+void MediaPlayer::vlcAudioCleanup(void* opaque)
+{
+    static_cast<MediaPlayer*>(opaque)->pcmBuffer.requestFlush();
+}
+
+void MediaPlayer::vlcAudioPlay(void* opaque, const void* samples, unsigned count, int64_t /*pts*/)
+{
+    // Called on libVLC's decoder thread; frames that do not fit are dropped and counted as an overrun
+    static_cast<MediaPlayer*>(opaque)->pcmBuffer.write(static_cast<const float*>(samples), (int) count);
+}
+
+void MediaPlayer::vlcAudioFlush(void* opaque, int64_t /*pts*/)
+{
+    // Seek or stop: the queued audio belongs to the old position
+    static_cast<MediaPlayer*>(opaque)->pcmBuffer.requestFlush();
+}
+
 //==============================================================================
 // Internal methods
 void MediaPlayer::refreshVideoFrame()
@@ -380,6 +780,8 @@ bool MediaPlayer::loadImageFile(const juce::File& imageFile)
     if (imageFileFrame.isValid())
     {
         isImageFile = true;
+        transportLoaded = true; // imageFileMutex is held, so not through updateTransportState()
+        transportHasAudio = false;
         DBG("Successfully loaded image file: " + imageFile.getFullPathName());
         return true;
     }
@@ -3,14 +3,21 @@
 #include <JuceHeader.h>
 #include <juce_libvlc/juce_libvlc.h>
 
+#include "JitterBuffer.h"
+#include "MappedPcmReader.h"
+#include "PolyphaseResampler.h"
+#include "RealtimeSnapshot.h"
+
 /**
  * VLC-based implementation that extends VLCMediaPlayer.
  * 
  * This implementation provides two different logic paths:
  * 1. JUCE Image display: For image files, display directly via JUCE Image
  * 2. libVLC video decoding: For video files, use libVLC for decoding but always use audio sample time for seeking position (even if no audio)
+ * 3. Direct PCM: uncompressed WAV/RF64/W64/AIFF/CAF files bypass libVLC and are read from a memory mapping
  */
-class MediaPlayer : public VLCMediaPlayer
+class MediaPlayer : public VLCMediaPlayer,
+                    private juce::Timer
 {
 public:
     MediaPlayer();
@@ -27,9 +34,9 @@ public:
 
     //==============================================================================
     // Legacy FFmpegVCMediaObject compatibility methods
-    void start() { play(); }
-    void pause() { VLCMediaPlayer::pause(); }
-    void stop() { VLCMediaPlayer::stop(); }
+    void start();
+    void pause();
+    void stop();
     bool isOpen() const;
     bool clipLoaded() const { return isOpen(); }
     int getNumChannels() const;
@@ -38,20 +45,31 @@ public:
     void releaseResources();
     
     juce::URL getMediaFilePath() const;
-    int64_t getNextReadPositionInSamples() const { return getCurrentSample(); }
-    int64_t getAudioSampleRate() const { return getSampleRate(); }
+    int64_t getNextReadPositionInSamples() const { return directPcmOpen ? getDirectPcmFrame() : getCurrentSample(); }
+    int64_t getAudioSampleRate() const { return directPcmOpen ? streamSampleRate.load() : getSampleRate(); }
     int64_t getVideoFrameRate() const;
     juce::Image& getFrame();
     double getLengthInSeconds() const;
     double getPositionInSeconds() const;
     void setPosition(double newPositionInSeconds);
-    bool isPlaying() const { return VLCMediaPlayer::isPlaying(); }
+    bool isPlaying() const { return directPcmOpen ? isDirectPcmPlaying() : VLCMediaPlayer::isPlaying(); }
     bool hasVideo() const { return isImageFile || VLCMediaPlayer::hasVideo(); }
-    bool hasAudio() const { return !isImageFile && VLCMediaPlayer::hasAudio(); }
+    bool hasAudio() const { return directPcmOpen || (!isImageFile && VLCMediaPlayer::hasAudio()); }
+
+    // Audio thread view of clipLoaded()/hasAudio()/isPlaying(). Those lock imageFileMutex or
+    // query libVLC, so the device callback reads these cached copies instead; they are
+    // refreshed on the message thread by a timer and by every transport change.
+    bool clipLoadedRealtime() const noexcept { return transportLoaded.load(); }
+    bool hasAudioRealtime() const noexcept { return transportHasAudio.load(); }
+    bool isPlayingRealtime() const noexcept { return directPcmOpen ? isDirectPcmPlaying() : transportPlaying.load(); }
     void setPositionNormalized(double newPositionNormalized);
     void setPlaySpeed(double newSpeed);
     double getPlaySpeed() const;
     void setGain(float newGain);
+    JitterBuffer::Stats getAudioBufferStats() const { return pcmBuffer.getStats(); }
+    void setResamplerQuality(PolyphaseResampler::Quality newQuality);
+    PolyphaseResampler::Quality getResamplerQuality() const { return (PolyphaseResampler::Quality) resamplerQuality.load(); }
+    int getStreamSampleRate() const { return streamSampleRate.load(); }
     float getGain() const;
     
     bool open(juce::URL filepath);
@@ -76,6 +94,14 @@ private:
     std::atomic<double> offsetSeconds { 0.0 };
     std::atomic<double> videoFrameRate { 30.0 };
     
+    // Transport state cached for the audio thread, see clipLoadedRealtime()
+    static constexpr int TRANSPORT_REFRESH_HZ = 30;
+    std::atomic<bool> transportLoaded { false };
+    std::atomic<bool> transportHasAudio { false };
+    std::atomic<bool> transportPlaying { false };
+    void updateTransportState();
+    void timerCallback() override { updateTransportState(); }
+
     // Note: Video frame and mutex are inherited from VLCMediaPlayer base class.
     // Do NOT declare them here as it would shadow the base class members
     // and break video frame updates from VLC callbacks.
@@ -85,13 +111,74 @@ private:
     std::mutex imageFileMutex;
     
     // Audio processing
-    juce::AudioBuffer<float> tempAudioBuffer;
+    // libVLC hands us decoded interleaved PCM in bursts on its own thread through these
+    // callbacks, getNextAudioBlock() deinterleaves it on the audio thread
+    static constexpr int MAX_STREAM_CHANNELS = 64;
+    static constexpr int PCM_FIFO_FRAMES = 1 << 15; // ~0.7s at 48kHz, allocated once for MAX_STREAM_CHANNELS
+    JitterBuffer pcmBuffer;
+    std::atomic<int> streamNumChannels { 0 };  // channel count of the current audio track
+    std::atomic<int> streamSampleRate { 0 };   // native rate of the current audio track
+    std::atomic<int> sessionSampleRate { 44100 };
+    std::atomic<int> sessionBlockSize { 512 };
+
+    // Converts the stream rate to the device rate before anything else touches the audio, so
+    // it runs on the stream's channels ahead of any transcode. Rebuilt off the audio thread
+    // whenever either rate or the quality changes.
+    struct ResampleStage
+    {
+        PolyphaseResampler resampler;
+        juce::AudioBuffer<float> input; // stream rate frames pulled from pcmBuffer
+        int maxOutputFrames = 0;
+    };
+    RealtimeSnapshot<ResampleStage> resampleStage;
+    std::atomic<int> resamplerQuality { PolyphaseResampler::QualityStandard };
+    void rebuildResampleStage();
+
+    // Uncompressed PCM files skip libVLC entirely: the audio thread converts frames straight
+    // from the mapped file with its own sample-accurate transport, at the file's exact channel
+    // count. Seeks are handed over through directPcmSeekFrame and land on the next block.
+    static constexpr double PCM_SEEK_PREFETCH_SECONDS = 0.25;
+    RealtimeSnapshot<MappedPcmReader> directPcm;
+    MappedPcmReader* directPcmReader = nullptr; // message thread view of the published reader
+    std::atomic<bool> directPcmOpen { false };
+    std::atomic<juce::uint32> directPcmTransport { 0 }; // bit 0 is playing, the bits above count start() calls
+    std::atomic<juce::int64> directPcmPosition { 0 };   // next file frame to read, written by the audio thread
+    std::atomic<juce::int64> directPcmSeekFrame { -1 }; // pending seek, -1 when there is none
+    bool openDirectPcm(const juce::File& file);
+    void readDirectPcm(const MappedPcmReader& reader, const juce::AudioSourceChannelInfo& info);
+    juce::int64 getDirectPcmFrame() const;
+    bool isDirectPcmPlaying() const noexcept { return (directPcmTransport.load() & 1u) != 0; }
+    void setDirectPcmPlaying(bool shouldPlay);
+
+    // Faults in the mapped pages ahead of the play position, so the audio thread reads from
+    // memory rather than waiting on the disk. Only runs while a direct PCM file is open.
+    class PcmPrefetcher : public juce::Thread
+    {
+    public:
+        static constexpr double READ_AHEAD_SECONDS = 2.0;
+
+        explicit PcmPrefetcher(MediaPlayer& owner) : juce::Thread("PCM Prefetch"), player(owner) {}
+        void run() override;
+
+        const MappedPcmReader* reader = nullptr; // only changed while the thread is stopped
+
+    private:
+        MediaPlayer& player;
+    };
+    PcmPrefetcher pcmPrefetcher { *this };
+
+    void registerAudioCallbacks();
+    void readStreamFormat();
+    static int vlcAudioSetup(void** opaque, char* format, unsigned* rate, unsigned* channels);
+    static void vlcAudioCleanup(void* opaque);
+    static void vlcAudioPlay(void* opaque, const void* samples, unsigned count, int64_t pts);
+    static void vlcAudioFlush(void* opaque, int64_t pts);
     
     // Audio device manager reference
     juce::AudioDeviceManager* audioDeviceManager = nullptr;
     
     // Image file handling
-    bool isImageFile = false;
+    std::atomic<bool> isImageFile { false };
     
     // Video frame refresh counter
     mutable std::atomic<int> frameRefreshCounter { 0 };
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include "TripleBuffer.h"
+
+/**
+ * Timestamped listener orientation handed from a non-realtime writer to the audio thread.
+ *
+ * The writer pushes yaw/pitch/roll whenever it polls the tracker/UI; each pushed sample is
+ * stamped, converted to a quaternion and carries an angular velocity estimated from the
+ * previous change of orientation. Polling faster than the orientation changes pushes repeats,
+ * which keep the velocity until they have gone on for longer than the listener takes between
+ * moves. The audio thread reads the latest sample wait-free and can optionally extrapolate it
+ * to the time the block will actually be heard.
+ */
+class OrientationChannel
+{
+public:
+    struct Quaternion
+    {
+        float w = 1.0f, x = 0.0f, y = 0.0f, z = 0.0f;
+
+        Quaternion operator*(const Quaternion& q) const noexcept
+        {
+            return { w * q.w - x * q.x - y * q.y - z * q.z,
+                     w * q.x + x * q.w + y * q.z - z * q.y,
+                     w * q.y - x * q.z + y * q.w + z * q.x,
+                     w * q.z + x * q.y - y * q.x + z * q.w };
+        }
+
+        Quaternion conjugate() const noexcept { return { w, -x, -y, -z }; }
+    };
+
+    struct Sample
+    {
+        float yaw = 0.0f, pitch = 0.0f, roll = 0.0f; // degrees, as passed to Mach1Decode::setRotationDegrees
+        Quaternion rotation;
+        float angularVelocity[3] { 0.0f, 0.0f, 0.0f }; // radians per second, world frame
+        double timestamp = 0.0;       // seconds, see now()
+        double updateInterval = 0.01; // smoothed seconds between orientation changes
+    };
+
+    // Samples older than this are not extrapolated, the listener has stopped moving
+    static constexpr double MAX_SAMPLE_AGE_SECONDS = 0.1;
+
+    // Repeated samples keep the last velocity for this many update intervals, then zero it
+    static constexpr double STALE_UPDATE_INTERVALS = 3.0;
+
+    static double getStaleTimeout(double updateInterval) noexcept
+    {
+        return juce::jmin(MAX_SAMPLE_AGE_SECONDS, STALE_UPDATE_INTERVALS * updateInterval);
+    }
+
+    static double now() noexcept
+    {
+        return juce::Time::getMillisecondCounterHiRes() * 0.001;
+    }
+
+    //==============================================================================
+    // Writer side, a single non-realtime thread
+    void push(float yaw, float pitch, float roll, double timestamp = now()) noexcept
+    {
+        Sample next;
+        next.yaw = yaw;
+        next.pitch = pitch;
+        next.roll = roll;
+        next.rotation = fromEulerDegrees(yaw, pitch, roll);
+        next.timestamp = timestamp;
+        next.updateInterval = lastWritten.updateInterval;
+        std::copy(std::begin(lastWritten.angularVelocity), std::end(lastWritten.angularVelocity), next.angularVelocity);
+
+        // repeats carry no motion, measuring over them would pull the velocity towards zero
+        // and the next change would then be divided by a single poll interval
+        const bool changed = yaw != lastWritten.yaw || pitch != lastWritten.pitch || roll != lastWritten.roll;
+        const double sinceChange = timestamp - lastChangeTime;
+
+        if (changed)
+        {
+            if (sinceChange > 0.0 && sinceChange < MAX_SAMPLE_AGE_SECONDS)
+            {
+                // world frame delta rotation since the previous change, as an angular velocity;
+                // the previous sample still holds that orientation
+                auto delta = next.rotation * lastWritten.rotation.conjugate();
+                if (delta.w < 0.0f)
+                    delta = { -delta.w, -delta.x, -delta.y, -delta.z };
+
+                const float sinHalf = std::sqrt(delta.x * delta.x + delta.y * delta.y + delta.z * delta.z);
+                const float angle = 2.0f * std::atan2(sinHalf, delta.w);
+                const float scale = sinHalf > 1.0e-6f ? angle / (sinHalf * (float) sinceChange) : 0.0f;
+
+                // light smoothing, UI input arrives in bursts at frame rate
+                const float velocity[3] = { delta.x * scale, delta.y * scale, delta.z * scale };
+                for (int i = 0; i < 3; ++i)
+                    next.angularVelocity[i] = 0.5f * lastWritten.angularVelocity[i] + 0.5f * velocity[i];
+            }
+            else
+            {
+                // moving again after a pause: no earlier change to measure against yet
+                std::fill(std::begin(next.angularVelocity), std::end(next.angularVelocity), 0.0f);
+            }
+
+            if (sinceChange > 0.0 && sinceChange < 0.5)
+                next.updateInterval = 0.9 * next.updateInterval + 0.1 * sinceChange;
+            lastChangeTime = timestamp;
+        }
+        else if (sinceChange > getStaleTimeout(next.updateInterval))
+        {
+            // no change for several update intervals, the listener has stopped
+            std::fill(std::begin(next.angularVelocity), std::end(next.angularVelocity), 0.0f);
+        }
+
+        lastWritten = next;
+        samples.write(next);
+    }
+
+    //==============================================================================
+    // Reader side, the audio thread
+    Sample read() noexcept
+    {
+        return samples.read();
+    }
+
+    /**
+     * Extrapolates the sample's rotation to atTime (limited to maxHorizonSeconds ahead)
+     * using its angular velocity, and returns the result as yaw/pitch/roll degrees.
+     */
+    static void predict(const Sample& sample, double atTime, double maxHorizonSeconds,
+                        float& yaw, float& pitch, float& roll) noexcept
+    {
+        const double age = atTime - sample.timestamp;
+        const double horizon = juce::jlimit(0.0, maxHorizonSeconds, age);
+        if (age > MAX_SAMPLE_AGE_SECONDS + maxHorizonSeconds || horizon <= 0.0)
+        {
+            yaw = sample.yaw;
+            pitch = sample.pitch;
+            roll = sample.roll;
+            return;
+        }
+
+        const float rx = sample.angularVelocity[0] * (float) horizon;
+        const float ry = sample.angularVelocity[1] * (float) horizon;
+        const float rz = sample.angularVelocity[2] * (float) horizon;
+        const float angle = std::sqrt(rx * rx + ry * ry + rz * rz);
+        if (angle < 1.0e-6f)
+        {
+            yaw = sample.yaw;
+            pitch = sample.pitch;
+            roll = sample.roll;
+            return;
+        }
+
+        const float s = std::sin(angle * 0.5f) / angle;
+        const Quaternion step { std::cos(angle * 0.5f), rx * s, ry * s, rz * s };
+        toEulerDegrees(step * sample.rotation, yaw, pitch, roll);
+    }
+
+    //==============================================================================
+    // Yaw about Y, then pitch about X, then roll about Z; the two conversions are exact inverses
+    // for |pitch| < 90, so a sample that is not extrapolated round-trips unchanged.
+    static Quaternion fromEulerDegrees(float yaw, float pitch, float roll) noexcept
+    {
+        const float hy = juce::degreesToRadians(yaw) * 0.5f;
+        const float hp = juce::degreesToRadians(pitch) * 0.5f;
+        const float hr = juce::degreesToRadians(roll) * 0.5f;
+        const Quaternion qy { std::cos(hy), 0.0f, std::sin(hy), 0.0f };
+        const Quaternion qp { std::cos(hp), std::sin(hp), 0.0f, 0.0f };
+        const Quaternion qr { std::cos(hr), 0.0f, 0.0f, std::sin(hr) };
+        return qy * qp * qr;
+    }
+
+    static void toEulerDegrees(const Quaternion& q, float& yaw, float& pitch, float& roll) noexcept
+    {
+        const float r02 = 2.0f * (q.x * q.z + q.w * q.y);
+        const float r22 = 1.0f - 2.0f * (q.x * q.x + q.y * q.y);
+        const float r12 = 2.0f * (q.y * q.z - q.w * q.x);
+        const float r10 = 2.0f * (q.x * q.y + q.w * q.z);
+        const float r11 = 1.0f - 2.0f * (q.x * q.x + q.z * q.z);
+
+        yaw = juce::radiansToDegrees(std::atan2(r02, r22));
+        pitch = juce::radiansToDegrees(std::asin(juce::jlimit(-1.0f, 1.0f, -r12)));
+        roll = juce::radiansToDegrees(std::atan2(r10, r11));
+    }
+
+private:
+    TripleBuffer<Sample> samples;
+
+    // writer-side history
+    Sample lastWritten;
+    double lastChangeTime = 0.0;
+};
@@ -250,6 +250,42 @@ bool PlayerOSC::sendPlayerYPR(float yaw, float pitch, float roll)
     return false;
 }
 
+bool PlayerOSC::sendCallbackStats(const CallbackStats& stats)
+{
+    if (isConnected && port > 0) {
+        if (!juce::OSCSender::connect("127.0.0.1", helperPort))
+        {
+            isConnected = false;
+            return false;
+        }
+
+        try
+        {
+            juce::OSCMessage m = juce::OSCMessage(juce::OSCAddressPattern("/playerAudioStats"));
+            m.addString(stats.inputFormat);
+            m.addInt32(stats.numInputChannels);
+            m.addInt32(stats.blockSize);
+            m.addFloat32(stats.sampleRate);
+            m.addFloat32(stats.averageLoad); // last second
+            m.addFloat32(stats.peakLoad);    // last second
+            m.addFloat32(stats.p99Load);     // since the format or device last changed
+            for (auto load : stats.stageP99Load)
+                m.addFloat32(load);
+            m.addInt32(stats.windowDeadlineMisses);
+            m.addInt32(stats.totalDeadlineMisses);
+            m.addInt32(stats.totalBlocks);
+            isConnected = juce::OSCSender::send(m);
+        }
+        catch (...)
+        {
+            isConnected = false;
+            return false;
+        }
+        return isConnected;
+    }
+    return false;
+}
+
 int PlayerOSC::getNumberOfMonitors()
 {
     return num_monitor_instances;
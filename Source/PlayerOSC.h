@@ -36,6 +36,19 @@ public:
     bool IsActivePlayer();
     int getNumberOfMonitors();
     bool sendPlayerYPR(float yaw, float pitch, float roll);
+
+    // Audio callback load summary, loads are fractions of the block period
+    struct CallbackStats
+    {
+        std::string inputFormat;
+        int numInputChannels = 0;
+        int blockSize = 0;
+        float sampleRate = 0;
+        float averageLoad = 0, peakLoad = 0, p99Load = 0;
+        float stageP99Load[4] = {}; // media pull, transcode, decode, meter
+        int windowDeadlineMisses = 0, totalDeadlineMisses = 0, totalBlocks = 0;
+    };
+    bool sendCallbackStats(const CallbackStats& stats);
     bool connectToHelper();
     bool disconnectToHelper();
     
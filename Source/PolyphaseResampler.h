@@ -0,0 +1,250 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <cmath>
+#include <vector>
+
+#include "DecodeKernels.h" // for the M1_DECODE_KERNEL_* SIMD selection
+
+/**
+ * Multichannel windowed-sinc polyphase resampler for arbitrary rate ratios.
+ *
+ * The Kaiser-windowed sinc is tabulated at a fixed number of phases; each output sample
+ * linearly interpolates its coefficients between the two nearest phases. Every channel sees
+ * the same output positions, so the interpolated coefficients are computed once per output
+ * sample and shared, leaving one vectorised dot product per channel and output sample.
+ *
+ * prepare() allocates everything; process() is realtime safe. The caller asks how many input
+ * frames the next block needs with getInputFramesNeeded() and passes exactly that many.
+ */
+class PolyphaseResampler
+{
+public:
+    enum Quality
+    {
+        QualityDraft = 0, // 16 taps, for very high channel counts on slow machines
+        QualityStandard,  // 32 taps
+        QualityHigh       // 64 taps, transparent for mastering review
+    };
+
+    void prepare(int maxChannels, int maxOutputFrames, double newInputRate, double newOutputRate, Quality newQuality)
+    {
+        inputRate = newInputRate;
+        outputRate = newOutputRate;
+        quality = newQuality;
+        step = inputRate / outputRate;
+
+        const auto& preset = getPreset(quality);
+        numTaps = preset.taps;
+        numPhases = preset.phases;
+        buildPhaseTable(preset);
+
+        maxOutput = maxOutputFrames;
+        maxInput = (int) std::ceil(maxOutputFrames * step) + 2;
+        lineLength = 2 * numTaps + maxInput;
+
+        lines.assign((size_t) maxChannels, std::vector<float>((size_t) lineLength, 0.0f));
+        blockCoeffs.assign((size_t) maxOutputFrames * (size_t) numTaps, 0.0f);
+        blockOffsets.assign((size_t) maxOutputFrames, 0);
+        reset();
+    }
+
+    void reset()
+    {
+        for (auto& line : lines)
+            std::fill(line.begin(), line.end(), 0.0f);
+
+        // start with a history of silence so the first outputs have a full filter window
+        stored = numTaps - 1;
+        readPosition = 0.0;
+    }
+
+    bool isPrepared() const noexcept { return numTaps > 0; }
+    double getInputRate() const noexcept { return inputRate; }
+    double getOutputRate() const noexcept { return outputRate; }
+    Quality getQuality() const noexcept { return quality; }
+    int getMaxInputFrames() const noexcept { return maxInput; }
+
+    // Number of input frames process() must be given to produce numOutputFrames
+    int getInputFramesNeeded(int numOutputFrames) const noexcept
+    {
+        if (numOutputFrames <= 0)
+            return 0;
+
+        const int lastIndex = (int) std::floor(readPosition + (numOutputFrames - 1) * step);
+        return juce::jmax(0, lastIndex + numTaps - stored);
+    }
+
+    void process(const float* const* input, int numInputFrames,
+                 float* const* output, int numChannels, int numOutputFrames) noexcept
+    {
+        jassert(numOutputFrames <= maxOutput && numInputFrames <= maxInput);
+        jassert(numChannels <= (int) lines.size());
+        jassert(numInputFrames >= getInputFramesNeeded(numOutputFrames));
+
+        // coefficients and window offsets for this block, shared by every channel
+        double position = readPosition;
+        const float phaseScale = (float) numPhases;
+        for (int i = 0; i < numOutputFrames; ++i)
+        {
+            const int index = (int) position;
+            const float phase = (float) (position - index) * phaseScale;
+            const int phaseIndex = juce::jmin((int) phase, numPhases - 1);
+            const float fraction = phase - (float) phaseIndex;
+
+            const float* a = phaseTable.data() + (size_t) phaseIndex * (size_t) numTaps;
+            const float* b = a + numTaps;
+            float* coeffs = blockCoeffs.data() + (size_t) i * (size_t) numTaps;
+            for (int tap = 0; tap < numTaps; ++tap)
+                coeffs[tap] = a[tap] + fraction * (b[tap] - a[tap]);
+
+            blockOffsets[(size_t) i] = index;
+            position += step;
+        }
+
+        const int consumed = (int) position;
+        const int newStored = stored + numInputFrames;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            float* line = lines[(size_t) channel].data();
+            std::copy(input[channel], input[channel] + numInputFrames, line + stored);
+
+            float* out = output[channel];
+            for (int i = 0; i < numOutputFrames; ++i)
+                out[i] = dotProduct(line + blockOffsets[(size_t) i],
+                                    blockCoeffs.data() + (size_t) i * (size_t) numTaps, numTaps);
+
+            // keep the history the next block's first window still needs
+            std::copy(line + consumed, line + newStored, line);
+        }
+
+        stored = newStored - consumed;
+        readPosition = position - consumed;
+    }
+
+private:
+    struct Preset
+    {
+        int taps;
+        int phases;
+        double beta;   // Kaiser window shape
+        double cutoff; // fraction of the lower Nyquist frequency
+    };
+
+    static const Preset& getPreset(Quality q) noexcept
+    {
+        static const Preset presets[] = {
+            { 16, 64, 6.0, 0.85 },
+            { 32, 128, 8.0, 0.91 },
+            { 64, 256, 10.0, 0.95 },
+        };
+        return presets[juce::jlimit(0, 2, (int) q)];
+    }
+
+    static double besselI0(double x) noexcept
+    {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 32; ++k)
+        {
+            const double t = x / (2.0 * k);
+            term *= t * t;
+            sum += term;
+            if (term < sum * 1.0e-12)
+                break;
+        }
+        return sum;
+    }
+
+    void buildPhaseTable(const Preset& preset)
+    {
+        // one extra phase so interpolating from the last phase never reads past the table
+        phaseTable.assign((size_t) (numPhases + 1) * (size_t) numTaps, 0.0f);
+
+        // when downsampling the passband shrinks to the output's Nyquist frequency
+        const double cutoff = preset.cutoff * juce::jmin(1.0, outputRate / inputRate);
+        const double halfLength = numTaps * 0.5;
+        const double windowNorm = 1.0 / besselI0(preset.beta);
+
+        for (int phase = 0; phase <= numPhases; ++phase)
+        {
+            float* coeffs = phaseTable.data() + (size_t) phase * (size_t) numTaps;
+            const double centre = halfLength - 1.0 + (double) phase / numPhases;
+            double sum = 0.0;
+
+            for (int tap = 0; tap < numTaps; ++tap)
+            {
+                const double x = tap - centre;
+                const double sinc = std::abs(x) < 1.0e-9 ? 1.0 : std::sin(juce::MathConstants<double>::pi * cutoff * x)
+                                                                   / (juce::MathConstants<double>::pi * cutoff * x);
+                const double r = x / halfLength;
+                const double window = std::abs(r) >= 1.0 ? 0.0 : besselI0(preset.beta * std::sqrt(1.0 - r * r)) * windowNorm;
+                coeffs[tap] = (float) (sinc * window);
+                sum += coeffs[tap];
+            }
+
+            // unity DC gain for every phase
+            for (int tap = 0; tap < numTaps; ++tap)
+                coeffs[tap] = (float) (coeffs[tap] / sum);
+        }
+    }
+
+    static float dotProduct(const float* x, const float* h, int n) noexcept
+    {
+        int i = 0;
+        float result = 0.0f;
+
+       #if M1_DECODE_KERNEL_X86 && defined(__AVX__)
+        {
+            __m256 acc = _mm256_setzero_ps();
+            for (; i + 8 <= n; i += 8)
+            {
+               #if defined(__FMA__)
+                acc = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(h + i), acc);
+               #else
+                acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(h + i)));
+               #endif
+            }
+            __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+            sum4 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+            sum4 = _mm_add_ss(sum4, _mm_shuffle_ps(sum4, sum4, 1));
+            result = _mm_cvtss_f32(sum4);
+        }
+       #elif M1_DECODE_KERNEL_X86
+        {
+            __m128 acc = _mm_setzero_ps();
+            for (; i + 4 <= n; i += 4)
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(h + i)));
+            acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+            acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+            result = _mm_cvtss_f32(acc);
+        }
+       #elif M1_DECODE_KERNEL_NEON
+        {
+            float32x4_t acc = vdupq_n_f32(0.0f);
+            for (; i + 4 <= n; i += 4)
+                acc = vmlaq_f32(acc, vld1q_f32(x + i), vld1q_f32(h + i));
+            const float32x2_t pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+            result = vget_lane_f32(vpadd_f32(pair, pair), 0);
+        }
+       #endif
+
+        for (; i < n; ++i)
+            result += x[i] * h[i];
+        return result;
+    }
+
+    double inputRate = 48000.0, outputRate = 48000.0, step = 1.0;
+    Quality quality = QualityStandard;
+    int numTaps = 0, numPhases = 0;
+    int maxOutput = 0, maxInput = 0, lineLength = 0;
+
+    std::vector<float> phaseTable;          // (numPhases + 1) x numTaps
+    std::vector<std::vector<float>> lines;  // per channel history + new input
+    std::vector<float> blockCoeffs;         // per output sample interpolated coefficients
+    std::vector<int> blockOffsets;          // per output sample window start in the line
+
+    int stored = 0;            // valid samples at the start of each line
+    double readPosition = 0.0; // position of the next output sample in the line
+};
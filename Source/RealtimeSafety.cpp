@@ -0,0 +1,399 @@
+#include "RealtimeSafety.h"
+
+#if M1_REALTIME_SAFETY_CHECKS
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if defined(__GLIBC__)
+ #include <dlfcn.h>
+ #include <pthread.h>
+
+extern "C"
+{
+    void* __libc_malloc(size_t);
+    void* __libc_calloc(size_t, size_t);
+    void* __libc_realloc(void*, size_t);
+    void* __libc_memalign(size_t, size_t);
+    void __libc_free(void*);
+}
+#elif defined(__APPLE__)
+ #include <malloc/malloc.h>
+ #include <mach/mach.h>
+ #include <pthread.h>
+#elif defined(_MSC_VER)
+ #include <malloc.h>
+#endif
+
+namespace
+{
+   #if defined(__APPLE__)
+    // The default zone's own functions, saved before hookDefaultZone() replaces them
+    malloc_zone_t originalZone {};
+    std::atomic<bool> zoneHooked { false };
+   #endif
+
+    // allocate without going through our own malloc/free hooks, so a violation is reported once
+    void* rawMalloc(std::size_t size)
+    {
+       #if defined(__GLIBC__)
+        return __libc_malloc(size);
+       #elif defined(__APPLE__)
+        if (zoneHooked.load(std::memory_order_acquire))
+            return originalZone.malloc(malloc_default_zone(), size);
+        return std::malloc(size);
+       #else
+        return std::malloc(size);
+       #endif
+    }
+
+    void rawFree(void* p)
+    {
+       #if defined(__GLIBC__)
+        __libc_free(p);
+       #elif defined(__APPLE__)
+        if (p != nullptr && zoneHooked.load(std::memory_order_acquire))
+            originalZone.free(malloc_default_zone(), p);
+        else
+            std::free(p);
+       #else
+        std::free(p);
+       #endif
+    }
+
+    // alignment is a power of two of at least sizeof (void*), as operator new guarantees
+    void* rawAlignedMalloc(std::size_t size, std::size_t alignment)
+    {
+       #if defined(__GLIBC__)
+        return __libc_memalign(alignment, size);
+       #elif defined(__APPLE__)
+        if (zoneHooked.load(std::memory_order_acquire))
+            return originalZone.memalign(malloc_default_zone(), alignment, size);
+        void* p = nullptr;
+        return posix_memalign(&p, alignment, size) == 0 ? p : nullptr;
+       #elif defined(_MSC_VER)
+        return _aligned_malloc(size, alignment);
+       #else
+        void* p = nullptr;
+        return posix_memalign(&p, alignment, size) == 0 ? p : nullptr;
+       #endif
+    }
+
+    void rawAlignedFree(void* p)
+    {
+       #if defined(_MSC_VER)
+        _aligned_free(p);
+       #else
+        rawFree(p);
+       #endif
+    }
+
+    thread_local int realtimeDepth = 0;
+    thread_local bool reporting = false;
+    std::atomic<int> violationCount { 0 };
+
+   #if defined(__GLIBC__)
+    // glibc 2.34 moved libpthread into libc and left __pthread_mutex_lock as a compat-only
+    // symbol, so look the real pthread_mutex_lock up behind our own instead of linking to it
+    using MutexLockFunction = int (*) (pthread_mutex_t*);
+    std::atomic<MutexLockFunction> realMutexLock { nullptr };
+
+    MutexLockFunction resolveMutexLock() noexcept
+    {
+        if (auto* function = realMutexLock.load(std::memory_order_acquire))
+            return function;
+
+        // dlsym may allocate, which must not count as a violation of the caller's section
+        const bool wasReporting = reporting;
+        reporting = true;
+        auto* function = reinterpret_cast<MutexLockFunction> (dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+        reporting = wasReporting;
+
+        realMutexLock.store(function, std::memory_order_release);
+        return function;
+    }
+
+    // resolve at startup, long before any thread enters a realtime section
+    [[maybe_unused]] const MutexLockFunction mutexLockAtStartup = resolveMutexLock();
+   #endif
+}
+
+namespace RealtimeSafety
+{
+    void enterRealtimeSection() noexcept { ++realtimeDepth; }
+    void exitRealtimeSection() noexcept { --realtimeDepth; }
+    bool isInRealtimeSection() noexcept { return realtimeDepth > 0 && !reporting; }
+
+    void reportViolation(const char* what) noexcept
+    {
+        violationCount.fetch_add(1);
+
+        // building the backtrace allocates, so stop checking while we report
+        reporting = true;
+        std::fprintf(stderr, "[RT] %s on the audio thread\n", what);
+        std::fprintf(stderr, "%s\n", juce::SystemStats::getStackBacktrace().toRawUTF8());
+        jassertfalse; // logging the assertion allocates too
+        reporting = false;
+    }
+
+    int getViolationCount() noexcept
+    {
+        return violationCount.load();
+    }
+}
+
+//==============================================================================
+// C++ allocations, these cover std::vector, std::string and std::function
+void* operator new(std::size_t size)
+{
+    if (RealtimeSafety::isInRealtimeSection())
+        RealtimeSafety::reportViolation("operator new");
+
+    if (auto* p = rawMalloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    if (p != nullptr && RealtimeSafety::isInRealtimeSection())
+        RealtimeSafety::reportViolation("operator delete");
+
+    rawFree(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    operator delete(p);
+}
+
+// Over-aligned types (alignas above alignof (std::max_align_t)), e.g. SIMD blocks
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    if (RealtimeSafety::isInRealtimeSection())
+        RealtimeSafety::reportViolation("aligned operator new");
+
+    const auto align = juce::jmax((std::size_t) alignment, sizeof(void*));
+    if (auto* p = rawAlignedMalloc(size == 0 ? 1 : size, align))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    if (p != nullptr && RealtimeSafety::isInRealtimeSection())
+        RealtimeSafety::reportViolation("aligned operator delete");
+
+    rawAlignedFree(p);
+}
+
+void operator delete[](void* p, std::align_val_t alignment) noexcept
+{
+    operator delete(p, alignment);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(p, alignment);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(p, alignment);
+}
+
+//==============================================================================
+// C allocations and pthread locks (juce::HeapBlock, juce::CriticalSection, std::mutex).
+// glibc exposes the implementations to forward to, so the functions are replaced outright.
+// macOS swaps the default malloc zone's functions and interposes pthread_mutex_lock. Anywhere
+// else only the operator new/delete hooks above are active.
+#if defined(__GLIBC__)
+extern "C"
+{
+    void* malloc(size_t size)
+    {
+        if (RealtimeSafety::isInRealtimeSection())
+            RealtimeSafety::reportViolation("malloc");
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        if (RealtimeSafety::isInRealtimeSection())
+            RealtimeSafety::reportViolation("calloc");
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* p, size_t size)
+    {
+        if (RealtimeSafety::isInRealtimeSection())
+            RealtimeSafety::reportViolation("realloc");
+        return __libc_realloc(p, size);
+    }
+
+    void free(void* p)
+    {
+        if (p != nullptr && RealtimeSafety::isInRealtimeSection())
+            RealtimeSafety::reportViolation("free");
+        __libc_free(p);
+    }
+
+    // glibc serves these from its own memalign, they never reach malloc() above
+    int posix_memalign(void** result, size_t alignment, size_t size)
+    {
+        if (RealtimeSafety::isInRealtimeSection())
+            RealtimeSafety::reportViolation("posix_memalign");
+        if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0)
+            return EINVAL;
+        void* p = __libc_memalign(alignment, size);
+        if (p == nullptr)
+            return ENOMEM;
+        *result = p;
+        return 0;
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size)
+    {
+        if (RealtimeSafety::isInRealtimeSection())
+            RealtimeSafety::reportViolation("aligned_alloc");
+        return __libc_memalign(alignment, size);
+    }
+
+    void* memalign(size_t alignment, size_t size)
+    {
+        if (RealtimeSafety::isInRealtimeSection())
+            RealtimeSafety::reportViolation("memalign");
+        return __libc_memalign(alignment, size);
+    }
+
+    int pthread_mutex_lock(pthread_mutex_t* mutex)
+    {
+        if (RealtimeSafety::isInRealtimeSection())
+            RealtimeSafety::reportViolation("pthread_mutex_lock");
+        return resolveMutexLock()(mutex);
+    }
+}
+#elif defined(__APPLE__)
+namespace
+{
+    // malloc, calloc, realloc, free, posix_memalign and aligned_alloc all end up in the zone
+    void* zoneMalloc(malloc_zone_t* zone, size_t size)
+    {
+        if (RealtimeSafety::isInRealtimeSection())
+            RealtimeSafety::reportViolation("malloc");
+        return originalZone.malloc(zone, size);
+    }
+
+    void* zoneCalloc(malloc_zone_t* zone, size_t count, size_t size)
+    {
+        if (RealtimeSafety::isInRealtimeSection())
+            RealtimeSafety::reportViolation("calloc");
+        return originalZone.calloc(zone, count, size);
+    }
+
+    void* zoneValloc(malloc_zone_t* zone, size_t size)
+    {
+        if (RealtimeSafety::isInRealtimeSection())
+            RealtimeSafety::reportViolation("valloc");
+        return originalZone.valloc(zone, size);
+    }
+
+    void* zoneRealloc(malloc_zone_t* zone, void* p, size_t size)
+    {
+        if (RealtimeSafety::isInRealtimeSection())
+            RealtimeSafety::reportViolation("realloc");
+        return originalZone.realloc(zone, p, size);
+    }
+
+    void* zoneMemalign(malloc_zone_t* zone, size_t alignment, size_t size)
+    {
+        if (RealtimeSafety::isInRealtimeSection())
+            RealtimeSafety::reportViolation("posix_memalign");
+        return originalZone.memalign(zone, alignment, size);
+    }
+
+    void zoneFree(malloc_zone_t* zone, void* p)
+    {
+        if (p != nullptr && RealtimeSafety::isInRealtimeSection())
+            RealtimeSafety::reportViolation("free");
+        originalZone.free(zone, p);
+    }
+
+    void zoneFreeDefiniteSize(malloc_zone_t* zone, void* p, size_t size)
+    {
+        if (p != nullptr && RealtimeSafety::isInRealtimeSection())
+            RealtimeSafety::reportViolation("free");
+        originalZone.free_definite_size(zone, p, size);
+    }
+
+    // The zone struct is read-only after the first allocation, so unprotect it for the swap
+    bool hookDefaultZone() noexcept
+    {
+        auto* zone = malloc_default_zone();
+        if (zone == nullptr || zone->version < 6)
+            return false;
+
+        const auto address = (vm_address_t) zone;
+        if (vm_protect(mach_task_self(), address, sizeof(malloc_zone_t), 0, VM_PROT_READ | VM_PROT_WRITE) != KERN_SUCCESS)
+            return false;
+
+        originalZone = *zone;
+        zone->malloc = zoneMalloc;
+        zone->calloc = zoneCalloc;
+        zone->valloc = zoneValloc;
+        zone->realloc = zoneRealloc;
+        zone->memalign = zoneMemalign;
+        zone->free = zoneFree;
+        zone->free_definite_size = zoneFreeDefiniteSize;
+
+        vm_protect(mach_task_self(), address, sizeof(malloc_zone_t), 0, VM_PROT_READ);
+        zoneHooked.store(true, std::memory_order_release);
+        return true;
+    }
+
+    // install at startup, long before any thread enters a realtime section
+    [[maybe_unused]] const bool defaultZoneHooked = hookDefaultZone();
+
+    // dyld redirects every other image's calls to it, calls from this one reach the real function
+    int interposedMutexLock(pthread_mutex_t* mutex)
+    {
+        if (RealtimeSafety::isInRealtimeSection())
+            RealtimeSafety::reportViolation("pthread_mutex_lock");
+        return pthread_mutex_lock(mutex);
+    }
+
+    struct Interpose
+    {
+        const void* replacement;
+        const void* replacee;
+    };
+
+    __attribute__((used, section("__DATA,__interpose")))
+    Interpose mutexLockInterpose { (const void*) &interposedMutexLock, (const void*) &pthread_mutex_lock };
+}
+#endif
+
+#endif // M1_REALTIME_SAFETY_CHECKS
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * Debug build mode that traps heap allocations and lock acquisitions on the audio thread.
+ *
+ * Configure with -DM1_REALTIME_SAFETY_CHECKS=ON to enable it. Code running inside a
+ * ScopedRealtimeSection then reports every malloc/free/new/delete and mutex lock together
+ * with a stack backtrace of the call site. The C allocation and mutex hooks exist on Linux
+ * (glibc) and macOS only, elsewhere just operator new/delete are checked. In regular builds
+ * everything here is a no-op.
+ */
+namespace RealtimeSafety
+{
+#if M1_REALTIME_SAFETY_CHECKS
+    void enterRealtimeSection() noexcept;
+    void exitRealtimeSection() noexcept;
+    bool isInRealtimeSection() noexcept;
+
+    // Called by the interposed allocation/lock functions, reports the current call site
+    void reportViolation(const char* what) noexcept;
+
+    // Number of violations seen since startup, useful to assert on in tests
+    int getViolationCount() noexcept;
+#else
+    inline void enterRealtimeSection() noexcept {}
+    inline void exitRealtimeSection() noexcept {}
+    inline bool isInRealtimeSection() noexcept { return false; }
+    inline void reportViolation(const char*) noexcept {}
+    inline int getViolationCount() noexcept { return 0; }
+#endif
+
+    struct ScopedRealtimeSection
+    {
+        ScopedRealtimeSection() noexcept { enterRealtimeSection(); }
+        ~ScopedRealtimeSection() noexcept { exitRealtimeSection(); }
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedRealtimeSection)
+    };
+
+    // Temporarily allows allocations, e.g. for diagnostics that are allowed to be slow
+    struct ScopedNonRealtimeSection
+    {
+        ScopedNonRealtimeSection() noexcept : wasRealtime(isInRealtimeSection()) { if (wasRealtime) exitRealtimeSection(); }
+        ~ScopedNonRealtimeSection() noexcept { if (wasRealtime) enterRealtimeSection(); }
+
+        const bool wasRealtime;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedNonRealtimeSection)
+    };
+}
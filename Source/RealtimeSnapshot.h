@@ -0,0 +1,132 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+/**
+ * Publishes heap objects from non-realtime threads to the audio thread without locks.
+ *
+ * Writers build a complete object and hand it to publish(); the audio thread picks up the
+ * latest one via acquire()/release() (or ScopedAccess) and never blocks or frees memory.
+ * Replaced objects stay alive until reclaim() sees that the audio thread no longer
+ * references them, so reclaim() should be called periodically from a non-realtime thread.
+ * The audio thread can also retain() objects past release(), to keep rendering with one it
+ * picked up in an earlier block.
+ */
+template <typename T>
+class RealtimeSnapshot
+{
+public:
+    RealtimeSnapshot() = default;
+
+    //==============================================================================
+    // Non-realtime side
+
+    void publish(std::unique_ptr<T> next)
+    {
+        const juce::ScopedLock lock(writerLock);
+        live.store(next.get());
+        owned.push_back(std::move(next));
+        reclaimLocked();
+    }
+
+    void clear()
+    {
+        const juce::ScopedLock lock(writerLock);
+        live.store(nullptr);
+        reclaimLocked();
+    }
+
+    // Frees every retired object that the audio thread is not currently using
+    void reclaim()
+    {
+        const juce::ScopedLock lock(writerLock);
+        reclaimLocked();
+    }
+
+    // Returns the most recently published object; only safe to read from writer threads
+    T* getLatest() const
+    {
+        return live.load();
+    }
+
+    //==============================================================================
+    // Realtime side (single audio thread)
+
+    T* acquire()
+    {
+        // Announce the object before using it and re-check that it is still live, so
+        // reclaim() can never free an object between our load and our announcement.
+        T* object = live.load();
+        for (;;)
+        {
+            inUse.store(object);
+            T* check = live.load();
+            if (check == object)
+                return object;
+            object = check;
+        }
+    }
+
+    void release()
+    {
+        inUse.store(nullptr);
+    }
+
+    static constexpr int NUM_RETAIN_SLOTS = 2;
+
+    // Keeps object alive after release() until the slot is overwritten. Only retain an object
+    // that is acquired or already retained. reclaim() checks the slots in index order, so move
+    // an object to a higher slot before overwriting the lower one it was held in.
+    void retain(int slot, T* object)
+    {
+        jassert(slot >= 0 && slot < NUM_RETAIN_SLOTS);
+        retained[slot].store(object);
+    }
+
+    class ScopedAccess
+    {
+    public:
+        explicit ScopedAccess(RealtimeSnapshot& s) : snapshot(s), object(s.acquire()) {}
+        ~ScopedAccess() { snapshot.release(); }
+
+        T* get() const { return object; }
+        T* operator->() const { return object; }
+        explicit operator bool() const { return object != nullptr; }
+
+    private:
+        RealtimeSnapshot& snapshot;
+        T* object;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedAccess)
+    };
+
+private:
+    void reclaimLocked()
+    {
+        const T* current = live.load();
+        const T* busy = inUse.load();
+        const T* kept[NUM_RETAIN_SLOTS];
+        for (int slot = 0; slot < NUM_RETAIN_SLOTS; ++slot)
+            kept[slot] = retained[slot].load();
+
+        owned.erase(std::remove_if(owned.begin(), owned.end(), [&](const std::unique_ptr<T>& p) {
+            return p.get() != current && p.get() != busy
+                && std::find(std::begin(kept), std::end(kept), p.get()) == std::end(kept);
+        }), owned.end());
+    }
+
+    std::atomic<T*> live { nullptr };
+    std::atomic<T*> inUse { nullptr };
+    std::atomic<T*> retained[NUM_RETAIN_SLOTS] {};
+
+    juce::CriticalSection writerLock;
+    std::vector<std::unique_ptr<T>> owned; // guarded by writerLock
+
+    JUCE_DECLARE_NON_COPYABLE(RealtimeSnapshot)
+};
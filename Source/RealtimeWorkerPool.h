@@ -0,0 +1,175 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "DecodeKernels.h" // for the M1_DECODE_KERNEL_* spin hint selection
+
+/**
+ * Small pool of realtime-priority threads that help the audio thread with one block's work.
+ *
+ * run() splits a job into numbered tasks. The calling audio thread and the workers claim tasks
+ * through one atomic counter and the caller then spins until every claimed task has finished,
+ * so no mutex, condition variable or allocation is involved. The caller also works through any
+ * task no worker has claimed yet: a worker that is asleep or descheduled only costs parallelism,
+ * never the deadline, and a pool with no running workers simply runs everything inline.
+ *
+ * Workers spin for about one block period after their last task, then yield, then fall back to
+ * short sleeps once playback has been idle for a while.
+ */
+class RealtimeWorkerPool
+{
+public:
+    ~RealtimeWorkerPool() { stop(); }
+
+    // Message thread
+    void start(int numWorkers, double blockPeriodSeconds)
+    {
+        stop();
+
+        idleSpinTicks = juce::jmax((juce::int64) 1, (juce::int64) (blockPeriodSeconds * (double) juce::Time::getHighResolutionTicksPerSecond()));
+        for (int i = 0; i < numWorkers; ++i)
+        {
+            workers.push_back(std::make_unique<Worker>(*this, i));
+            workers.back()->startRealtimeThread(juce::Thread::RealtimeOptions {}.withPriority(9));
+        }
+        numRunningWorkers = (int) workers.size();
+    }
+
+    // Message thread. A run() in progress on the audio thread finishes the remaining tasks itself.
+    void stop()
+    {
+        numRunningWorkers = 0;
+        for (auto& worker : workers)
+            worker->signalThreadShouldExit();
+        for (auto& worker : workers)
+            worker->stopThread(1000);
+        workers.clear();
+    }
+
+    int getNumWorkers() const noexcept { return numRunningWorkers.load(); }
+
+    //==============================================================================
+    // Audio thread: calls task(index) for every index in [0, numTasks) across the workers and
+    // the calling thread, and returns once all of them have finished.
+    template <typename Task>
+    void run(int numTasks, Task& task) noexcept
+    {
+        jassert(numTasks > 0 && numTasks <= MAX_TASKS);
+
+        currentContext.store(&task, std::memory_order_relaxed);
+        currentJob.store(&invoke<Task>, std::memory_order_relaxed);
+        tasksDone.store(0, std::memory_order_relaxed);
+
+        generation = (generation + 1) & GENERATION_MASK;
+        claim.store(makeClaim(generation, numTasks, 0), std::memory_order_release);
+
+        while (runNextTask())
+        {
+        }
+
+        while (tasksDone.load(std::memory_order_acquire) < numTasks)
+            spinHint();
+    }
+
+    static constexpr int MAX_TASKS = 256;
+
+private:
+    using Job = void (*)(void* context, int taskIndex);
+
+    template <typename Task>
+    static void invoke(void* context, int taskIndex) { (*static_cast<Task*>(context))(taskIndex); }
+
+    // generation | numTasks | next task index, in one word so a claim can never mix two runs
+    static constexpr juce::uint64 GENERATION_MASK = 0xffffffff;
+    static juce::uint64 makeClaim(juce::uint64 gen, int numTasks, int next) noexcept
+    {
+        return (gen << 32) | ((juce::uint64) numTasks << 16) | (juce::uint64) next;
+    }
+
+    // Claims and runs one task of the current run, false when there is none left
+    bool runNextTask() noexcept
+    {
+        auto current = claim.load(std::memory_order_acquire);
+        for (;;)
+        {
+            const int numTasks = (int) ((current >> 16) & 0xffff);
+            const int next = (int) (current & 0xffff);
+            if (next >= numTasks)
+                return false;
+
+            if (claim.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+                // the run cannot finish (and the job cannot change) while this task is unfinished
+                currentJob.load(std::memory_order_relaxed)(currentContext.load(std::memory_order_relaxed), next);
+                tasksDone.fetch_add(1, std::memory_order_acq_rel);
+                return true;
+            }
+        }
+    }
+
+    static void spinHint() noexcept
+    {
+       #if M1_DECODE_KERNEL_X86
+        _mm_pause();
+       #elif M1_DECODE_KERNEL_NEON && (defined(__GNUC__) || defined(__clang__))
+        __asm__ __volatile__("yield");
+       #endif
+    }
+
+    //==============================================================================
+    class Worker : public juce::Thread
+    {
+    public:
+        Worker(RealtimeWorkerPool& p, int index)
+            : juce::Thread("Transcode worker " + juce::String(index + 1)), pool(p) {}
+
+        void run() override
+        {
+            auto lastWork = juce::Time::getHighResolutionTicks();
+            int spins = 0;
+
+            while (!threadShouldExit())
+            {
+                if (pool.runNextTask())
+                {
+                    lastWork = juce::Time::getHighResolutionTicks();
+                    continue;
+                }
+
+                // only look at the clock every so often while spinning
+                if (++spins < 64)
+                {
+                    spinHint();
+                    continue;
+                }
+                spins = 0;
+
+                const auto idle = juce::Time::getHighResolutionTicks() - lastWork;
+                if (idle < pool.idleSpinTicks)
+                    spinHint();
+                else if (idle < pool.idleSpinTicks * 4)
+                    std::this_thread::yield();
+                else
+                    juce::Thread::sleep(1);
+            }
+        }
+
+    private:
+        RealtimeWorkerPool& pool;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<int> numRunningWorkers { 0 };
+    juce::int64 idleSpinTicks = 1;
+
+    std::atomic<juce::uint64> claim { 0 };
+    std::atomic<Job> currentJob { nullptr };
+    std::atomic<void*> currentContext { nullptr };
+    std::atomic<int> tasksDone { 0 };
+    juce::uint64 generation = 0; // audio thread only
+};
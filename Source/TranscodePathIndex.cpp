@@ -0,0 +1,196 @@
+#include "TranscodePathIndex.h"
+
+#include "Mach1Transcode.h"
+#include "Mach1TranscodeConstants.h"
+
+#include "FormatDefaults.h"
+
+#ifndef M1_SDK_VERSION
+ #define M1_SDK_VERSION "unknown"
+#endif
+
+TranscodePathIndex::TranscodePathIndex()
+    : juce::Thread("TranscodePathIndex")
+{
+}
+
+TranscodePathIndex::~TranscodePathIndex()
+{
+    stopThread(10000); // a single path search cannot be interrupted
+}
+
+void TranscodePathIndex::start(const juce::File& newCacheFile, std::function<void()> onReady)
+{
+    cacheFile = newCacheFile;
+    readyCallback = std::move(onReady);
+
+    if (loadCache())
+    {
+        DBG("TranscodePathIndex - Loaded " + cacheFile.getFullPathName());
+        if (readyCallback)
+            readyCallback();
+        return;
+    }
+
+    startThread();
+}
+
+std::vector<std::string> TranscodePathIndex::getMatchingFormatNames(int numChannels) const
+{
+    std::vector<std::string> names;
+
+    const juce::ScopedLock lock(entriesLock);
+    auto it = entriesByChannelCount.find(numChannels);
+    if (it != entriesByChannelCount.end())
+    {
+        for (const auto& entry : it->second)
+        {
+            if (entry.hasPath)
+                names.push_back(entry.name);
+        }
+    }
+    return names;
+}
+
+TranscodePathIndex::PathState TranscodePathIndex::getPathState(const std::string& inputFormat) const
+{
+    const juce::ScopedLock lock(entriesLock);
+    auto it = pathStates.find(inputFormat);
+    return it != pathStates.end() ? it->second : PathUnknown;
+}
+
+juce::File TranscodePathIndex::getDefaultCacheFile()
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("Mach1")
+        .getChildFile("M1-Player")
+        .getChildFile("transcode-paths.json");
+}
+
+//==============================================================================
+void TranscodePathIndex::run()
+{
+    const auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+    std::vector<Entry> entries;
+    Mach1Transcode<float> transcode;
+
+    for (const auto& format : Mach1TranscodeConstants::formats)
+    {
+        if (threadShouldExit())
+            return;
+
+        Entry entry;
+        entry.name = std::string(format.name);
+        entry.numChannels = format.numChannels;
+        entry.outputFormat = FormatDefaults::getPreferredOutputFormat(entry.name);
+
+        transcode.setInputFormat(transcode.getFormatFromString(entry.name));
+        transcode.setOutputFormat(transcode.getFormatFromString(entry.outputFormat));
+        entry.hasPath = transcode.processConversionPath();
+        entry.outputNumChannels = entry.hasPath ? transcode.getOutputNumChannels() : 0;
+
+        entries.push_back(std::move(entry));
+    }
+
+    DBG("TranscodePathIndex - Indexed " + juce::String((int) entries.size()) + " formats in "
+        + juce::String(juce::Time::getMillisecondCounterHiRes() - startTime, 1) + " ms");
+
+    setEntries(std::move(entries));
+    saveCache();
+
+    triggerAsyncUpdate();
+}
+
+void TranscodePathIndex::handleAsyncUpdate()
+{
+    if (readyCallback)
+        readyCallback();
+}
+
+void TranscodePathIndex::setEntries(std::vector<Entry> newEntries)
+{
+    {
+        const juce::ScopedLock lock(entriesLock);
+        entriesByChannelCount.clear();
+        pathStates.clear();
+        for (auto& entry : newEntries)
+        {
+            pathStates[entry.name] = entry.hasPath ? PathAvailable : PathMissing;
+            entriesByChannelCount[entry.numChannels].push_back(std::move(entry));
+        }
+    }
+    ready = true;
+}
+
+//==============================================================================
+juce::String TranscodePathIndex::getCacheKey()
+{
+    // The SDK version alone misses local SDK edits, so also fingerprint the inputs of the search
+    juce::String description;
+    for (const auto& format : Mach1TranscodeConstants::formats)
+    {
+        const std::string name(format.name);
+        description << name << ":" << format.numChannels << ">" << FormatDefaults::getPreferredOutputFormat(name) << ";";
+    }
+    return juce::String(M1_SDK_VERSION) + "/" + juce::String::toHexString(description.hashCode64());
+}
+
+bool TranscodePathIndex::loadCache()
+{
+    if (!cacheFile.existsAsFile())
+        return false;
+
+    const auto json = juce::JSON::parse(cacheFile);
+    if (json["key"].toString() != getCacheKey())
+        return false;
+
+    const auto* formats = json["formats"].getArray();
+    if (formats == nullptr)
+        return false;
+
+    std::vector<Entry> entries;
+    for (const auto& item : *formats)
+    {
+        Entry entry;
+        entry.name = item["name"].toString().toStdString();
+        entry.numChannels = (int) item["channels"];
+        entry.outputFormat = item["output"].toString().toStdString();
+        entry.hasPath = (bool) item["hasPath"];
+        entry.outputNumChannels = (int) item["outputChannels"];
+        entries.push_back(std::move(entry));
+    }
+
+    setEntries(std::move(entries));
+    return true;
+}
+
+void TranscodePathIndex::saveCache() const
+{
+    juce::Array<juce::var> formats;
+    {
+        const juce::ScopedLock lock(entriesLock);
+        for (const auto& channelCount : entriesByChannelCount)
+        {
+            for (const auto& entry : channelCount.second)
+            {
+                auto* item = new juce::DynamicObject();
+                item->setProperty("name", juce::String(entry.name));
+                item->setProperty("channels", entry.numChannels);
+                item->setProperty("output", juce::String(entry.outputFormat));
+                item->setProperty("hasPath", entry.hasPath);
+                item->setProperty("outputChannels", entry.outputNumChannels);
+                formats.add(juce::var(item));
+            }
+        }
+    }
+
+    auto* root = new juce::DynamicObject();
+    root->setProperty("key", getCacheKey());
+    root->setProperty("formats", formats);
+
+    if (!cacheFile.getParentDirectory().createDirectory() || !cacheFile.replaceWithText(juce::JSON::toString(juce::var(root))))
+    {
+        DBG("TranscodePathIndex - Cannot write " + cacheFile.getFullPathName());
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Table of which Mach1Transcode input formats can reach their preferred Mach1Spatial output.
+ *
+ * Finding a conversion path means a graph search inside Mach1Transcode, which gets slow for
+ * high channel counts. The whole format table is resolved once on a background thread at
+ * startup and saved to disk, keyed by the SDK version and a fingerprint of the format list,
+ * so later launches only read the cache. The UI only ever asks the finished table.
+ */
+class TranscodePathIndex : private juce::Thread,
+                           private juce::AsyncUpdater
+{
+public:
+    struct Entry
+    {
+        std::string name;
+        int numChannels = 0;
+        std::string outputFormat;   // FormatDefaults::getPreferredOutputFormat(name)
+        bool hasPath = false;
+        int outputNumChannels = 0;
+    };
+
+    enum PathState
+    {
+        PathUnknown = 0, // index not ready yet, or not a known format
+        PathAvailable,
+        PathMissing
+    };
+
+    TranscodePathIndex();
+    ~TranscodePathIndex() override;
+
+    // Loads the cache if it matches this build, otherwise builds the index in the background.
+    // onReady is called on the message thread once the index can be queried.
+    void start(const juce::File& cacheFile, std::function<void()> onReady = nullptr);
+
+    bool isReady() const noexcept { return ready.load(); }
+
+    // Formats with this channel count that have a conversion path, in Mach1TranscodeConstants order
+    std::vector<std::string> getMatchingFormatNames(int numChannels) const;
+    PathState getPathState(const std::string& inputFormat) const;
+
+    static juce::File getDefaultCacheFile();
+
+private:
+    void run() override;
+    void handleAsyncUpdate() override;
+
+    static juce::String getCacheKey();
+    bool loadCache();
+    void saveCache() const;
+    void setEntries(std::vector<Entry> newEntries);
+
+    juce::File cacheFile;
+    std::function<void()> readyCallback;
+
+    juce::CriticalSection entriesLock;
+    std::map<int, std::vector<Entry>> entriesByChannelCount;
+    std::map<std::string, PathState> pathStates;
+    std::atomic<bool> ready { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TranscodePathIndex)
+};
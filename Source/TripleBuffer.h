@@ -0,0 +1,71 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <atomic>
+
+/**
+ * Wait-free single-producer / single-consumer triple buffer for small POD state.
+ *
+ * The writer fills getWriteBuffer() and calls publish(); the reader calls read() and always
+ * gets the most recently published complete value. Neither side ever blocks or spins, so it
+ * is safe to read from the audio thread while a UI or tracker thread writes.
+ * Multiple writer threads must serialise themselves (e.g. with a juce::SpinLock).
+ */
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+
+    explicit TripleBuffer(const T& initialValue)
+    {
+        for (auto& b : buffers)
+            b = initialValue;
+    }
+
+    //==============================================================================
+    // Writer side
+    T& getWriteBuffer() noexcept { return buffers[backIndex]; }
+
+    void publish() noexcept
+    {
+        backIndex = middle.exchange(backIndex | dirtyFlag, std::memory_order_acq_rel) & indexMask;
+    }
+
+    void write(const T& value) noexcept
+    {
+        getWriteBuffer() = value;
+        publish();
+    }
+
+    //==============================================================================
+    // Reader side
+
+    // Returns true if a new value was picked up since the last call
+    bool update() noexcept
+    {
+        if ((middle.load(std::memory_order_relaxed) & dirtyFlag) == 0)
+            return false;
+
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    const T& read() noexcept
+    {
+        update();
+        return buffers[frontIndex];
+    }
+
+private:
+    static constexpr int indexMask = 3;
+    static constexpr int dirtyFlag = 4;
+
+    T buffers[3] {};
+    std::atomic<int> middle { 1 };
+    int backIndex = 0;  // writer only
+    int frontIndex = 2; // reader only
+
+    JUCE_DECLARE_NON_COPYABLE(TripleBuffer)
+};
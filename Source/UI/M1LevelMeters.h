@@ -0,0 +1,125 @@
+#pragma once
+
+#include "MurkaView.h"
+#include "MurkaBasicWidgets.h"
+#include "../Config.h"
+#include "../ChannelMeters.h"
+
+#include <algorithm>
+
+#if !defined(DEFAULT_FONT_SIZE)
+#define DEFAULT_FONT_SIZE 10
+#endif
+
+using namespace murka;
+
+// Vertical peak/RMS bars for every input channel, then the decoded outputs
+class M1LevelMeters : public murka::View<M1LevelMeters> {
+public:
+    void internalDraw(Murka & m) {
+        const int numInputs = levels.numInputs;
+        const int numOutputs = levels.numOutputs;
+        const int numBars = numInputs + numOutputs;
+        if (numBars == 0) {
+            return;
+        }
+
+        const float labelHeight = 16;
+        const float groupGap = 12;
+        const float barGap = numBars > 32 ? 1 : 2;
+        const float meterHeight = shape.size.y - labelHeight;
+        const float barWidth = std::max(1.0f, (shape.size.x - groupGap - barGap * numBars) / numBars);
+
+        m.pushStyle();
+        m.enableFill();
+
+        float x = 0;
+        for (int channel = 0; channel < numInputs; ++channel) {
+            drawBar(m, levels.inputs[channel], x, barWidth, meterHeight);
+            x += barWidth + barGap;
+        }
+        const float outputsX = x + groupGap;
+        x = outputsX;
+        for (int channel = 0; channel < numOutputs; ++channel) {
+            drawBar(m, levels.outputs[channel], x, barWidth, meterHeight);
+            x += barWidth + barGap;
+        }
+
+        m.setColor(LABEL_TEXT_COLOR);
+        m.setFontFromRawData(PLUGIN_FONT, BINARYDATA_FONT, BINARYDATA_FONT_SIZE, fontSize);
+        m.prepare<murka::Label>({0, meterHeight + 2, 100, labelHeight}).text("IN " + std::to_string(numInputs)).draw();
+        if (numOutputs > 0) {
+            m.prepare<murka::Label>({outputsX, meterHeight + 2, 100, labelHeight}).text("OUT").draw();
+        }
+
+        m.disableFill();
+        m.popStyle();
+    }
+
+    ChannelMeters::Levels levels;
+    float fontSize = DEFAULT_FONT_SIZE - 2;
+    float rangeDb = 60; // bottom of the scale, below 0 dBFS
+
+    M1LevelMeters & withLevels(const ChannelMeters::Levels& levels_) {
+        levels = levels_;
+        return *this;
+    }
+
+    M1LevelMeters & withFontSize(float fontSize_) {
+        fontSize = fontSize_;
+        return *this;
+    }
+
+private:
+    // METER_GREEN below -12 dBFS, METER_YELLOW up to -3 dBFS, METER_RED above
+    static constexpr float YELLOW_DB = -12.0f;
+    static constexpr float RED_DB = -3.0f;
+
+    float toHeight(float gain, float height) const {
+        const float db = ChannelMeters::gainToDecibels(gain, -rangeDb);
+        return height * (db + rangeDb) / rangeDb;
+    }
+
+    void setZoneColor(Murka & m, float gain, int alpha) {
+        const float db = ChannelMeters::gainToDecibels(gain, -rangeDb);
+        if (db > RED_DB) {
+            m.setColor(METER_RED, alpha);
+        } else if (db > YELLOW_DB) {
+            m.setColor(METER_YELLOW, alpha);
+        } else {
+            m.setColor(METER_GREEN, alpha);
+        }
+    }
+
+    void drawBar(Murka & m, const ChannelMeters::Channel& channel, float x, float width, float height) {
+        m.setColor(BACKGROUND_COMPONENT);
+        m.drawRectangle(x, 0, width, height);
+
+        // RMS body, split into the colour zones it reaches
+        const float rmsHeight = toHeight(channel.rms, height);
+        const float yellowHeight = height * (YELLOW_DB + rangeDb) / rangeDb;
+        const float redHeight = height * (RED_DB + rangeDb) / rangeDb;
+        m.setColor(METER_GREEN, 220);
+        m.drawRectangle(x, height - std::min(rmsHeight, yellowHeight), width, std::min(rmsHeight, yellowHeight));
+        if (rmsHeight > yellowHeight) {
+            m.setColor(METER_YELLOW, 220);
+            m.drawRectangle(x, height - std::min(rmsHeight, redHeight), width, std::min(rmsHeight, redHeight) - yellowHeight);
+        }
+        if (rmsHeight > redHeight) {
+            m.setColor(METER_RED, 220);
+            m.drawRectangle(x, height - rmsHeight, width, rmsHeight - redHeight);
+        }
+
+        // falling peak as a faint bar, held peak as a tick
+        const float peakHeight = toHeight(channel.peak, height);
+        if (peakHeight > rmsHeight) {
+            setZoneColor(m, channel.peak, 90);
+            m.drawRectangle(x, height - peakHeight, width, peakHeight - rmsHeight);
+        }
+        const float holdHeight = toHeight(channel.hold, height);
+        if (holdHeight > 0) {
+            setZoneColor(m, channel.hold, 255);
+            m.drawRectangle(x, height - holdHeight, width, 2);
+        }
+    }
+};
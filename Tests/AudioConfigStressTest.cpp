@@ -0,0 +1,181 @@
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "AudioConfigHandover.h"
+#include "CallbackProfiler.h"
+#include "RealtimeSafety.h"
+#include "RealtimeSnapshot.h"
+
+// Rebuilds and publishes decode configs as fast as possible on one thread while another runs
+// the device callback's config hand-over through the player's AudioConfigHandover: pick up the
+// latest config, crossfade from the one playing and render from both after release(). Fails if
+// the callback path ever allocates or takes a lock, touches a config that has already been
+// freed, or misses the deadline of a block as measured by CallbackProfiler.
+// Usage: M1-Player-AudioConfigStressTest [numPublishes]
+namespace
+{
+    constexpr double SAMPLE_RATE = 48000.0;
+    constexpr int BLOCK_SIZE = 512;
+    constexpr double CROSSFADE_SECONDS = 0.05; // MainComponent::CONFIG_CROSSFADE_SECONDS
+
+    // Stand-in for AudioDecodeConfig with the members AudioConfigHandover uses. Freed configs are
+    // poisoned and quarantined rather than returned to the heap, so a late read sees the poison
+    // instead of a reused allocation.
+    struct TestConfig
+    {
+        static constexpr juce::uint32 LIVE = 0x600dc0de;
+        static constexpr juce::uint32 FREED = 0xdeadbeef;
+        static constexpr int NUM_GAINS = 64;
+
+        TestConfig(int newGeneration, int channels) : numInputChannels(channels), generation(newGeneration)
+        {
+            gains.assign(NUM_GAINS, (float) newGeneration);
+        }
+
+        ~TestConfig()
+        {
+            state.store(FREED);
+        }
+
+        static void* operator new(std::size_t size) { return ::operator new(size); }
+
+        static void operator delete(void* p)
+        {
+            const std::lock_guard<std::mutex> lock(quarantineLock);
+            quarantine.push_back(p);
+        }
+
+        // Reads the whole config the way a render would, false if it is freed or half built
+        bool isIntact() const
+        {
+            if (state.load() != LIVE)
+                return false;
+            for (float gain : gains)
+                if (gain != (float) generation)
+                    return false;
+            return true;
+        }
+
+        int numInputChannels = 0;
+        bool startRampsSettled = false;
+
+        std::atomic<juce::uint32> state { LIVE };
+        int generation = 0;
+        std::vector<float> gains;
+
+        static std::mutex quarantineLock;
+        static std::vector<void*> quarantine;
+    };
+
+    std::mutex TestConfig::quarantineLock;
+    std::vector<void*> TestConfig::quarantine;
+
+    // The audio thread side of MainComponent::getNextAudioBlock() up to the strategies
+    struct CallbackPath
+    {
+        explicit CallbackPath(RealtimeSnapshot<TestConfig>& configs) : configs(configs), handover(configs)
+        {
+            profiler.prepare(SAMPLE_RATE);
+            handover.prepare(SAMPLE_RATE, CROSSFADE_SECONDS);
+        }
+
+        void processBlock(int mediaChannels)
+        {
+            profiler.beginBlock(BLOCK_SIZE);
+            {
+                RealtimeSafety::ScopedRealtimeSection realtime;
+
+                {
+                    RealtimeSnapshot<TestConfig>::ScopedAccess latest(configs);
+                    if (handover.pickUp(latest.get(), mediaChannels) && handover.getFadingConfig() != nullptr)
+                        ++crossfades;
+                }
+
+                // render after release(): only the retain slots keep these alive now
+                auto* rendered = handover.getRenderedConfig();
+                if (rendered != nullptr && !rendered->isIntact())
+                    ++brokenConfigs;
+                if (auto* fading = handover.getFadingConfig())
+                {
+                    if (!fading->isIntact())
+                        ++brokenConfigs;
+
+                    // the two gains have to add up in power across the whole fade
+                    const auto fade = handover.advanceFade(BLOCK_SIZE);
+                    const float startPower = fade.incomingStart * fade.incomingStart + fade.outgoingStart * fade.outgoingStart;
+                    const float endPower = fade.incomingEnd * fade.incomingEnd + fade.outgoingEnd * fade.outgoingEnd;
+                    if (fade.numSamples <= 0 || std::abs(startPower - 1.0f) > 1.0e-4f || std::abs(endPower - 1.0f) > 1.0e-4f)
+                        ++brokenFades;
+                }
+                if (rendered != nullptr)
+                    rendered->startRampsSettled = false;
+            }
+            profiler.endBlock();
+        }
+
+        RealtimeSnapshot<TestConfig>& configs;
+        AudioConfigHandover<TestConfig> handover;
+        CallbackProfiler profiler;
+        int crossfades = 0;
+        int brokenConfigs = 0;
+        int brokenFades = 0;
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    const int numPublishes = argc > 1 ? juce::jmax(1, std::atoi(argv[1])) : 200000;
+
+    RealtimeSnapshot<TestConfig> configs;
+    CallbackPath callback { configs };
+    std::atomic<bool> writerDone { false };
+    std::atomic<int> mediaChannels { 16 };
+    int numBlocks = 0;
+
+    std::thread audioThread([&] {
+        while (!writerDone.load())
+        {
+            callback.processBlock(mediaChannels.load());
+            ++numBlocks;
+            std::this_thread::yield(); // interleave with the writer even on a single core
+        }
+    });
+
+    // the message thread: rebuild, publish, now and then open media with another channel count
+    // (which switches without a fade) or close it, and reclaim
+    for (int generation = 1; generation <= numPublishes; ++generation)
+    {
+        if (generation % 89 == 0)
+            mediaChannels = mediaChannels.load() == 16 ? 4 : 16;
+        configs.publish(std::make_unique<TestConfig>(generation, mediaChannels.load()));
+        if (generation % 97 == 0)
+            configs.clear();
+        if (generation % 7 == 0)
+        {
+            configs.reclaim();
+            std::this_thread::yield();
+        }
+    }
+    writerDone = true;
+    audioThread.join();
+
+    const int violations = RealtimeSafety::getViolationCount();
+    const auto misses = callback.profiler.getDeadlineMisses();
+    const auto peak = callback.profiler.getHistogram(CallbackProfiler::StageTotal).getPercentileLoad(1.0f);
+    std::printf("%d publishes, %d callback blocks, %d crossfades, peak load below %.0f%%\n",
+                numPublishes, numBlocks, callback.crossfades, peak * 100.0f);
+    std::printf("allocations/locks in the callback: %d, freed or torn configs used: %d, broken fades: %d, deadline misses: %u\n",
+                violations, callback.brokenConfigs, callback.brokenFades, (unsigned) misses);
+
+    const bool passed = violations == 0 && callback.brokenConfigs == 0 && callback.brokenFades == 0 && misses == 0
+                     && numBlocks > 0 && (int) callback.profiler.getTotalBlocks() == numBlocks && callback.crossfades > 0;
+    std::printf("%s\n", passed ? "all checks passed" : "FAIL");
+    return passed ? 0 : 1;
+}
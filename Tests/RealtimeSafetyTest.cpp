@@ -0,0 +1,132 @@
+#include <JuceHeader.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+#include "RealtimeSafety.h"
+
+// Checks that the M1_REALTIME_SAFETY_CHECKS hooks see heap allocations and lock acquisitions
+// made inside a ScopedRealtimeSection, and nothing outside of one or inside a
+// ScopedNonRealtimeSection. Exits non-zero on the first failed check.
+namespace
+{
+    // keeps the compiler from pairing up and removing the allocations under test
+    void* volatile sink = nullptr;
+
+    // over-aligned, so new and delete take the std::align_val_t overloads
+    struct alignas(64) AlignedBlock
+    {
+        float samples[16];
+    };
+
+    int failures = 0;
+
+    void expectViolations(const char* what, int before, bool expected)
+    {
+        const bool counted = RealtimeSafety::getViolationCount() > before;
+        if (counted != expected)
+        {
+            std::printf("FAIL: %s %s reported\n", what, expected ? "was not" : "was");
+            ++failures;
+        }
+        else
+        {
+            std::printf("ok:   %s\n", what);
+        }
+    }
+}
+
+int main()
+{
+    std::mutex mutex;
+
+    {
+        const int before = RealtimeSafety::getViolationCount();
+        sink = std::malloc(64);
+        std::free(sink);
+        mutex.lock();
+        mutex.unlock();
+        expectViolations("malloc/free/lock outside a realtime section", before, false);
+    }
+
+    {
+        RealtimeSafety::ScopedRealtimeSection realtime;
+
+        int before = 0;
+
+       #if defined(__GLIBC__) || defined(__APPLE__)
+        // the C functions are only hooked where they can be forwarded, see RealtimeSafety.cpp
+        before = RealtimeSafety::getViolationCount();
+        sink = std::malloc(64);
+        expectViolations("malloc in a realtime section", before, true);
+
+        before = RealtimeSafety::getViolationCount();
+        std::free(sink);
+        expectViolations("free in a realtime section", before, true);
+       #endif
+
+        before = RealtimeSafety::getViolationCount();
+        sink = ::operator new(64);
+        expectViolations("operator new in a realtime section", before, true);
+
+        before = RealtimeSafety::getViolationCount();
+        ::operator delete(sink);
+        expectViolations("operator delete in a realtime section", before, true);
+
+        before = RealtimeSafety::getViolationCount();
+        auto* block = new AlignedBlock();
+        sink = block;
+        expectViolations("aligned operator new in a realtime section", before, true);
+
+        before = RealtimeSafety::getViolationCount();
+        delete block;
+        expectViolations("aligned operator delete in a realtime section", before, true);
+
+       #if defined(__GLIBC__) || defined(__APPLE__)
+        before = RealtimeSafety::getViolationCount();
+        void* aligned = nullptr;
+        if (posix_memalign(&aligned, 64, 256) == 0)
+            sink = aligned;
+        expectViolations("posix_memalign in a realtime section", before, true);
+        {
+            RealtimeSafety::ScopedNonRealtimeSection nonRealtime;
+            std::free(aligned);
+        }
+
+        before = RealtimeSafety::getViolationCount();
+        sink = std::aligned_alloc(64, 256);
+        expectViolations("aligned_alloc in a realtime section", before, true);
+        {
+            RealtimeSafety::ScopedNonRealtimeSection nonRealtime;
+            std::free(sink);
+        }
+
+        before = RealtimeSafety::getViolationCount();
+        mutex.lock();
+        mutex.unlock();
+        expectViolations("std::mutex::lock in a realtime section", before, true);
+       #endif
+
+        {
+            RealtimeSafety::ScopedNonRealtimeSection nonRealtime;
+
+            before = RealtimeSafety::getViolationCount();
+            sink = std::malloc(64);
+            std::free(sink);
+            mutex.lock();
+            mutex.unlock();
+            expectViolations("malloc/free/lock in a nested non-realtime section", before, false);
+        }
+    }
+
+    if (failures > 0)
+    {
+        std::printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    std::printf("all checks passed\n");
+    return 0;
+}